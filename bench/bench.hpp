@@ -0,0 +1,209 @@
+#ifndef BENCH_HPP
+#define BENCH_HPP
+
+#include <afmf.hpp>
+
+#include <vulkan/vulkan_core.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+//
+// Helpers shared by the benchmarks: argument parsing, timing and synthetic footage.
+//
+// Benchmarks print one line per measurement to stdout, so runs on different machines
+// or commits can be compared with diff.
+//
+
+namespace Bench {
+
+    using Clock = std::chrono::steady_clock;
+
+    /// Get the time passed since a point in seconds.
+    inline double secondsSince(Clock::time_point start) {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    ///
+    /// Read an optional numeric command line argument.
+    ///
+    /// @param argc Amount of arguments, including the program name.
+    /// @param argv Arguments, including the program name.
+    /// @param index Index of the argument, 1 for the first one.
+    /// @param fallback Value if the argument isn't given.
+    /// @return The value of the argument, or the fallback.
+    ///
+    inline uint32_t argument(int argc, char** argv, int index, uint32_t fallback) {
+        if (index >= argc)
+            return fallback;
+        return static_cast<uint32_t>(std::strtoul(argv[index], nullptr, 10)); // NOLINT
+    }
+
+    /// Frame size benchmarked.
+    struct Resolution {
+        const char* name;
+        uint32_t width;
+        uint32_t height;
+    };
+
+    /// Sizes of the common display modes generated frames are presented at.
+    constexpr std::array<Resolution, 3> resolutions{{
+        { .name = "1080p", .width = 1920, .height = 1080 },
+        { .name = "1440p", .width = 2560, .height = 1440 },
+        { .name = "4K", .width = 3840, .height = 2160 }
+    }};
+
+    /// Format of the synthetic footage.
+    constexpr VkFormat format = VK_FORMAT_B8G8R8A8_UNORM;
+    constexpr uint32_t pixelSize = 4;
+
+    ///
+    /// Synthetic footage of a textured background panning diagonally, with a textured
+    /// square moving against it. Both bounce back and forth, so the footage never ends.
+    ///
+    /// Textures are rendered once, frames are copied out of them row by row. Frames are
+    /// rendered into two buffers taking turns, like the inputs of a context.
+    ///
+    class Scene {
+    public:
+        ///
+        /// Create the footage.
+        ///
+        /// @param width Width of the frames.
+        /// @param height Height of the frames.
+        ///
+        Scene(uint32_t width, uint32_t height)
+                : width(width), height(height),
+                  objectSize(height / 4),
+                  background(texture(width + panRange, height + panRange, 1)),
+                  object(texture(height / 4, height / 4, 2)) {
+            for (auto& frame : this->frames)
+                frame.resize(static_cast<size_t>(width) * height * pixelSize);
+        }
+
+        ///
+        /// Render a frame of the footage.
+        ///
+        /// @param index Index of the frame, frames with the same index look the same.
+        /// @return The frame, valid until the frame after the next one is rendered.
+        ///
+        AFMF::HostImage render(uint32_t index) {
+            auto& frame = this->frames.at(index % 2);
+            const uint32_t backgroundX = bounce(index * 5, panRange);
+            const uint32_t backgroundY = bounce(index * 3, panRange);
+            const uint32_t backgroundWidth = this->width + panRange;
+            for (uint32_t y = 0; y < this->height; y++)
+                std::memcpy(&frame.at(static_cast<size_t>(y) * this->width * pixelSize),
+                    &this->background.at(
+                        (static_cast<size_t>(y + backgroundY) * backgroundWidth + backgroundX) * pixelSize),
+                    static_cast<size_t>(this->width) * pixelSize);
+
+            const uint32_t objectX = bounce(index * 7, this->width - this->objectSize);
+            const uint32_t objectY = bounce(index * 4, this->height - this->objectSize);
+            for (uint32_t y = 0; y < this->objectSize; y++)
+                std::memcpy(
+                    &frame.at((static_cast<size_t>(y + objectY) * this->width + objectX) * pixelSize),
+                    &this->object.at(static_cast<size_t>(y) * this->objectSize * pixelSize),
+                    static_cast<size_t>(this->objectSize) * pixelSize);
+
+            return {
+                .data = frame.data(),
+                .width = this->width,
+                .height = this->height,
+                .stride = static_cast<uint64_t>(this->width) * pixelSize,
+                .format = format
+            };
+        }
+
+        /// Get the width of the frames.
+        [[nodiscard]] uint32_t getWidth() const { return this->width; }
+        /// Get the height of the frames.
+        [[nodiscard]] uint32_t getHeight() const { return this->height; }
+    private:
+        static constexpr uint32_t panRange = 256; // furthest the background pans in each direction
+
+        // fold a position back and forth into [0, range]
+        static uint32_t bounce(uint32_t position, uint32_t range) {
+            if (range == 0)
+                return 0;
+            position %= range * 2;
+            return position <= range ? position : range * 2 - position;
+        }
+
+        // hash a lattice point into a value
+        static uint32_t hash(uint32_t x, uint32_t y, uint32_t seed) {
+            uint32_t value = (x * 0x8da6b343U) ^ (y * 0xd8163841U) ^ (seed * 0xcb1ab31fU);
+            value ^= value >> 13;
+            value *= 0x85ebca6bU;
+            value ^= value >> 16;
+            return value & 0xFF;
+        }
+
+        // bilinearly interpolated lattice values, cells of cellSize pixels
+        static uint32_t noise(uint32_t x, uint32_t y, uint32_t cellSize, uint32_t seed) {
+            const uint32_t cellX = x / cellSize;
+            const uint32_t cellY = y / cellSize;
+            const uint32_t fracX = x % cellSize;
+            const uint32_t fracY = y % cellSize;
+            const uint32_t top = hash(cellX, cellY, seed) * (cellSize - fracX)
+                + hash(cellX + 1, cellY, seed) * fracX;
+            const uint32_t bottom = hash(cellX, cellY + 1, seed) * (cellSize - fracX)
+                + hash(cellX + 1, cellY + 1, seed) * fracX;
+            return (top * (cellSize - fracY) + bottom * fracY) / (cellSize * cellSize);
+        }
+
+        // render a texture of coarse and fine detail, so every block has something to match
+        static std::vector<uint8_t> texture(uint32_t width, uint32_t height, uint32_t seed) {
+            std::vector<uint8_t> pixels(static_cast<size_t>(width) * height * pixelSize);
+            for (uint32_t y = 0; y < height; y++) {
+                for (uint32_t x = 0; x < width; x++) {
+                    const uint32_t value = (noise(x, y, 32, seed) * 3 + noise(x, y, 4, seed + 1)) / 4;
+                    auto* pixel = &pixels.at((static_cast<size_t>(y) * width + x) * pixelSize);
+                    pixel[0] = static_cast<uint8_t>(255 - value); // NOLINT
+                    pixel[1] = static_cast<uint8_t>(value); // NOLINT
+                    pixel[2] = static_cast<uint8_t>(std::min(value * 3 / 2, 255U)); // NOLINT
+                    pixel[3] = 255; // NOLINT
+                }
+            }
+            return pixels;
+        }
+
+        uint32_t width;
+        uint32_t height;
+        uint32_t objectSize;
+        std::vector<uint8_t> background; // panRange wider and taller than a frame
+        std::vector<uint8_t> object; // objectSize wide and tall
+        std::array<std::vector<uint8_t>, 2> frames;
+    };
+
+    /// Buffer to generate frames into, sized like the frames of a scene.
+    struct Output {
+        explicit Output(const Scene& scene)
+                : pixels(static_cast<size_t>(scene.getWidth()) * scene.getHeight() * pixelSize),
+                  image{
+                      .data = pixels.data(),
+                      .width = scene.getWidth(),
+                      .height = scene.getHeight(),
+                      .stride = static_cast<uint64_t>(scene.getWidth()) * pixelSize,
+                      .format = format
+                  } {}
+
+        std::vector<uint8_t> pixels;
+        AFMF::HostImage image; // refers to pixels
+
+        // Non-copyable and non-moveable, the image refers to the pixels
+        Output(const Output&) = delete;
+        Output& operator=(const Output&) = delete;
+        Output(Output&&) = delete;
+        Output& operator=(Output&&) = delete;
+        ~Output() = default;
+    };
+
+}
+
+#endif // BENCH_HPP
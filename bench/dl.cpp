@@ -0,0 +1,83 @@
+#include "bench.hpp"
+
+#include "loader/dl.hpp"
+
+#include <dlfcn.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+//
+// Throughput of the dlopen, dlsym and dlclose overrides, as called by games and Proton
+// loading their libraries at startup.
+//
+// The benchmark links the dynamic loader, so its own calls go through the overrides like
+// an application's do with the preloaded library. libm is overridden like libvulkan is,
+// libc isn't. Every result is compared against the original function.
+//
+// Usage: afmf-bench-dl [calls per measurement, 200000]
+//
+
+namespace {
+
+    constexpr int flags = RTLD_NOW | RTLD_LOCAL;
+
+    // stands in for an overridden symbol, never called
+    void placeholder() {}
+
+    // time a function called a number of times, in nanoseconds per call
+    template<typename Function>
+    double measure(uint32_t calls, const Function& function) {
+        const auto start = Bench::Clock::now();
+        for (uint32_t i = 0; i < calls; i++)
+            function();
+        return Bench::secondsSince(start) * 1e9 / calls;
+    }
+
+    // fail the benchmark if a result is wrong, so a broken override doesn't look fast
+    void check(bool condition, const char* message) {
+        if (condition)
+            return;
+        std::fprintf(stderr, "afmf-bench-dl: %s\n", message);
+        std::exit(EXIT_FAILURE);
+    }
+
+}
+
+int main(int argc, char** argv) {
+    const uint32_t calls = std::max(Bench::argument(argc, argv, 1, 200000), 1U);
+
+    Loader::DL::initialize();
+    for (const char* libName : {"libvulkan.so.1", "libvulkan.so", "libm.so.6"}) {
+        Loader::DL::File file(libName);
+        file.defineSymbol("cos", reinterpret_cast<void*>(placeholder));
+        Loader::DL::registerFile(file);
+    }
+
+    void* fake = dlopen("libm.so.6", flags);
+    void* real = dlopen("libc.so.6", flags);
+    void* original = Loader::DL::odlopen("libm.so.6", flags);
+    check(fake && real && original, "Failed to open libm.so.6 or libc.so.6");
+    check(dlsym(fake, "cos") == reinterpret_cast<void*>(placeholder), "cos isn't overridden");
+    check(dlsym(fake, "sin") == Loader::DL::odlsym(original, "sin"), "sin isn't passed through");
+
+    std::printf("%u calls per measurement\n", calls);
+    void* volatile sink{};
+    std::printf("dlsym:          overridden %6.1f ns, passed through %6.1f ns, real handle %6.1f ns, original %6.1f ns\n",
+        measure(calls, [&sink, fake] { sink = dlsym(fake, "cos"); }),
+        measure(calls, [&sink, fake] { sink = dlsym(fake, "sin"); }),
+        measure(calls, [&sink, real] { sink = dlsym(real, "malloc"); }),
+        measure(calls, [&sink, original] { sink = Loader::DL::odlsym(original, "sin"); }));
+    dlclose(fake);
+    dlclose(real);
+
+    // the original handle keeps libm loaded, so dlopen and dlclose only change its reference count
+    std::printf("dlopen+dlclose: overridden %6.1f ns, not overridden %6.1f ns, original %6.1f ns\n",
+        measure(calls, [] { dlclose(dlopen("libm.so.6", flags)); }),
+        measure(calls, [] { dlclose(dlopen("libc.so.6", flags)); }),
+        measure(calls, [] { Loader::DL::odlclose(Loader::DL::odlopen("libm.so.6", flags)); }));
+    Loader::DL::odlclose(original);
+    return EXIT_SUCCESS;
+}
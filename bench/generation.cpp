@@ -0,0 +1,70 @@
+#include "bench.hpp"
+
+#include "afmf/interpolator.hpp"
+#include "afmf/kernels.hpp"
+#include "afmf/scheduler.hpp"
+
+#include <afmf.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <memory>
+
+//
+// Motion estimation and frame generation throughput at 1080p, 1440p and 4K.
+//
+// Every frame pair of the synthetic footage is interpolated into one frame, like a
+// context doubling the frame rate, with the default context parameters. Throughput
+// is given in input pixels per second: for motion estimation alone, as AFMF logs it
+// when a context is deleted, and for generation as a whole.
+//
+// Usage: afmf-bench-generation [frame pairs, 60] [threads, 0 for one per core]
+//
+
+int main(int argc, char** argv) {
+    const uint32_t pairs = std::max(Bench::argument(argc, argv, 1, 60), 1U);
+    const uint32_t threads = Bench::argument(argc, argv, 2, 0);
+
+    try {
+        for (const auto& resolution : Bench::resolutions) {
+            Bench::Scene scene(resolution.width, resolution.height);
+            Bench::Output output(scene);
+            AFMF::Interpolator interpolator(Bench::format, {}, false,
+                std::make_shared<AFMF::Scheduler>(threads, 128));
+            const auto& estimator = interpolator.getMotionEstimator();
+            if (&resolution == &Bench::resolutions.front())
+                std::printf("%s kernels, %u threads, %u frame pairs\n",
+                    AFMF::Kernels::getIsaName(interpolator.getIsa()),
+                    interpolator.getScheduler().getThreadCount(), pairs);
+
+            // the first pair starts the threads and seeds the search, it isn't counted
+            AFMF::HostImage in0 = scene.render(0);
+            AFMF::HostImage in1 = scene.render(1);
+            interpolator.interpolate(in0, in1, { output.image });
+            const uint64_t warmupTime = interpolator.getTime();
+            const uint64_t warmupMotionTime = estimator.getTime();
+            const uint64_t warmupPixels = estimator.getPixelCount();
+
+            for (uint32_t i = 1; i <= pairs; i++) {
+                in0 = in1;
+                in1 = scene.render(i + 1);
+                interpolator.interpolate(in0, in1, { output.image });
+            }
+
+            const auto pixels = static_cast<double>(estimator.getPixelCount() - warmupPixels);
+            const auto time = static_cast<double>(interpolator.getTime() - warmupTime);
+            const auto motionTime = static_cast<double>(estimator.getTime() - warmupMotionTime);
+            std::printf("%-5s %ux%u: motion %.0f Mpixels/s, generation %.0f Mpixels/s, %.2f ms per frame\n",
+                resolution.name, resolution.width, resolution.height,
+                pixels * 1000.0 / motionTime, pixels * 1000.0 / time,
+                time / 1e6 / static_cast<double>(pairs));
+        }
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "afmf-bench-generation: %s\n", e.what());
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
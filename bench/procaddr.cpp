@@ -0,0 +1,118 @@
+#include "bench.hpp"
+
+#include "loader/dl.hpp"
+#include "loader/vk.hpp"
+#include "hooks.hpp"
+
+#include <vulkan/vulkan_core.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+//
+// Throughput of the vkGetInstanceProcAddr override, as called by engines and translation
+// layers resolving their functions at startup.
+//
+// The override is set up like the preloaded library does, with the same hooks, but without
+// its constructor. Hooked names are answered by the override alone, pass-through names are
+// passed on to the Vulkan loader, whose own time is measured separately. Both are compared
+// against looking the name up in a map keyed by std::string, like the override used to.
+//
+// Needs libvulkan.so.1, but no device.
+//
+// Usage: afmf-bench-procaddr [rounds over every name, 200000]
+//
+
+namespace {
+
+    // functions commonly resolved at startup that AFMF doesn't hook
+    constexpr std::array<const char*, 16> passThroughNames{
+        "vkEnumerateInstanceVersion",
+        "vkEnumerateInstanceExtensionProperties",
+        "vkEnumerateInstanceLayerProperties",
+        "vkEnumeratePhysicalDevices",
+        "vkGetPhysicalDeviceProperties2",
+        "vkGetPhysicalDeviceMemoryProperties",
+        "vkCreateBuffer",
+        "vkCreateImageView",
+        "vkCreateGraphicsPipelines",
+        "vkAllocateDescriptorSets",
+        "vkUpdateDescriptorSets",
+        "vkQueueSubmit2",
+        "vkCmdBindPipeline",
+        "vkCmdDraw",
+        "vkCmdDrawIndexedIndirectCount",
+        "vkCmdPipelineBarrier2KHR"
+    };
+
+    // stands in for the instance hooks of the preloaded library, never called
+    void placeholder() {}
+
+    // call a lookup on every name for a number of rounds
+    template<typename Lookup>
+    double measure(const std::vector<const char*>& names, uint32_t rounds, const Lookup& lookup) {
+        uintptr_t sink{};
+        const auto start = Bench::Clock::now();
+        for (uint32_t round = 0; round < rounds; round++)
+            for (const char* name : names)
+                sink ^= reinterpret_cast<uintptr_t>(lookup(name));
+        const double seconds = Bench::secondsSince(start);
+        if (sink == 1) // never true, keeps the calls from being optimized out
+            std::printf("\n");
+        return seconds * 1e9 / (static_cast<double>(rounds) * static_cast<double>(names.size()));
+    }
+
+}
+
+int main(int argc, char** argv) {
+    const uint32_t rounds = std::max(Bench::argument(argc, argv, 1, 200000), 1U);
+
+    // register the hooks like the preloaded library's constructor
+    Loader::DL::initialize();
+    Loader::VK::initialize();
+    std::vector<std::pair<const char*, PFN_vkVoidFunction>> hooks{
+        { "vkCreateInstance", reinterpret_cast<PFN_vkVoidFunction>(placeholder) },
+        { "vkDestroyInstance", reinterpret_cast<PFN_vkVoidFunction>(placeholder) },
+        { "vkCreateDevice", reinterpret_cast<PFN_vkVoidFunction>(placeholder) }
+    };
+    for (const auto& hook : Hooks::deviceHooks)
+        hooks.emplace_back(hook.name.data(), hook.function); // names are literals, so null-terminated
+
+    std::vector<const char*> hookedNames;
+    std::unordered_map<std::string, PFN_vkVoidFunction> stringMap;
+    for (const auto& [name, function] : hooks) {
+        Loader::VK::registerSymbol(name, reinterpret_cast<void*>(function));
+        stringMap.emplace(name, function);
+        hookedNames.push_back(name);
+    }
+    const std::vector<const char*> passedNames(passThroughNames.begin(), passThroughNames.end());
+
+    for (const auto& [name, function] : hooks)
+        if (myvkGetInstanceProcAddr(VK_NULL_HANDLE, name) != function) {
+            std::fprintf(stderr, "afmf-bench-procaddr: %s isn't hooked\n", name);
+            return EXIT_FAILURE;
+        }
+
+    const auto viaOverride = [](const char* name) { return myvkGetInstanceProcAddr(VK_NULL_HANDLE, name); };
+    const auto viaLoader = [](const char* name) { return Loader::VK::ovkGetInstanceProcAddr(VK_NULL_HANDLE, name); };
+    const auto viaStringMap = [&stringMap](const char* name) {
+        auto it = stringMap.find(std::string(name));
+        return it == stringMap.end() ? nullptr : it->second;
+    };
+
+    std::printf("%zu hooked and %zu pass-through names, %u rounds\n",
+        hookedNames.size(), passedNames.size(), rounds);
+    std::printf("hooked:       override %6.1f ns per call, string map %6.1f ns per lookup\n",
+        measure(hookedNames, rounds, viaOverride), measure(hookedNames, rounds, viaStringMap));
+    std::printf("pass-through: override %6.1f ns per call, loader alone %6.1f ns, string map %6.1f ns per lookup\n",
+        measure(passedNames, rounds, viaOverride), measure(passedNames, rounds, viaLoader),
+        measure(passedNames, rounds, viaStringMap));
+    return EXIT_SUCCESS;
+}
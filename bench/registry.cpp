@@ -0,0 +1,158 @@
+#include "bench.hpp"
+
+#include "registry.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+//
+// Cost of the lookups done on every present, against concurrent lookups and changes.
+//
+// Threads look up a fixed set of handles, like games presenting to several windows,
+// while one thread keeps inserting, replacing and erasing other handles, like a game
+// recreating swapchains. The registry is compared against the map guarded by a
+// shared_mutex it replaced. Every lookup checks it got its handle's value, so the
+// benchmark also catches snapshots or values freed too early, especially under ASan.
+//
+// Usage: afmf-bench-registry [maximum threads, 0 for one per core] [lookups per thread, 2000000]
+//
+
+namespace {
+
+    constexpr uintptr_t stableKeys = 64; // handles present to, never changed
+    constexpr uintptr_t churnKeys = 16; // handles changed while looking up
+
+    struct Entry {
+        uintptr_t key;
+    };
+
+    void* makeKey(uintptr_t index) {
+        return reinterpret_cast<void*>((index + 1) * 64);
+    }
+
+    std::unique_ptr<Entry> makeEntry(void* key) {
+        return std::make_unique<Entry>(Entry { .key = reinterpret_cast<uintptr_t>(key) });
+    }
+
+    /// Map guarded by a shared_mutex, as a baseline.
+    class LockedMap {
+    public:
+        bool find(void* key) const {
+            const std::shared_lock<std::shared_mutex> lock(this->mutex);
+            auto it = this->entries.find(key);
+            return it == this->entries.end() || it->second->key == reinterpret_cast<uintptr_t>(key);
+        }
+        void insert(void* key, std::unique_ptr<Entry> entry) {
+            const std::unique_lock<std::shared_mutex> lock(this->mutex);
+            this->entries[key] = std::move(entry);
+        }
+        void erase(void* key) {
+            const std::unique_lock<std::shared_mutex> lock(this->mutex);
+            this->entries.erase(key);
+        }
+    private:
+        mutable std::shared_mutex mutex;
+        std::unordered_map<void*, std::unique_ptr<Entry>> entries;
+    };
+
+    /// Registry with the same interface as the baseline.
+    class LockFreeMap {
+    public:
+        bool find(void* key) const {
+            const Entry* entry = this->registry.find(key);
+            return !entry || entry->key == reinterpret_cast<uintptr_t>(key);
+        }
+        void insert(void* key, std::unique_ptr<Entry> entry) { this->registry.insert(key, std::move(entry)); }
+        void erase(void* key) { this->registry.erase(key); }
+    private:
+        Registry<void*, Entry> registry;
+    };
+
+    struct Result {
+        double lookupTime; // average nanoseconds per lookup
+        uint64_t changes; // inserts, replacements and erases made meanwhile
+    };
+
+    // run readers looking up the stable and churned handles, with or without a writer
+    template<typename Map>
+    Result run(uint32_t readers, uint32_t lookups, bool churn) {
+        Map map;
+        for (uintptr_t i = 0; i < stableKeys + churnKeys; i++)
+            map.insert(makeKey(i), makeEntry(makeKey(i)));
+
+        std::atomic<bool> stopping{false};
+        std::atomic<uint64_t> changes{0};
+        std::thread writer;
+        if (churn)
+            writer = std::thread([&map, &stopping, &changes] {
+                uint64_t count{};
+                for (uintptr_t i = 0; !stopping.load(std::memory_order_relaxed); i++) {
+                    void* key = makeKey(stableKeys + (i % churnKeys));
+                    if (i % 3 == 2)
+                        map.erase(key);
+                    else
+                        map.insert(key, makeEntry(key)); // replaces every other time
+                    count++;
+                }
+                changes.store(count);
+            });
+
+        std::atomic<bool> failed{false};
+        std::vector<double> times(readers);
+        std::vector<std::thread> threads;
+        for (uint32_t thread = 0; thread < readers; thread++)
+            threads.emplace_back([&map, &failed, &times, thread, lookups] {
+                const auto start = Bench::Clock::now();
+                for (uint32_t i = 0; i < lookups; i++)
+                    if (!map.find(makeKey((i * 7 + thread) % (stableKeys + churnKeys))))
+                        failed.store(true);
+                times.at(thread) = Bench::secondsSince(start);
+            });
+        for (auto& thread : threads)
+            thread.join();
+        stopping.store(true);
+        if (writer.joinable())
+            writer.join();
+
+        if (failed.load()) {
+            std::fprintf(stderr, "afmf-bench-registry: A lookup found another handle's value\n");
+            std::exit(EXIT_FAILURE);
+        }
+        return {
+            .lookupTime = *std::ranges::max_element(times) * 1e9 / lookups,
+            .changes = changes.load()
+        };
+    }
+
+}
+
+int main(int argc, char** argv) {
+    uint32_t maxThreads = Bench::argument(argc, argv, 1, 0);
+    if (maxThreads == 0)
+        maxThreads = std::max(std::thread::hardware_concurrency(), 1U);
+    const uint32_t lookups = std::max(Bench::argument(argc, argv, 2, 2000000), 1U);
+
+    for (const bool churn : { false, true }) {
+        for (uint32_t readers = 1; ; readers = std::min(readers * 2, maxThreads)) {
+            const auto locked = run<LockedMap>(readers, lookups, churn);
+            const auto registry = run<LockFreeMap>(readers, lookups, churn);
+            std::printf("%3u readers, %-8s registry %6.1f ns per lookup (%lu changes), shared_mutex %6.1f ns per lookup (%lu changes)\n",
+                readers, churn ? "churn:" : "static:",
+                registry.lookupTime, static_cast<unsigned long>(registry.changes),
+                locked.lookupTime, static_cast<unsigned long>(locked.changes));
+            if (readers == maxThreads)
+                break;
+        }
+    }
+    return EXIT_SUCCESS;
+}
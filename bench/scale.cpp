@@ -0,0 +1,92 @@
+#include "bench.hpp"
+
+#include "afmf/motion.hpp"
+#include "afmf/scheduler.hpp"
+
+#include <afmf.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <memory>
+
+//
+// Time and accuracy of motion estimation at full, half and quarter resolution.
+//
+// Motion is estimated between every frame pair of the synthetic footage with the
+// default context parameters and Config::measure set, so every field is rated by the
+// luma PSNR of predicting the newer frame from the older one. Time saved and PSNR lost
+// are relative to estimating at full resolution.
+//
+// Usage: afmf-bench-scale [frame pairs, 30] [threads, 0 for one per core]
+//
+
+namespace {
+
+    constexpr std::array<uint32_t, 3> scales{ 1, 2, 4 };
+
+    // 720p first, the size the upsampling filter was tuned on
+    constexpr std::array<Bench::Resolution, 4> resolutions{{
+        { .name = "720p", .width = 1280, .height = 720 },
+        Bench::resolutions.at(0),
+        Bench::resolutions.at(1),
+        Bench::resolutions.at(2)
+    }};
+
+}
+
+int main(int argc, char** argv) {
+    const uint32_t pairs = std::max(Bench::argument(argc, argv, 1, 30), 1U);
+    const uint32_t threads = Bench::argument(argc, argv, 2, 0);
+
+    try {
+        auto scheduler = std::make_shared<AFMF::Scheduler>(threads, 128);
+        std::printf("%u threads, %u frame pairs\n", scheduler->getThreadCount(), pairs);
+
+        for (const auto& resolution : resolutions) {
+            Bench::Scene scene(resolution.width, resolution.height);
+            double fullTime{};
+            double fullPsnr{};
+            for (const uint32_t scale : scales) {
+                AFMF::MotionEstimator estimator(Bench::format,
+                    { .scale = scale, .measure = true }, scheduler);
+
+                // the first pair seeds the search, it isn't counted
+                AFMF::HostImage in0 = scene.render(0);
+                AFMF::HostImage in1 = scene.render(1);
+                estimator.estimate(in0, in1);
+                const uint64_t warmupTime = estimator.getTime();
+
+                double psnr{};
+                uint32_t perfect{};
+                for (uint32_t i = 1; i <= pairs; i++) {
+                    in0 = in1;
+                    in1 = scene.render(i + 1);
+                    estimator.estimate(in0, in1);
+                    if (std::isinf(estimator.getLastPsnr()))
+                        perfect++; // left out of the average
+                    else
+                        psnr += estimator.getLastPsnr();
+                }
+
+                const double time = static_cast<double>(estimator.getTime() - warmupTime) / 1e6 / pairs;
+                psnr = perfect < pairs ? psnr / (pairs - perfect) : INFINITY;
+                if (scale == 1) {
+                    fullTime = time;
+                    fullPsnr = psnr;
+                }
+                std::printf("%-5s %ux%u, scale 1/%u: %7.2f ms per pair (%3.0f%% saved), PSNR %5.2f dB (%+.2f dB), %u perfect\n",
+                    resolution.name, resolution.width, resolution.height, scale,
+                    time, (1.0 - time / fullTime) * 100.0, psnr, psnr - fullPsnr, perfect);
+            }
+        }
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "afmf-bench-scale: %s\n", e.what());
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,103 @@
+#include "bench.hpp"
+
+#include "afmf/interpolator.hpp"
+#include "afmf/scheduler.hpp"
+
+#include <afmf.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <memory>
+#include <thread>
+#include <vector>
+
+//
+// Frame generation throughput of the scheduler from one thread to one per core, for
+// several tile sizes.
+//
+// Every 4K frame pair of the synthetic footage is interpolated into three frames, like
+// a context going from 60 to 240 frames per second. Speedup is relative to one thread
+// at the same tile size, steals are the share of tasks run by a thread they weren't
+// dealt to.
+//
+// Usage: afmf-bench-scaling [maximum threads, 0 for one per core] [frame pairs, 10]
+//
+
+namespace {
+
+    constexpr std::array<uint32_t, 4> tileSizes{ 32, 64, 128, 256 };
+    constexpr uint32_t outputs = 3;
+
+    // thread counts from 1 to the maximum, doubling
+    std::vector<uint32_t> threadCounts(uint32_t maximum) {
+        std::vector<uint32_t> counts;
+        for (uint32_t threads = 1; threads < maximum; threads *= 2)
+            counts.push_back(threads);
+        counts.push_back(maximum);
+        return counts;
+    }
+
+}
+
+int main(int argc, char** argv) {
+    uint32_t maxThreads = Bench::argument(argc, argv, 1, 0);
+    if (maxThreads == 0)
+        maxThreads = std::max(std::thread::hardware_concurrency(), 1U);
+    const uint32_t pairs = std::max(Bench::argument(argc, argv, 2, 10), 1U);
+
+    try {
+        const auto& resolution = Bench::resolutions.back();
+        Bench::Scene scene(resolution.width, resolution.height);
+        std::vector<std::unique_ptr<Bench::Output>> buffers;
+        std::vector<AFMF::HostImage> outN;
+        for (uint32_t i = 0; i < outputs; i++) {
+            buffers.push_back(std::make_unique<Bench::Output>(scene));
+            outN.push_back(buffers.back()->image);
+        }
+        std::printf("%s %ux%u, %u frames per pair, %u frame pairs\n",
+            resolution.name, resolution.width, resolution.height, outputs, pairs);
+
+        for (const uint32_t tileSize : tileSizes) {
+            double baseline{};
+            for (const uint32_t threads : threadCounts(maxThreads)) {
+                AFMF::Interpolator interpolator(Bench::format, {}, false,
+                    std::make_shared<AFMF::Scheduler>(threads, tileSize));
+                const auto& scheduler = interpolator.getScheduler();
+
+                // the first pair starts the threads and seeds the search, it isn't counted
+                AFMF::HostImage in0 = scene.render(0);
+                AFMF::HostImage in1 = scene.render(1);
+                interpolator.interpolate(in0, in1, outN);
+                const uint64_t warmupTime = interpolator.getTime();
+                const uint64_t warmupTasks = scheduler.getTaskCount();
+                const uint64_t warmupSteals = scheduler.getStealCount();
+
+                for (uint32_t i = 1; i <= pairs; i++) {
+                    in0 = in1;
+                    in1 = scene.render(i + 1);
+                    interpolator.interpolate(in0, in1, outN);
+                }
+
+                const auto seconds = static_cast<double>(interpolator.getTime() - warmupTime) / 1e9;
+                const double throughput = static_cast<double>(resolution.width) * resolution.height
+                    * pairs / seconds / 1e6;
+                if (threads == 1)
+                    baseline = throughput;
+                const uint64_t tasks = scheduler.getTaskCount() - warmupTasks;
+                const uint64_t steals = scheduler.getStealCount() - warmupSteals;
+                std::printf("tile %3u, %3u threads: %6.1f Mpixels/s, %6.1f frames/s, speedup %5.2f, %4.1f%% of %lu tasks stolen\n",
+                    tileSize, threads, throughput, pairs * outputs / seconds, throughput / baseline,
+                    tasks > 0 ? static_cast<double>(steals) * 100.0 / static_cast<double>(tasks) : 0.0,
+                    static_cast<unsigned long>(tasks));
+            }
+        }
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "afmf-bench-scaling: %s\n", e.what());
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -1,44 +1,247 @@
 #ifndef AFMF_HPP
 #define AFMF_HPP
 
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
 #include <stdexcept>
 #include <vector>
 #include <vulkan/vulkan_core.h>
 
+namespace Hooks { struct DeviceDispatch; }
+
 namespace AFMF {
 
     ///
     /// Initialize the AFMF library (AMD FidelityFX Motion Frames).
     ///
+    /// Calls are counted, AFMF stays initialized until finalize was called as often.
+    ///
     /// @throws AFMF::vulkan_error if Vulkan objects fail to initialize.
     ///
     void initialize();
 
+    ///
+    /// Check if AFMF can interpolate images of a format.
+    ///
+    /// 8-bit RGBA/BGRA (UNORM and SRGB), 10-bit A2R10G10B10/A2B10G10R10 and
+    /// FP16 R16G16B16A16 formats are supported natively, without conversion.
+    ///
+    /// @param format Vulkan format of the images.
+    /// @return true if contexts can be created for the format.
+    ///
+    bool supportsFormat(VkFormat format);
+
+    /// Offset of an output that is written in place, see ContextDescription::outN.
+    constexpr uint64_t inPlace = UINT64_MAX;
+
+    ///
+    /// Description of the images and synchronization of an AFMF context.
+    ///
+    /// All shared images are bound to a single exported memory block, in the order
+    /// first input, second input, outputs. AFMF creates its images with the same
+    /// parameters and binds them to the imported block at the given offsets. Shared
+    /// images are created with VK_IMAGE_USAGE_TRANSFER_SRC_BIT and VK_IMAGE_USAGE_TRANSFER_DST_BIT.
+    /// Images the driver requires a dedicated allocation for are left out of the block and
+    /// bound at offset 0 to memory of their own instead, see Mini::ImageArena.
+    ///
+    /// Input images are released to VK_QUEUE_FAMILY_EXTERNAL in VK_IMAGE_LAYOUT_GENERAL
+    /// once their semaphore is signaled, output images must be released the same way.
+    ///
+    /// If images are given, AFMF reads the two most recently selected images in place
+    /// instead of the input images, see AFMF::selectInput. These images stay in
+    /// VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, must be created with VK_IMAGE_USAGE_SAMPLED_BIT and
+    /// VK_IMAGE_USAGE_TRANSFER_SRC_BIT and are only read from. They may be presented while
+    /// AFMF reads them, but must not be written to until the outputs of the next present are ready.
+    /// If they're owned by another queue family, see imageQueueFamily, that family must release an
+    /// input to queueFamily in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL before its semaphore is signaled,
+    /// and acquire it back from VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL once it's read.
+    ///
+    /// Outputs with the offset AFMF::inPlace are written to the image selected with
+    /// AFMF::selectOutput instead. Such images must be created with VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+    /// as AFMF copies the generated frames into them. Their previous contents are discarded and
+    /// they are left in VK_IMAGE_LAYOUT_PRESENT_SRC_KHR once the output's semaphore is signaled.
+    /// Images owned by another queue family must be acquired back from VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL.
+    ///
+    /// With binary semaphores, frames are submitted from a thread of AFMF's own, so the output
+    /// semaphores may only be waited on, and the input images written to, after AFMF::flushContext.
+    ///
+    /// Without a device, the context works on host memory only, see AFMF::HostImage.
+    ///
+    struct ContextDescription {
+        uint32_t width{}; // width of the images
+        uint32_t height{}; // height of the images
+        VkFormat format{VK_FORMAT_UNDEFINED}; // format of the images, see AFMF::supportsFormat
+        uint32_t blockSize{16}; // motion estimation block size in pixels (8, 16 or 32), or 0 to blend without motion
+        uint32_t searchRange{32}; // furthest motion searched for in pixels, in each direction
+        uint32_t motionScale{1}; // estimate motion at 1/motionScale of the resolution (1, 2 or 4)
+        bool sceneDetection{true}; // duplicate frames instead of generating them on static frames and scene cuts
+        uint32_t threads{0}; // threads generating frames, or 0 for one per core
+        uint32_t tileSize{128}; // width and height of the tiles frames are split into for the threads, in pixels
+
+        int memory{-1}; // file descriptor for the memory block the shared images are bound to
+        uint64_t memorySize{}; // allocation size of the memory block
+        std::vector<int> dedicatedMemory; // file descriptors for the shared images with memory of their own, in order
+
+        uint64_t in0{}; // offset of the first input image, unless read in place
+        uint64_t in1{}; // offset of the second input image, unless read in place
+        std::vector<uint64_t> outN; // offset of each output image, defines the frame generation multiplier
+
+        int syncSemaphore{-1}; // timeline semaphore used by every present, or -1 for binary semaphores
+
+        VkDevice device{VK_NULL_HANDLE}; // device of all images, or VK_NULL_HANDLE for a host memory context
+        VkPhysicalDevice physicalDevice{VK_NULL_HANDLE}; // physical device of the device
+        const Hooks::DeviceDispatch* dispatch{nullptr}; // functions of the device, must outlive the context
+        uint32_t queueFamily{}; // queue family of the queue
+        VkQueue queue{VK_NULL_HANDLE}; // queue AFMF submits to, see queueMutex
+        std::shared_ptr<std::mutex> queueMutex; // locked by AFMF's worker to submit, see AFMF::presentContext. nullptr if AFMF is the queue's only user
+        std::vector<VkImage> images; // images inputs and outputs can be selected from, if used in place
+        uint32_t imageQueueFamily{VK_QUEUE_FAMILY_IGNORED}; // queue family owning the images outside AFMF's transfers, or VK_QUEUE_FAMILY_IGNORED if they're shared with queueFamily
+    };
+
+    ///
+    /// Image in host memory, for contexts created without a device.
+    ///
+    struct HostImage {
+        void* data{}; // first pixel of the image
+        uint32_t width{}; // width of the image
+        uint32_t height{}; // height of the image
+        uint64_t stride{}; // bytes between the starts of two rows
+        VkFormat format{VK_FORMAT_UNDEFINED}; // format of the image, see AFMF::supportsFormat
+    };
+
     ///
     /// Create a new AFMF context on a swapchain.
     ///
-    /// @param width Width of the input images.
-    /// @param height Height of the input images.
-    /// @param in0 File descriptor for the first input image.
-    /// @param in1 File descriptor for the second input image.
-    /// @param outN File descriptor for each output image. This defines the frame generation multiplier.
+    /// @param desc Description of the context's images and synchronization.
     /// @return A unique identifier for the created context.
     ///
     /// @throws AFMF::vulkan_error if the context cannot be created.
     ///
-    int32_t createContext(uint32_t width, uint32_t height, int in0, int in1,
-        const std::vector<int>& outN);
+    int32_t createContext(const ContextDescription& desc);
+
+    ///
+    /// Change the interpolated area and in-place images of a context, keeping its shared images.
+    ///
+    /// Used when a swapchain is recreated. Frames presented before resizing are not
+    /// interpolated from, the next present only provides the first input.
+    ///
+    /// @param id Unique identifier of the context.
+    /// @param width Width of the interpolated area, at most the width of the shared images.
+    /// @param height Height of the interpolated area, at most the height of the shared images.
+    /// @param images New images inputs and outputs can be selected from, if used in place.
+    ///
+    /// @throws AFMF::vulkan_error if the area doesn't fit into the shared images.
+    ///
+    void resizeContext(int32_t id, uint32_t width, uint32_t height,
+        const std::vector<VkImage>& images);
+
+    ///
+    /// Select the input image of the next present, for contexts reading their input in place.
+    ///
+    /// The previously selected image becomes the first input, the selected one the second.
+    ///
+    /// @param id Unique identifier of the context.
+    /// @param index Index of the image in ContextDescription::images.
+    ///
+    /// @throws AFMF::vulkan_error if the context doesn't read its input in place.
+    ///
+    void selectInput(int32_t id, uint32_t index);
+
+    ///
+    /// Select the image an output of the next present is written to, for outputs written in place.
+    ///
+    /// @param id Unique identifier of the context.
+    /// @param output Index of the output in ContextDescription::outN.
+    /// @param index Index of the image in ContextDescription::images.
+    ///
+    /// @throws AFMF::vulkan_error if the output isn't written in place.
+    ///
+    void selectOutput(int32_t id, uint32_t output, uint32_t index);
 
     ///
     /// Present a context with frame interpolation.
     ///
+    /// Fewer semaphores than outputs only generate that many frames, at phases evenly
+    /// spread between the inputs. Without any, the input is only kept for the next present.
+    ///
+    /// The frame is handed to AFMF's worker thread, which submits its transfers holding
+    /// ContextDescription::queueMutex, so it must not be held while calling this. The input
+    /// semaphore's signal must have been submitted before.
+    ///
     /// @param id Unique identifier of the context to present.
     /// @param inSem Semaphore to wait on before starting the generation.
-    /// @param outSem Semaphores to signal once each output image is ready.
+    /// @param outSem Semaphores to signal once each generated output image is ready,
+    ///               at most one per output.
+    /// @param readSem Semaphore to signal once the input image has been read, or -1. Lets
+    ///                an input read in place be presented without waiting for the outputs.
+    ///
+    /// @throws AFMF::vulkan_error if the context cannot be presented.
+    ///
+    void presentContext(int32_t id, int inSem, const std::vector<int>& outSem, int readSem = -1);
+
+    ///
+    /// Wait until the presents of a context created without a timeline semaphore are submitted.
+    /// Output and read semaphores may only be waited on, and the input image read by a present
+    /// may only be written to again, once it is submitted. Safe to call from any thread.
+    ///
+    /// @param id Unique identifier of the context.
+    /// @param pending Amount of the most recent presents that may still be unsubmitted.
+    ///
+    /// @throws AFMF::vulkan_error if the context doesn't exist.
+    ///
+    void flushContext(int32_t id, size_t pending = 0);
+
+    ///
+    /// Present a context created with a timeline semaphore.
+    ///
+    /// Generating fewer frames than there are outputs spreads them evenly between the
+    /// inputs. The last generated output signals the value of the context's last output,
+    /// so every value up to it is reached even if its output wasn't generated. Without any
+    /// generated frames, that value is signaled once the input has been read.
+    ///
+    /// The transfers are submitted before returning, so ContextDescription::queueMutex
+    /// must be held while calling this.
+    ///
+    /// @param id Unique identifier of the context to present.
+    /// @param inValue Timeline value to wait on before starting the generation.
+    /// @param outValue Timeline value to signal once the first output image is ready.
+    ///                 Output image i signals outValue + i.
+    /// @param count Amount of frames to generate, at most the amount of outputs.
+    ///
+    /// @throws AFMF::vulkan_error if the context cannot be presented.
+    ///
+    void presentContext(int32_t id, uint64_t inValue, uint64_t outValue, size_t count);
+
+    ///
+    /// Present a context created without a device, generating frames in host memory.
+    ///
+    /// The frames are generated before returning. All images must have the size and
+    /// format of the context, or the size it was last resized to.
+    ///
+    /// @param id Unique identifier of the context to present.
+    /// @param in0 Older input frame.
+    /// @param in1 Newer input frame.
+    /// @param outN Images to write each generated frame to, at most one per output.
     ///
     /// @throws AFMF::vulkan_error if the context cannot be presented.
     ///
-    void presentContext(int32_t id, int inSem, const std::vector<int>& outSem);
+    void presentContext(int32_t id, const HostImage& in0, const HostImage& in1,
+        const std::vector<HostImage>& outN);
+
+    ///
+    /// Get the time a context spent generating frames so far.
+    ///
+    /// Safe to call while frames are generated, the time of a present is added once
+    /// its frames are generated.
+    ///
+    /// @param id Unique identifier of the context.
+    /// @return The time in nanoseconds.
+    ///
+    /// @throws AFMF::vulkan_error if the context doesn't exist.
+    ///
+    uint64_t getGenerationTime(int32_t id);
 
     ///
     /// Delete an AFMF context.
@@ -48,7 +251,8 @@ namespace AFMF {
     void deleteContext(int32_t id);
 
     ///
-    /// Deinitialize the AFMF library.
+    /// Deinitialize the AFMF library once every initialize call has been matched,
+    /// deleting the remaining contexts.
     ///
     void finalize();
 
@@ -0,0 +1,179 @@
+#ifndef AFMF_ENGINE_HPP
+#define AFMF_ENGINE_HPP
+
+#include "afmf/interpolator.hpp"
+#include "mini/buffer.hpp"
+#include "mini/commandbuffer.hpp"
+#include "mini/commandpool.hpp"
+#include "mini/fence.hpp"
+#include "mini/image.hpp"
+#include "mini/imagearena.hpp"
+#include "mini/semaphore.hpp"
+#include "mini/submitbatch.hpp"
+
+#include <afmf.hpp>
+
+#include <vulkan/vulkan_core.h>
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace AFMF {
+
+    ///
+    /// Frame generation engine of a context created with a device.
+    ///
+    /// Input frames are read back into host memory, interpolated on the CPU and the
+    /// generated frames uploaded to the output images, all transfers running on the
+    /// context's queue. Presenting hands the frame to a worker thread. With a timeline
+    /// semaphore, presenting submits the transfers and the worker only interpolates once
+    /// the readback is done. Otherwise the worker submits the readback, waits for it,
+    /// interpolates and submits the uploads signaling the output semaphores itself.
+    ///
+    class Engine {
+    public:
+        ///
+        /// Create the engine, importing the shared images and semaphore of a context.
+        ///
+        /// @param desc Description of the context, ownership of its file descriptors is transferred.
+        ///
+        /// @throws AFMF::vulkan_error if any Vulkan call fails.
+        ///
+        explicit Engine(const ContextDescription& desc);
+
+        ///
+        /// Change the interpolated area and in-place images, see AFMF::resizeContext.
+        ///
+        /// Waits for every submitted present to finish.
+        ///
+        /// @throws AFMF::vulkan_error if any Vulkan call fails.
+        ///
+        void resize(VkExtent2D extent, const std::vector<VkImage>& images);
+
+        ///
+        /// Present with binary semaphores.
+        ///
+        /// Only waits for the present before the previous one to be submitted, so its
+        /// semaphores can be replaced. The output semaphores are signaled by submissions
+        /// of the worker thread, see flush.
+        ///
+        /// @param input Index of the image to read in place, if any.
+        /// @param outputs Index of the image to write each in-place output to.
+        /// @param inSem Semaphore to wait on before reading the input, ownership is transferred.
+        /// @param outSem Semaphores to signal once each output is written, ownership is transferred.
+        ///               Only as many outputs as semaphores are generated.
+        /// @param readSem Semaphore to signal once the input is read back, or -1, ownership is transferred.
+        ///
+        /// @throws AFMF::vulkan_error if any Vulkan call fails.
+        ///
+        void present(uint32_t input, const std::vector<uint32_t>& outputs,
+            int inSem, const std::vector<int>& outSem, int readSem);
+
+        ///
+        /// Present with the context's timeline semaphore.
+        ///
+        /// @param input Index of the image to read in place, if any.
+        /// @param outputs Index of the image to write each in-place output to.
+        /// @param inValue Value to wait for before reading the input.
+        /// @param outValue Value to signal once the first output is written.
+        /// @param count Amount of outputs to generate.
+        ///
+        /// @throws AFMF::vulkan_error if any Vulkan call fails.
+        ///
+        void present(uint32_t input, const std::vector<uint32_t>& outputs,
+            uint64_t inValue, uint64_t outValue, size_t count);
+
+        ///
+        /// Wait until the binary presents so far are submitted, see AFMF::flushContext.
+        /// Safe to call from any thread.
+        ///
+        /// @param pending Amount of the most recent presents that may still be unsubmitted.
+        ///
+        void flush(uint64_t pending = 0) const;
+
+        ///
+        /// Wait for every submitted present to finish.
+        ///
+        /// @throws AFMF::vulkan_error if any Vulkan call fails.
+        ///
+        void waitIdle();
+
+        /// Get the interpolator, only safe to use while idle.
+        [[nodiscard]] const Interpolator& getInterpolator() const { return this->interpolator; }
+        /// Get the time spent generating frames so far in nanoseconds, safe to use at any time.
+        [[nodiscard]] uint64_t getGenerationTime() const { return this->generationTime.load(); }
+
+        // Non-copyable and non-moveable, the worker thread refers to the engine
+        Engine(const Engine&) = delete;
+        Engine& operator=(const Engine&) = delete;
+        Engine(Engine&&) = delete;
+        Engine& operator=(Engine&&) = delete;
+        ~Engine();
+    private:
+        struct Job {
+            uint64_t frame; // frame to generate outputs for
+            VkExtent2D extent; // interpolated area
+            size_t outputs; // amount of outputs to generate
+            bool first; // no previous input, the newest one is repeated
+        };
+
+        /// Semaphores and images of a binary present, indexed by frame % 2.
+        struct Slot {
+            Mini::Semaphore inSemaphore; // temporarily imported binary semaphore
+            std::vector<Mini::Semaphore> outSemaphores; // imported binary semaphores, replaced every present
+            Mini::Semaphore readSemaphore; // imported binary semaphore, replaced every present it's given
+            bool signalRead{false}; // the readback signals readSemaphore
+            Mini::Fence fence; // signaled by the readback, then by the uploads
+            bool pending{false}; // uploads have been submitted and not waited on yet
+            size_t source{0}; // image read back
+            std::vector<uint32_t> targets; // image each in-place output is written to
+        };
+
+        void record();
+        void interpolate(const Job& job);
+        void generate(const Job& job); // read back, interpolate and upload a binary present
+        void work();
+
+        ContextDescription desc;
+        VkExtent2D extent;
+        Interpolator interpolator;
+
+        Mini::ImageArena arena; // imported memory block backing the shared images
+        std::array<Mini::Image, 2> inputs; // shared input images, unless read in place
+        std::vector<Mini::Image> outputs; // shared output images, indexed by output, unset for in-place outputs
+        std::array<Mini::Buffer, 2> inputBuffers; // host copies of the last two inputs, indexed by frame % 2
+        std::vector<Mini::Buffer> outputBuffers; // host copies of the generated frames
+
+        Mini::CommandPool cmdPool;
+        Mini::SubmitBatch submitBatch;
+        std::vector<std::array<Mini::CommandBuffer, 2>> readbackBufs; // indexed by source image, then input buffer
+        std::vector<std::vector<Mini::CommandBuffer>> uploadBufs; // indexed by output, then target image
+
+        Mini::Semaphore syncSemaphore; // imported timeline semaphore, if any
+        std::array<Slot, 2> slots; // binary mode only
+        std::atomic<uint64_t> queued{0}; // binary presents handed to the worker
+        std::atomic<uint64_t> submitted{0}; // binary presents whose uploads the worker submitted
+
+        // frame k is read back once progress reaches 3k, interpolated once it reaches 3k+1
+        // and uploaded once it reaches 3k+2. the uploads signal 3k+3.
+        Mini::Semaphore progress;
+        uint64_t frame{0}; // frames presented, including those before resizing
+        uint64_t firstFrame{0}; // first frame after creation or resize, has no previous input
+
+        std::thread worker;
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::deque<Job> jobs; // frames to interpolate
+        std::atomic<bool> stopping{false};
+        std::atomic<uint64_t> generationTime{0}; // copy of the interpolator's, updated after every frame
+    };
+
+}
+
+#endif // AFMF_ENGINE_HPP
@@ -0,0 +1,100 @@
+#ifndef AFMF_INTERPOLATOR_HPP
+#define AFMF_INTERPOLATOR_HPP
+
+#include "afmf/kernels.hpp"
+#include "afmf/motion.hpp"
+#include "afmf/scene.hpp"
+#include "afmf/scheduler.hpp"
+
+#include <afmf.hpp>
+
+#include <vulkan/vulkan_core.h>
+
+#include <memory>
+#include <vector>
+
+namespace AFMF {
+
+    ///
+    /// CPU frame interpolator working on images in host memory.
+    ///
+    /// Output i of N is generated at phase (i + 1) / (N + 1) between the two inputs. With
+    /// motion estimation, every block of an output is blended from both inputs displaced
+    /// along the block's motion vector, otherwise the inputs are blended in place. Outputs
+    /// are generated tile by tile on a scheduler.
+    ///
+    /// With scene detection, static pairs and scene cuts aren't interpolated at all: every
+    /// output of a static pair is a copy of the newer input, and of a cut one of the older
+    /// input, so the old scene is held until the new one is presented.
+    ///
+    class Interpolator {
+    public:
+        Interpolator() noexcept = default;
+
+        ///
+        /// Create an interpolator for a format.
+        ///
+        /// @param format Vulkan format of the images, see AFMF::supportsFormat.
+        /// @param motion Motion estimation parameters, a block size of 0 disables it.
+        /// @param sceneDetection Whether to duplicate frames instead of generating them on static pairs and cuts.
+        /// @param scheduler Thread pool to generate frames on.
+        ///
+        /// @throws AFMF::vulkan_error if the format or motion estimation parameters are unsupported.
+        ///
+        Interpolator(VkFormat format, const MotionEstimator::Config& motion, bool sceneDetection,
+            std::shared_ptr<Scheduler> scheduler);
+
+        ///
+        /// Generate frames between two inputs.
+        ///
+        /// @param in0 Older input frame.
+        /// @param in1 Newer input frame.
+        /// @param outN Output frames, in presentation order. Without any, nothing is done.
+        ///
+        /// @throws AFMF::vulkan_error if the images don't match the interpolator's format or each other.
+        ///
+        void interpolate(const HostImage& in0, const HostImage& in1,
+            const std::vector<HostImage>& outN);
+
+        /// Get the instruction set the interpolator's kernels use.
+        [[nodiscard]] Kernels::Isa getIsa() const { return this->isa; }
+        /// Check if motion is estimated.
+        [[nodiscard]] bool hasMotion() const { return this->motion; }
+        /// Get the motion estimator, for its counters.
+        [[nodiscard]] const MotionEstimator& getMotionEstimator() const { return this->estimator; }
+        /// Check if frame pairs are classified before generating frames.
+        [[nodiscard]] bool hasSceneDetection() const { return this->sceneDetection; }
+        /// Get the scene detector, for its counters.
+        [[nodiscard]] const SceneDetector& getSceneDetector() const { return this->detector; }
+        /// Get the time spent generating frames so far, in nanoseconds.
+        [[nodiscard]] uint64_t getTime() const { return this->time; }
+        /// Get the scheduler frames are generated on, for its counters.
+        [[nodiscard]] const Scheduler& getScheduler() const { return *this->scheduler; }
+
+        /// Copyable, moveable and destructible
+        Interpolator(const Interpolator&) = default;
+        Interpolator& operator=(const Interpolator&) = default;
+        Interpolator(Interpolator&&) noexcept = default;
+        Interpolator& operator=(Interpolator&&) noexcept = default;
+        ~Interpolator() = default;
+    private:
+        void generate(const HostImage& in0, const HostImage& in1,
+            const std::vector<HostImage>& outN);
+
+        VkFormat format{VK_FORMAT_UNDEFINED};
+        uint32_t pixelSize{};
+        Kernels::Isa isa{Kernels::Isa::Scalar};
+        Kernels::BlendFn blend{};
+        std::shared_ptr<Scheduler> scheduler;
+
+        bool motion{false};
+        MotionEstimator estimator; // unset without motion estimation
+        bool sceneDetection{false};
+        SceneDetector detector; // unset without scene detection
+
+        uint64_t time{};
+    };
+
+}
+
+#endif // AFMF_INTERPOLATOR_HPP
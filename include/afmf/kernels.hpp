@@ -0,0 +1,131 @@
+#ifndef AFMF_KERNELS_HPP
+#define AFMF_KERNELS_HPP
+
+#include <vulkan/vulkan_core.h>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace AFMF::Kernels {
+
+    /// Instruction set the pixel kernels are dispatched to.
+    enum class Isa {
+        /// Portable C++, used on every architecture.
+        Scalar,
+        /// x86 SSE4.1, blending 8-bit formats and block matching only.
+        SSE4,
+        /// x86 AVX2 with F16C and FMA.
+        AVX2
+    };
+
+    ///
+    /// Blend a row of pixels, out = a + (b - a) * weight / 256.
+    ///
+    /// Rows may not overlap. Every channel, including alpha, is blended.
+    ///
+    /// @param a Pixels of the first frame.
+    /// @param b Pixels of the second frame.
+    /// @param out Pixels of the blended frame.
+    /// @param count Amount of pixels in the row.
+    /// @param weight Weight of the second frame, from 0 to 256.
+    ///
+    using BlendFn = void (*)(const void* a, const void* b, void* out, size_t count, uint32_t weight);
+
+    ///
+    /// Convert a row of pixels to 8-bit luma, (R + 2G + B) / 4.
+    ///
+    /// Red and blue are weighted equally, so the channel order doesn't matter.
+    /// FP16 values are clamped to [0, 1].
+    ///
+    /// @param in Pixels to convert.
+    /// @param out Luma samples, one per pixel.
+    /// @param count Amount of pixels in the row.
+    ///
+    using LumaFn = void (*)(const void* in, uint8_t* out, size_t count);
+
+    ///
+    /// Compare two square blocks of 8-bit samples.
+    ///
+    /// @param a First block.
+    /// @param strideA Bytes between two rows of the first block.
+    /// @param b Second block.
+    /// @param strideB Bytes between two rows of the second block.
+    /// @param size Width and height of the blocks, 8, 16 or 32.
+    /// @return The matching cost, 0 for identical blocks.
+    ///
+    using CostFn = uint32_t (*)(const uint8_t* a, size_t strideA,
+        const uint8_t* b, size_t strideB, uint32_t size);
+
+    ///
+    /// Get the instruction set used by the kernels.
+    ///
+    /// Detected on first use from the CPU's features. The AFMF_ISA environment
+    /// variable (scalar, sse4 or avx2) restricts it to a lower one.
+    ///
+    /// @return The instruction set.
+    ///
+    Isa getIsa();
+
+    /// Get the name of an instruction set.
+    const char* getIsaName(Isa isa);
+
+    ///
+    /// Get the size of a pixel in bytes.
+    ///
+    /// @param format Vulkan format, see AFMF::supportsFormat.
+    /// @return The size of a pixel, or 0 if the format is unsupported.
+    ///
+    uint32_t getPixelSize(VkFormat format);
+
+    ///
+    /// Get the blend kernel for a format.
+    ///
+    /// @param format Vulkan format, see AFMF::supportsFormat.
+    /// @param isa Instruction set to use, at most the one returned by getIsa.
+    /// @return The kernel, or nullptr if the format is unsupported.
+    ///
+    BlendFn getBlend(VkFormat format, Isa isa = getIsa());
+
+    ///
+    /// Get the luma conversion kernel for a format.
+    ///
+    /// @param format Vulkan format, see AFMF::supportsFormat.
+    /// @param isa Instruction set to use, at most the one returned by getIsa.
+    /// @return The kernel, or nullptr if the format is unsupported.
+    ///
+    LumaFn getLuma(VkFormat format, Isa isa = getIsa());
+
+    /// Get the sum of absolute differences kernel.
+    CostFn getSad(Isa isa = getIsa());
+    /// Get the sum of absolute Hadamard-transformed differences kernel, over 8x8 sub-blocks.
+    CostFn getSatd(Isa isa = getIsa());
+
+    // per instruction set implementations, only valid if the cpu supports them
+    namespace Scalar {
+        void blendRgba8(const void* a, const void* b, void* out, size_t count, uint32_t weight);
+        void blendRgb10a2(const void* a, const void* b, void* out, size_t count, uint32_t weight);
+        void blendRgba16f(const void* a, const void* b, void* out, size_t count, uint32_t weight);
+        void lumaRgba8(const void* in, uint8_t* out, size_t count);
+        void lumaRgb10a2(const void* in, uint8_t* out, size_t count);
+        void lumaRgba16f(const void* in, uint8_t* out, size_t count);
+        uint32_t sad(const uint8_t* a, size_t strideA, const uint8_t* b, size_t strideB, uint32_t size);
+        uint32_t satd(const uint8_t* a, size_t strideA, const uint8_t* b, size_t strideB, uint32_t size);
+    }
+#if defined(__x86_64__) || defined(__i386__)
+    namespace SSE4 {
+        void blendRgba8(const void* a, const void* b, void* out, size_t count, uint32_t weight);
+        uint32_t sad(const uint8_t* a, size_t strideA, const uint8_t* b, size_t strideB, uint32_t size);
+        uint32_t satd(const uint8_t* a, size_t strideA, const uint8_t* b, size_t strideB, uint32_t size);
+    }
+    namespace AVX2 {
+        void blendRgba8(const void* a, const void* b, void* out, size_t count, uint32_t weight);
+        void blendRgb10a2(const void* a, const void* b, void* out, size_t count, uint32_t weight);
+        void blendRgba16f(const void* a, const void* b, void* out, size_t count, uint32_t weight);
+        void lumaRgba8(const void* in, uint8_t* out, size_t count);
+        uint32_t sad(const uint8_t* a, size_t strideA, const uint8_t* b, size_t strideB, uint32_t size);
+    }
+#endif
+
+}
+
+#endif // AFMF_KERNELS_HPP
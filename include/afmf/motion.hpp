@@ -0,0 +1,180 @@
+#ifndef AFMF_MOTION_HPP
+#define AFMF_MOTION_HPP
+
+#include "afmf/kernels.hpp"
+#include "afmf/scheduler.hpp"
+
+#include <afmf.hpp>
+
+#include <vulkan/vulkan_core.h>
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace AFMF {
+
+    /// Motion of a block, in quarter pixels.
+    struct MotionVector {
+        int16_t x{}; // horizontal offset from the block in the newer frame to its match in the older one
+        int16_t y{}; // vertical offset from the block in the newer frame to its match in the older one
+        uint32_t cost{}; // matching cost of the vector, lower is better
+    };
+
+    ///
+    /// Dense field of motion vectors, one per block.
+    ///
+    /// Blocks are laid out on a grid starting at the top left corner, the last column
+    /// and row may be cut off by the edge of the image.
+    ///
+    struct MotionField {
+        uint32_t columns{}; // amount of blocks per row
+        uint32_t rows{}; // amount of block rows
+        uint32_t blockSize{}; // width and height of a block in pixels
+        std::vector<MotionVector> vectors; // row-major vectors, columns * rows
+
+        /// Get the vector of a block.
+        [[nodiscard]] const MotionVector& at(uint32_t column, uint32_t row) const {
+            return this->vectors.at(static_cast<size_t>(row) * this->columns + column);
+        }
+    };
+
+    /// Block comparisons made by a motion search.
+    struct SearchCost {
+        uint64_t evaluations{}; // comparisons made
+        uint64_t exhaustive{}; // comparisons an exhaustive search of the coarsest level would have made
+    };
+
+    ///
+    /// Hierarchical block-matching motion estimator.
+    ///
+    /// Both frames are converted to luma and downsampled into a pyramid. The coarsest level
+    /// is searched exhaustively, every finer level only refines the vectors of the level
+    /// above it and its neighbours. Matching uses the sum of absolute differences, except
+    /// for the sub-pixel refinement on the full resolution level, which uses the sum of
+    /// absolute Hadamard-transformed differences on bilinearly filtered blocks.
+    ///
+    /// Motion carries over from one frame pair to the next, so the vectors of the previous
+    /// pair seed the search. The coarsest level then only searches a quarter of the range
+    /// around the best of them, unless that matches much worse than the previous pair did.
+    ///
+    /// At a reduced scale, searching stops that many pyramid levels above full resolution and
+    /// the field is upsampled with a joint bilateral filter guided by the luma of the blocks.
+    ///
+    /// Every stage is split into tiles run on a scheduler, the blocks of a tile are searched
+    /// one after the other.
+    ///
+    class MotionEstimator {
+    public:
+        struct Config {
+            uint32_t blockSize{16}; // width and height of a block in pixels, 8, 16 or 32
+            uint32_t searchRange{32}; // maximum offset in pixels searched in each direction
+            uint32_t levels{3}; // maximum amount of pyramid levels, including the full resolution one
+            bool subPixel{true}; // refine vectors to quarter pixels
+            bool temporal{true}; // seed the search with the previous frame pair's vectors
+            uint32_t scale{1}; // estimate motion at 1/scale of the resolution, 1, 2 or 4
+            bool measure{false}; // measure how well every field predicts the newer frame, see getLastPsnr
+        };
+
+        MotionEstimator() noexcept = default;
+
+        ///
+        /// Create a motion estimator.
+        ///
+        /// @param format Vulkan format of the images, see AFMF::supportsFormat.
+        /// @param config Block size and search parameters.
+        /// @param scheduler Thread pool to run the search on.
+        ///
+        /// @throws AFMF::vulkan_error if the format or configuration is unsupported.
+        ///
+        MotionEstimator(VkFormat format, const Config& config, std::shared_ptr<Scheduler> scheduler);
+
+        ///
+        /// Estimate the motion between two frames.
+        ///
+        /// Images smaller than a block only get zero vectors.
+        ///
+        /// @param in0 Older frame.
+        /// @param in1 Newer frame, of the same size and format.
+        /// @return The vector field, valid until the next call.
+        ///
+        const MotionField& estimate(const HostImage& in0, const HostImage& in1);
+
+        ///
+        /// Forget the motion of previous frame pairs.
+        ///
+        /// Call when the next pair doesn't continue the previous one, like after a scene cut.
+        ///
+        void reset();
+
+        /// Get the amount of pixels estimated so far, per frame pair.
+        [[nodiscard]] uint64_t getPixelCount() const { return this->pixelCount; }
+        /// Get the time spent estimating so far, in nanoseconds.
+        [[nodiscard]] uint64_t getTime() const { return this->time; }
+        /// Get the search cost of the last frame pair.
+        [[nodiscard]] const SearchCost& getLastSearchCost() const { return this->lastCost; }
+        /// Get the search cost of every frame pair so far.
+        [[nodiscard]] const SearchCost& getSearchCost() const { return this->totalCost; }
+        ///
+        /// Get how well the last field predicts the newer frame from the older one.
+        ///
+        /// Only measured if enabled in the configuration, on luma at whole pixels.
+        ///
+        /// @return The peak signal-to-noise ratio in dB, infinite for a perfect prediction.
+        ///
+        [[nodiscard]] double getLastPsnr() const { return this->lastPsnr; }
+        /// Get the configuration of the estimator.
+        [[nodiscard]] const Config& getConfig() const { return this->config; }
+
+        /// Copyable, moveable and destructible
+        MotionEstimator(const MotionEstimator&) = default;
+        MotionEstimator& operator=(const MotionEstimator&) = default;
+        MotionEstimator(MotionEstimator&&) noexcept = default;
+        MotionEstimator& operator=(MotionEstimator&&) noexcept = default;
+        ~MotionEstimator() = default;
+    private:
+        struct Plane {
+            uint32_t width{};
+            uint32_t height{};
+            std::vector<uint8_t> data; // 8-bit luma, width bytes per row
+        };
+        using Pyramid = std::vector<Plane>; // index 0 is full resolution
+        struct ThreadCost {
+            SearchCost search;
+            uint64_t coarseCost; // summed cost of the best vectors on the coarsest level
+            uint64_t squaredError; // summed prediction error, if measured
+        };
+
+        uint32_t build(const HostImage& in0, const HostImage& in1);
+        void search(uint32_t level, const std::vector<MotionVector>& parent,
+            uint32_t parentColumns, uint32_t parentRows);
+        void refine(uint32_t level);
+        void upsample(uint32_t level);
+        void measure();
+
+        Config config;
+        std::shared_ptr<Scheduler> scheduler;
+        Kernels::LumaFn luma{};
+        Kernels::CostFn sad{};
+        Kernels::CostFn satd{};
+
+        std::array<Pyramid, 2> pyramids; // luma pyramids of the older and newer frame
+        MotionField field; // field of the level being searched, the result once done
+        MotionField previous; // result for the previous frame pair
+        std::vector<std::vector<uint8_t>> blocks; // filtered block for sub-pixel matching, per thread
+
+        std::vector<ThreadCost> costs; // search cost of the current frame pair, per thread
+        uint64_t coarseBlocks{}; // amount of blocks on the coarsest level
+        uint64_t previousCost{}; // average cost of the best vectors on the previous pair's coarsest level
+        SearchCost lastCost;
+        SearchCost totalCost;
+        double lastPsnr{};
+
+        uint64_t pixelCount{};
+        uint64_t time{};
+    };
+
+}
+
+#endif // AFMF_MOTION_HPP
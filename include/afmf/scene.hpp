@@ -0,0 +1,82 @@
+#ifndef AFMF_SCENE_HPP
+#define AFMF_SCENE_HPP
+
+#include "afmf/kernels.hpp"
+#include "afmf/scheduler.hpp"
+
+#include <afmf.hpp>
+
+#include <vulkan/vulkan_core.h>
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace AFMF {
+
+    /// Relation between two consecutive frames.
+    enum class SceneChange : uint8_t {
+        Static, // nothing visibly changed, generated frames would equal the inputs
+        Normal, // the frames show the same scene, frames are generated
+        Cut // the frames show different scenes, there is nothing to interpolate
+    };
+
+    ///
+    /// Cheap classifier of frame pairs, run before any frames are generated.
+    ///
+    /// Both frames are shrunk to a luma thumbnail at 1/8 of their resolution, averaging
+    /// eight pixels of every eighth row. A pair is static if no thumbnail pixel changed
+    /// by more than noise would, and a cut if both the luma histogram and the thumbnails
+    /// themselves differ substantially. Camera motion alone changes the thumbnails but
+    /// mostly keeps the histogram, so it isn't mistaken for a cut.
+    ///
+    class SceneDetector {
+    public:
+        SceneDetector() noexcept = default;
+
+        ///
+        /// Create a scene detector for a format.
+        ///
+        /// @param format Vulkan format of the images, see AFMF::supportsFormat.
+        /// @param scheduler Thread pool to shrink the frames on.
+        ///
+        /// @throws AFMF::vulkan_error if the format is unsupported.
+        ///
+        SceneDetector(VkFormat format, std::shared_ptr<Scheduler> scheduler);
+
+        ///
+        /// Classify a pair of frames.
+        ///
+        /// @param in0 Older frame.
+        /// @param in1 Newer frame, of the same size and format.
+        /// @return The relation between the frames.
+        ///
+        SceneChange classify(const HostImage& in0, const HostImage& in1);
+
+        /// Get the amount of frame pairs classified as a kind of change so far.
+        [[nodiscard]] uint64_t getCount(SceneChange change) const {
+            return this->counts.at(static_cast<size_t>(change));
+        }
+
+        /// Copyable, moveable and destructible
+        SceneDetector(const SceneDetector&) = default;
+        SceneDetector& operator=(const SceneDetector&) = default;
+        SceneDetector(SceneDetector&&) noexcept = default;
+        SceneDetector& operator=(SceneDetector&&) noexcept = default;
+        ~SceneDetector() = default;
+    private:
+        std::shared_ptr<Scheduler> scheduler;
+        Kernels::LumaFn luma{};
+
+        uint32_t width{}; // width of the thumbnails
+        uint32_t height{}; // height of the thumbnails
+        std::array<std::vector<uint8_t>, 2> thumbnails; // luma thumbnails of the older and newer frame
+        std::vector<std::vector<uint8_t>> rows; // full resolution luma row, per thread
+
+        std::array<uint64_t, 3> counts{}; // frame pairs so far, indexed by SceneChange
+    };
+
+}
+
+#endif // AFMF_SCENE_HPP
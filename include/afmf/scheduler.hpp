@@ -0,0 +1,114 @@
+#ifndef AFMF_SCHEDULER_HPP
+#define AFMF_SCHEDULER_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace AFMF {
+
+    ///
+    /// Work-stealing thread pool for the CPU interpolation stages.
+    ///
+    /// Every job is split into tasks, dealt out to the threads in contiguous chunks.
+    /// Threads take tasks from the front of their own queue and, once it runs dry, steal
+    /// from the back of the others, so expensive tiles don't hold up the rest of a job.
+    /// The thread calling run takes part as thread 0.
+    ///
+    class Scheduler {
+    public:
+        /// Rectangle of cells in a grid, right and bottom exclusive.
+        struct Tile {
+            uint32_t left;
+            uint32_t top;
+            uint32_t right;
+            uint32_t bottom;
+        };
+
+        using TaskFn = std::function<void(size_t task, uint32_t thread)>;
+        using TileFn = std::function<void(const Tile& tile, uint32_t thread)>;
+
+        ///
+        /// Create a scheduler and start its threads.
+        ///
+        /// @param threads Amount of threads including the calling one, or 0 for one per core.
+        /// @param tileSize Width and height of a tile in pixels.
+        ///
+        /// @throws AFMF::vulkan_error if the tile size is 0.
+        ///
+        Scheduler(uint32_t threads, uint32_t tileSize);
+
+        ///
+        /// Run a job and wait for it to finish.
+        ///
+        /// Jobs submitted from several threads run one after the other.
+        ///
+        /// @param count Amount of tasks in the job.
+        /// @param task Function called once per task, with the task and thread index.
+        ///
+        void run(size_t count, const TaskFn& task);
+
+        ///
+        /// Run a job with one task per tile of a grid.
+        ///
+        /// @param columns Width of the grid in cells.
+        /// @param rows Height of the grid in cells.
+        /// @param cellSize Size of a cell in pixels, tiles are cut to whole cells.
+        /// @param tile Function called once per tile, with the tile and thread index.
+        ///
+        void runTiles(uint32_t columns, uint32_t rows, uint32_t cellSize, const TileFn& tile);
+
+        /// Get the amount of threads, including the calling one.
+        [[nodiscard]] uint32_t getThreadCount() const { return static_cast<uint32_t>(this->queues.size()); }
+        /// Get the width and height of a tile in pixels.
+        [[nodiscard]] uint32_t getTileSize() const { return this->tileSize; }
+        /// Get the amount of tasks run so far.
+        [[nodiscard]] uint64_t getTaskCount() const { return this->taskCount.load(); }
+        /// Get the amount of tasks run by a thread they weren't dealt to.
+        [[nodiscard]] uint64_t getStealCount() const { return this->stealCount.load(); }
+
+        // Non-copyable and non-moveable, the threads refer to the scheduler
+        Scheduler(const Scheduler&) = delete;
+        Scheduler& operator=(const Scheduler&) = delete;
+        Scheduler(Scheduler&&) = delete;
+        Scheduler& operator=(Scheduler&&) = delete;
+        ~Scheduler();
+    private:
+        struct Queue {
+            std::mutex mutex;
+            std::deque<size_t> tasks;
+        };
+
+        void work(uint32_t thread);
+        void drain(uint32_t thread, const TaskFn& task);
+
+        uint32_t tileSize;
+        std::vector<std::unique_ptr<Queue>> queues; // indexed by thread
+        std::vector<std::thread> threads; // every thread but the calling one
+
+        std::mutex runMutex; // held for the duration of a job
+        std::mutex mutex; // guards the job state below
+        std::condition_variable cv; // signaled when a job starts or the scheduler stops
+        std::condition_variable doneCv; // signaled when a task or thread finishes
+        const TaskFn* job{}; // current job
+        uint64_t generation{}; // jobs started so far
+        size_t remaining{}; // tasks of the current job not yet finished
+        uint32_t active{}; // threads working on the current job, besides the calling one
+        std::exception_ptr error; // first exception thrown by a task of the current job
+        bool stopping{false};
+
+        std::atomic<uint64_t> taskCount{0};
+        std::atomic<uint64_t> stealCount{0};
+    };
+
+}
+
+#endif // AFMF_SCHEDULER_HPP
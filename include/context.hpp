@@ -2,14 +2,22 @@
 #define CONTEXT_HPP
 
 #include "hooks.hpp"
+#include "multiplier.hpp"
+#include "pacing.hpp"
+#include "presenter.hpp"
 #include "mini/commandbuffer.hpp"
 #include "mini/commandpool.hpp"
+#include "mini/fence.hpp"
 #include "mini/image.hpp"
+#include "mini/imagearena.hpp"
 #include "mini/semaphore.hpp"
+#include "mini/submitbatch.hpp"
 
 #include <array>
+#include <atomic>
 #include <cstdint>
 #include <memory>
+#include <mutex>
 #include <vulkan/vulkan_core.h>
 
 #include <vector>
@@ -25,12 +33,25 @@ public:
     /// @param info The device information to use.
     /// @param swapchain The Vulkan swapchain to use.
     /// @param extent The extent of the swapchain images.
+    /// @param format The format of the swapchain images, shared with AFMF.
     /// @param swapchainImages The swapchain images to use.
+    /// @param framesInFlight Amount of frames that may be in flight, at most info.framesInFlight.
+    /// @param directInput Let AFMF read the swapchain images in place instead of copies.
+    /// @param directOutput Let AFMF write generated frames to acquired swapchain images,
+    ///                     requires directInput and no present thread.
+    /// @param presentThread Acquire, copy and present on a thread of the context's own, through
+    ///                      info.presentQueue. Requires the application to acquire through acquire.
+    /// @param exclusive The swapchain images are owned by a single queue family at a time. They're
+    ///                  presented from info.queue's family and handed to the transfer queue's for copies.
+    /// @param previous Context of the swapchain this one replaces, if any. Its AFMF context
+    ///                 and shared images are reused if the new swapchain fits into them.
     ///
     /// @throws LSFG::vulkan_error if any Vulkan call fails.
     ///
     LsContext(const Hooks::DeviceInfo& info, VkSwapchainKHR swapchain,
-        VkExtent2D extent, const std::vector<VkImage>& swapchainImages);
+        VkExtent2D extent, VkFormat format, const std::vector<VkImage>& swapchainImages,
+        uint32_t framesInFlight, bool directInput = false, bool directOutput = false, bool presentThread = false,
+        bool exclusive = false, const LsContext* previous = nullptr);
 
     ///
     /// Custom present logic.
@@ -41,43 +62,198 @@ public:
     /// @param gameRenderSemaphores The semaphores to wait on before presenting.
     /// @param presentIdx The index of the swapchain image to present.
     /// @return The result of the Vulkan present operation, which can be VK_SUCCESS or VK_SUBOPTIMAL_KHR.
+    ///         With a present thread, frames are handed to it and the result of an earlier
+    ///         present is returned, if it wasn't VK_SUCCESS. Frames with a pNext chain are only
+    ///         handed over if it holds present ids, times and regions alone, which are copied.
     ///
     /// @throws LSFG::vulkan_error if any Vulkan call fails.
     ///
     VkResult present(const Hooks::DeviceInfo& info, const void* pNext, VkQueue queue,
         const std::vector<VkSemaphore>& gameRenderSemaphores, uint32_t presentIdx);
 
-    // Non-copyable, trivially moveable and destructible
+    ///
+    /// Acquire a swapchain image for the application.
+    ///
+    /// The swapchain is shared with the present thread. Rather than blocking on an image
+    /// while holding it, which could keep the present thread from presenting the images
+    /// the application waits for, acquiring waits for the present thread to make progress.
+    ///
+    /// @param info The device information to use.
+    /// @param timeout Longest time to wait for an image, in nanoseconds. It may be exceeded
+    ///                until the present thread finishes its current frame.
+    /// @param semaphore Semaphore to signal once the image is ready, or VK_NULL_HANDLE.
+    /// @param fence Fence to signal once the image is ready, or VK_NULL_HANDLE.
+    /// @param pImageIndex Index of the acquired image.
+    /// @return The result of vkAcquireNextImageKHR.
+    ///
+    VkResult acquire(const Hooks::DeviceInfo& info, uint64_t timeout,
+        VkSemaphore semaphore, VkFence fence, uint32_t* pImageIndex);
+
+    ///
+    /// Acquire a swapchain image for the application through vkAcquireNextImage2KHR.
+    ///
+    /// @param info The device information to use.
+    /// @param acquireInfo Acquire info of the application, for this context's swapchain.
+    /// @param pImageIndex Index of the acquired image.
+    /// @return The result of vkAcquireNextImage2KHR.
+    ///
+    VkResult acquire(const Hooks::DeviceInfo& info, const VkAcquireNextImageInfoKHR& acquireInfo,
+        uint32_t* pImageIndex);
+
+    ///
+    /// Wait until the present thread has presented every frame handed to it.
+    ///
+    void waitIdle() const;
+
+    /// Get the amount of Vulkan objects the last present created on the application's thread.
+    [[nodiscard]] uint64_t getFrameCreations() const { return this->frameCreations; }
+    /// Get the amount of queue submissions made during the last present.
+    [[nodiscard]] uint32_t getFrameSubmits() const { return this->frameSubmits; }
+    /// Get the amount of presents that found every render pass in flight.
+    [[nodiscard]] uint64_t getBackpressureCount() const { return this->backpressureCount; }
+    /// Get the amount of presents that skipped frame generation because of backpressure.
+    [[nodiscard]] uint64_t getSkippedCount() const { return this->skippedCount; }
+    /// Get the controller picking the amount of frames to generate.
+    [[nodiscard]] const MultiplierController& getMultiplier() const { return this->multiplier; }
+    /// Get the pacer spreading out the presents of a frame.
+    [[nodiscard]] const FramePacer& getPacer() const { return this->pacer; }
+    /// Get the time the application's thread spent in the last present, in nanoseconds.
+    [[nodiscard]] uint64_t getLastHookTime() const { return this->lastHookTime; }
+    /// Get the averaged time the application's thread spends per present, in nanoseconds.
+    [[nodiscard]] uint64_t getHookTime() const { return this->hookTime; }
+    /// Get the longest time the application's thread spent in a present, in nanoseconds.
+    [[nodiscard]] uint64_t getMaxHookTime() const { return this->maxHookTime; }
+
+    // Non-copyable and non-moveable, the present thread refers to the context
     LsContext(const LsContext&) = delete;
     LsContext& operator=(const LsContext&) = delete;
-    LsContext(LsContext&&) = default;
-    LsContext& operator=(LsContext&&) = default;
+    LsContext(LsContext&&) = delete;
+    LsContext& operator=(LsContext&&) = delete;
     ~LsContext() = default;
 private:
+    struct RenderPassInfo;
+    struct PresentChain;
+
+    static bool copyPresentChain(PresentChain& chain, const void* pNext);
+    VkResult queueFrame(const Hooks::DeviceInfo& info, const void* pNext, VkQueue queue,
+        const std::vector<VkSemaphore>& gameRenderSemaphores, uint32_t presentIdx);
+    void presentPass(const Hooks::DeviceInfo& info, uint64_t passIdx);
+    void postCopy(const Hooks::DeviceInfo& info, RenderPassInfo& pass);
+    VkResult presentFrames(const Hooks::DeviceInfo& info, VkQueue queue,
+        RenderPassInfo& pass, const void* pNext);
+    template<typename AcquireFn>
+    VkResult acquireImage(uint64_t timeout, const AcquireFn& acquire);
+    void measurePresents(const Hooks::DeviceInfo& info, uint64_t frameTime);
+    const void* pace(size_t i, uint64_t time, const void* pNext);
+
     VkSwapchainKHR swapchain;
     std::vector<VkImage> swapchainImages;
     VkExtent2D extent;
+    VkExtent2D capacity; // extent of the shared images, at least the swapchain's
+    VkFormat format;
+    bool directInput; // lsfg reads swapchain images in place, frame_0/frame_1 are unused
+    bool directOutput; // lsfg writes to acquired swapchain images, out_n is unused
+    uint32_t imageFamily; // queue family owning the swapchain images outside the copies, ignored if they're shared
 
     std::shared_ptr<int32_t> lsfgCtxId; // lsfg context id
+    Mini::ImageArena arena; // memory block shared with lsfg, backing frame_0, frame_1 and out_n
     Mini::Image frame_0, frame_1; // frames shared with lsfg. write to frame_0 when fc % 2 == 0
     std::vector<Mini::Image> out_n; // output images shared with lsfg, indexed by framegen id
+    Mini::Semaphore syncSemaphore; // timeline semaphore shared with lsfg, if supported
 
     Mini::CommandPool cmdPool;
-    uint64_t frameIdx{0};
+    Mini::SubmitBatch submitBatch; // collects the submissions of a frame on the application's thread
+    Mini::SubmitBatch copyBatch; // collects the post-copies of a frame, wherever it's presented
+    uint64_t frameIdx{0}; // continues from the previous swapchain's context if it was reused
+    uint64_t firstFrameIdx{0}; // frame index of the first present on this swapchain
+    uint64_t frameCreations{0}; // vulkan objects created during the last present
+    uint32_t frameSubmits{0}; // queue submissions made on the application's thread during the last present
+
+    // copy commands are recorded once per swapchain and only selected when presenting
+    std::vector<std::array<Mini::CommandBuffer, 2>> preCopyBufs; // copy from swapchain image n to frame_0/frame_1, unless direct input
+    std::vector<std::vector<Mini::CommandBuffer>> postCopyBufs; // copy from out_n[i] to swapchain image n, indexed by i then n, unless direct output
+
+    // swapchain images owned by imageFamily are released to the transfer queue before being
+    // read, and acquired back after being read or written. these are that family's halves.
+    Mini::CommandPool ownershipPool;
+    Mini::SubmitBatch ownershipBatch; // collects the acquires of a frame's presents
+    std::vector<std::array<Mini::CommandBuffer, 3>> ownershipBufs; // release, acquire after read, acquire after write of swapchain image n
+    std::vector<std::vector<VkSemaphore>> presentWaits; // semaphores each present of a frame waits on, kept between frames
+
+    // copy of the structures of an application's present chain the present thread can present
+    // with, for the first swapchain only. storage is kept between frames.
+    struct PresentChain {
+        const void* pNext{nullptr}; // first copied structure, in the application's order
+        uint64_t presentId{0};
+        VkPresentIdKHR presentIdInfo{};
+        VkPresentTimeGOOGLE presentTime{};
+        VkPresentTimesInfoGOOGLE presentTimesInfo{};
+        std::vector<VkRectLayerKHR> rectangles;
+        VkPresentRegionKHR presentRegion{};
+        VkPresentRegionsKHR presentRegionsInfo{};
+    };
 
     struct RenderPassInfo {
-        Mini::CommandBuffer preCopyBuf; // copy from swapchain image to frame_0/frame_1
-        std::array<Mini::Semaphore, 2> preCopySemaphores; // signal when preCopyBuf is done
+        Mini::Fence fence; // signal when the last submission of this pass is done
+        bool pending{false}; // true if the fence has been submitted and not waited on yet
 
+        // binary semaphores, replaced by values on syncSemaphore in timeline mode
+        std::array<Mini::Semaphore, 2> preCopySemaphores; // signal when preCopyBuf (or the game's frame) is done
         std::vector<Mini::Semaphore> renderSemaphores; // signal when lsfg is done with frame n
 
         std::vector<Mini::Semaphore> acquireSemaphores; // signal for swapchain image n
+        std::vector<uint32_t> acquiredImages; // swapchain image acquired for frame n
 
-        std::vector<Mini::CommandBuffer> postCopyBufs; // copy from out_n to swapchain image
-        std::vector<Mini::Semaphore> postCopySemaphores; // signal when postCopyBuf is done
+        std::vector<Mini::Semaphore> postCopySemaphores; // signal when postCopyBuf (or lsfg's direct output) is done, without any when the real frame is ready
         std::vector<Mini::Semaphore> prevPostCopySemaphores; // signal for previous postCopyBuf
-    }; // data for a single render pass
-    std::array<RenderPassInfo, 8> passInfos; // allocate 8 because why not
+
+        // ownership transfers, if the swapchain images are owned by imageFamily
+        Mini::Semaphore releaseSemaphore; // signal when the real frame is released to the transfer queue
+        std::vector<Mini::Semaphore> presentSemaphores; // signal when swapchain image n is acquired back, the real frame's last
+
+        // frame to present, written before the pass is handed to the present thread
+        uint64_t count{0}; // amount of generated frames
+        uint32_t presentIdx{0}; // swapchain image of the real frame
+        uint64_t frameTime{0}; // predicted time until the next real frame
+        uint64_t timelineBase{0};
+        PresentChain chain; // application's present chain, if handed to the present thread
+    }; // data for a single render pass, recycled once its fence has signaled
+    std::vector<RenderPassInfo> passInfos; // ring of in-flight render passes
+
+    uint64_t backpressureCount{0}; // presents that found the ring full
+    uint64_t skippedCount{0}; // presents that skipped generation because the ring was full
+
+    MultiplierController multiplier; // picks the amount of frames to generate per present, at most info.frameGen
+    uint64_t generationTime{0}; // time afmf had spent generating at the last present
+
+    // present times of a frame are passed to the driver or waited for, see PacingMethod
+    PacingMethod pacing{PacingMethod::None};
+    FramePacer pacer;
+    PFN_vkGetPastPresentationTimingGOOGLE getPastPresentationTiming{};
+    PFN_vkWaitForPresentKHR waitForPresent{};
+    uint64_t presentId{0}; // id of the last present on this swapchain
+    bool applicationIds{false}; // the application sets present ids itself, so none are added
+    uint64_t realPresentId{0}; // id of the last real frame's present, 0 if it had none
+    uint64_t realPresentTime{0}; // time the last real frame was scheduled for
+    // per-present structures chained into the present infos, indexed by frame of the present
+    std::vector<VkPresentTimeGOOGLE> presentTimes;
+    std::vector<VkPresentTimesInfoGOOGLE> presentTimesInfos;
+    std::vector<uint64_t> presentIds;
+    std::vector<VkPresentIdKHR> presentIdInfos;
+    std::vector<VkPastPresentationTimingGOOGLE> pastTimings; // storage for timing feedback
+
+    // time the application's thread spends presenting, see present
+    uint64_t lastHookTime{0};
+    uint64_t hookTime{0};
+    uint64_t maxHookTime{0};
+
+    // with a present thread, the application's thread only submits the pre-copy and hands the
+    // pass over. swapchain and transfer queue are shared then, and locked around every use.
+    std::mutex swapchainMutex;
+    std::shared_ptr<std::mutex> transferMutex; // shared by every context of the device
+    std::atomic<uint32_t> postCopies{0}; // passes the present thread has submitted post-copies for
+    std::atomic<VkResult> presentResult{VK_SUCCESS}; // last unsuccessful result of the present thread
+    std::unique_ptr<Presenter> presenter; // declared last, so its thread stops before anything it uses is destroyed
 };
 
 #endif // CONTEXT_HPP
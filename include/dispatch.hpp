@@ -0,0 +1,86 @@
+#ifndef DISPATCH_HPP
+#define DISPATCH_HPP
+
+#include <vulkan/vulkan_core.h>
+
+//
+// Dispatch tables of the Vulkan functions AFMF calls. Handles of instances and devices
+// created through a layer must only be passed to the functions of the next layer, so
+// AFMF never calls the loader's global functions directly. Tables are filled once per
+// instance and device, from the next layer's or the loader's vkGet*ProcAddr.
+//
+
+namespace Hooks {
+
+    /// Instance functions calls are passed on to.
+    struct InstanceDispatch {
+        PFN_vkGetInstanceProcAddr getInstanceProcAddr;
+        PFN_vkDestroyInstance destroyInstance;
+        PFN_vkEnumerateDeviceExtensionProperties enumerateDeviceExtensionProperties;
+        PFN_vkGetPhysicalDeviceQueueFamilyProperties getPhysicalDeviceQueueFamilyProperties;
+        PFN_vkGetPhysicalDeviceFeatures2 getPhysicalDeviceFeatures2;
+        PFN_vkGetPhysicalDeviceMemoryProperties getPhysicalDeviceMemoryProperties;
+        PFN_vkGetPhysicalDeviceFormatProperties getPhysicalDeviceFormatProperties;
+        PFN_vkGetPhysicalDeviceImageFormatProperties2 getPhysicalDeviceImageFormatProperties2;
+        PFN_vkGetPhysicalDeviceSurfaceSupportKHR getPhysicalDeviceSurfaceSupport;
+        PFN_vkGetPhysicalDeviceSurfaceCapabilitiesKHR getPhysicalDeviceSurfaceCapabilities;
+        PFN_vkGetPhysicalDeviceSurfacePresentModesKHR getPhysicalDeviceSurfacePresentModes;
+    };
+
+    /// Device functions hooked calls are passed on to, and AFMF calls itself.
+    struct DeviceDispatch {
+        const InstanceDispatch* instance; // functions of the instance of the physical device
+
+        // hooked functions
+        PFN_vkGetDeviceProcAddr getDeviceProcAddr;
+        PFN_vkDestroyDevice destroyDevice;
+        PFN_vkGetDeviceQueue getDeviceQueue;
+        PFN_vkCreateSwapchainKHR createSwapchain;
+        PFN_vkDestroySwapchainKHR destroySwapchain;
+        PFN_vkGetSwapchainImagesKHR getSwapchainImages;
+        PFN_vkAcquireNextImageKHR acquireNextImage;
+        PFN_vkAcquireNextImage2KHR acquireNextImage2; // null if unsupported by the device
+        PFN_vkQueuePresentKHR queuePresent;
+
+        // functions of the mini wrappers
+        PFN_vkQueueSubmit queueSubmit;
+        PFN_vkCreateBuffer createBuffer;
+        PFN_vkDestroyBuffer destroyBuffer;
+        PFN_vkGetBufferMemoryRequirements getBufferMemoryRequirements;
+        PFN_vkBindBufferMemory bindBufferMemory;
+        PFN_vkCreateImage createImage;
+        PFN_vkDestroyImage destroyImage;
+        PFN_vkGetImageMemoryRequirements getImageMemoryRequirements;
+        PFN_vkGetImageMemoryRequirements2 getImageMemoryRequirements2;
+        PFN_vkBindImageMemory bindImageMemory;
+        PFN_vkAllocateMemory allocateMemory;
+        PFN_vkFreeMemory freeMemory;
+        PFN_vkMapMemory mapMemory;
+        PFN_vkGetMemoryFdKHR getMemoryFd;
+        PFN_vkCreateCommandPool createCommandPool;
+        PFN_vkDestroyCommandPool destroyCommandPool;
+        PFN_vkAllocateCommandBuffers allocateCommandBuffers;
+        PFN_vkFreeCommandBuffers freeCommandBuffers;
+        PFN_vkBeginCommandBuffer beginCommandBuffer;
+        PFN_vkEndCommandBuffer endCommandBuffer;
+        PFN_vkCreateFence createFence;
+        PFN_vkDestroyFence destroyFence;
+        PFN_vkResetFences resetFences;
+        PFN_vkWaitForFences waitForFences;
+        PFN_vkCreateSemaphore createSemaphore;
+        PFN_vkDestroySemaphore destroySemaphore;
+        PFN_vkGetSemaphoreFdKHR getSemaphoreFd;
+        PFN_vkImportSemaphoreFdKHR importSemaphoreFd;
+        PFN_vkWaitSemaphoresKHR waitSemaphores; // null without timeline semaphores
+        PFN_vkSignalSemaphoreKHR signalSemaphore; // null without timeline semaphores
+
+        // recorded commands
+        PFN_vkCmdPipelineBarrier cmdPipelineBarrier;
+        PFN_vkCmdCopyImage cmdCopyImage;
+        PFN_vkCmdCopyImageToBuffer cmdCopyImageToBuffer;
+        PFN_vkCmdCopyBufferToImage cmdCopyBufferToImage;
+    };
+
+}
+
+#endif // DISPATCH_HPP
@@ -1,24 +1,145 @@
 #ifndef HOOKS_HPP
 #define HOOKS_HPP
 
+#include "dispatch.hpp"
+#include "pacing.hpp"
+
+#include <vulkan/vk_layer.h>
 #include <vulkan/vulkan_core.h>
 
+#include <array>
+#include <memory>
+#include <mutex>
+#include <string_view>
 #include <utility>
+#include <vector>
+
+//
+// Hooks of the Vulkan functions AFMF intercepts. They are installed by either of
+// two front-ends: the dynamic and Vulkan loader overrides in src/loader, or the
+// implicit Vulkan layer in src/layer.
+//
+// Calls are passed on through per-instance and per-device dispatch tables, holding
+// the functions of the Vulkan loader or of the next layer, respectively.
+//
 
 namespace Hooks {
 
+    /// Vulkan instance information structure.
+    struct InstanceInfo {
+        VkInstance instance;
+        InstanceDispatch next; // functions of the next layer or the loader
+    };
+
     /// Vulkan device information structure.
     struct DeviceInfo {
         VkDevice device;
         VkPhysicalDevice physicalDevice;
+        DeviceDispatch next; // functions of the next layer or the loader
         std::pair<uint32_t, VkQueue> queue; // graphics family
-        uint64_t frameGen; // amount of frames to generate
+        std::pair<uint32_t, VkQueue> transferQueue; // transfer-only or async compute family, or graphics family
+        std::shared_ptr<std::mutex> transferMutex; // held while submitting to the transfer queue
+        std::pair<uint32_t, VkQueue> presentQueue; // graphics family queue of afmf's own for the present thread, or null
+        std::vector<uint32_t> queueFamilies; // all queue families enabled on the device
+        uint64_t frameGen; // most frames to generate, resources are allocated for these
+        uint32_t refreshRate; // display refresh rate to generate frames up to in Hz, or 0 to always generate frameGen
+        PacingMethod pacing; // way generated frames are spread across the real frame time
+        VkPresentModeKHR presentMode; // present mode of swapchains, if supported by the surface
+        uint32_t framesInFlight; // amount of frames the cpu may run ahead of the gpu
+        bool skipWhenFull; // skip frame generation instead of waiting when all frames are in flight
+        bool timelineSemaphores; // synchronize through a single timeline semaphore
+        bool zeroCopy; // let afmf read and write swapchain images in place where supported
+        uint32_t blockSize; // motion estimation block size in pixels, or 0 to blend without motion
+        uint32_t searchRange; // furthest motion searched for in pixels
+        uint32_t motionScale; // estimate motion at 1/motionScale of the resolution
+        bool sceneDetection; // duplicate frames instead of generating them on static frames and scene cuts
+        uint32_t threads; // threads generating frames, or 0 for one per core
+        uint32_t tileSize; // width and height of the tiles frames are split into, in pixels
     };
 
     ///
-    /// Install overrides for hooked Vulkan functions.
+    /// Create an instance with the extensions AFMF needs and the information AFMF keeps for it.
+    /// AFMF must be initialized.
+    ///
+    /// @param pCreateInfo The application's create info.
+    /// @param pAllocator The application's allocator.
+    /// @param pInstance The created instance.
+    /// @param createInstance Function creating the instance, of the next layer or the loader.
+    /// @param getInstanceProcAddr Function looking up the functions of the created instance.
+    /// @return The result of createInstance.
+    ///
+    VkResult createInstance(const VkInstanceCreateInfo* pCreateInfo,
+        const VkAllocationCallbacks* pAllocator, VkInstance* pInstance,
+        PFN_vkCreateInstance createInstance, PFN_vkGetInstanceProcAddr getInstanceProcAddr);
+
+    ///
+    /// Destroy an instance and the information AFMF keeps for it.
+    ///
+    /// @param instance The instance to destroy.
+    /// @param pAllocator The application's allocator.
+    ///
+    void destroyInstance(VkInstance instance, const VkAllocationCallbacks* pAllocator);
+
+    ///
+    /// Find the information AFMF keeps for an instance.
+    ///
+    /// @param handle The instance, or a physical device of it.
+    /// @return The instance information, or nullptr if it wasn't created through AFMF.
+    ///
+    const InstanceInfo* findInstance(void* handle);
+
+    ///
+    /// Create a device and the information AFMF keeps for it.
     ///
-    void initialize();
+    /// @param physicalDevice The physical device to create the device on.
+    /// @param pCreateInfo The application's create info.
+    /// @param pAllocator The application's allocator.
+    /// @param pDevice The created device.
+    /// @param createDevice Function creating the device, of the next layer or the loader.
+    /// @param getDeviceProcAddr Function looking up the functions of the created device.
+    /// @param setLoaderData Function initializing queues retrieved from the next layer,
+    ///                      or nullptr when calling the loader.
+    /// @return The result of createDevice.
+    ///
+    VkResult createDevice(VkPhysicalDevice physicalDevice, const VkDeviceCreateInfo* pCreateInfo,
+        const VkAllocationCallbacks* pAllocator, VkDevice* pDevice,
+        PFN_vkCreateDevice createDevice, PFN_vkGetDeviceProcAddr getDeviceProcAddr,
+        PFN_vkSetDeviceLoaderData setLoaderData);
+
+    ///
+    /// Get the functions calls on a device are passed on to.
+    ///
+    /// @param handle The device, or a queue of it.
+    /// @return The dispatch table of the device, or the loader's if AFMF doesn't know it.
+    ///
+    const DeviceDispatch& next(void* handle);
+
+    ///
+    /// Set the functions calls on instances and devices created before AFMF was loaded are
+    /// passed on to. Only the preloaded library sets these, the layer sees every instance.
+    ///
+    /// @param instance Instance functions of the loader, must outlive AFMF.
+    /// @param device Device functions of the loader, must outlive AFMF. Only the hooked
+    ///               functions are used.
+    ///
+    void setLoaderDispatch(const InstanceDispatch& instance, const DeviceDispatch& device);
+
+    ///
+    /// Get the key of a dispatchable handle. Dispatchable handles start with the loader's
+    /// dispatch table, which a device shares with its queues and an instance with its
+    /// physical devices.
+    ///
+    inline void* dispatchKey(void* handle) { return *static_cast<void**>(handle); }
+
+    /// Hooked Vulkan function.
+    struct Hook {
+        std::string_view name;
+        PFN_vkVoidFunction function;
+    };
+
+    /// Hooks of device functions, passing calls on through the device's dispatch table.
+    /// Installed as they are by either front-end.
+    extern const std::array<Hook, 6> deviceHooks;
 
 }
 
@@ -0,0 +1,20 @@
+#ifndef LAYER_HPP
+#define LAYER_HPP
+
+#include <vulkan/vk_layer.h>
+
+//
+// As an alternative to the loaders, AFMF can be built as an implicit Vulkan layer.
+// The Vulkan loader then calls the functions AFMF hooks through the layer, and every
+// other function straight on the next layer, through dispatch tables kept per instance
+// and device. Nothing is interposed process-wide.
+//
+// The layer is described to the loader by VkLayer_AFMF.json, and only loaded while
+// AFMF_ENABLE=1 is set.
+//
+
+/// Negotiate the loader-layer interface, the only function the layer exports.
+extern "C" VKAPI_ATTR VkResult VKAPI_CALL vkNegotiateLoaderLayerInterfaceVersion(
+    VkNegotiateLayerInterface* pVersionStruct);
+
+#endif // LAYER_HPP
@@ -1,7 +1,9 @@
 #ifndef DL_HPP
 #define DL_HPP
 
+#include <functional>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 
 //
@@ -15,6 +17,15 @@
 
 namespace Loader::DL {
 
+    /// Hash for maps keyed by strings, allowing lookups by string_view without allocating.
+    struct StringHash {
+        using is_transparent = void;
+        size_t operator()(std::string_view str) const { return std::hash<std::string_view>{}(str); }
+    };
+    /// Map from strings to values, see StringHash.
+    template<typename Value>
+    using StringMap = std::unordered_map<std::string, Value, StringHash, std::equal_to<>>;
+
     /// Dynamic loader override structure.
     class File {
     public:
@@ -39,10 +50,10 @@ namespace Loader::DL {
         /// Get the filename
         [[nodiscard]] const std::string& getFilename() const { return filename; }
         /// Get all overriden symbols
-        [[nodiscard]] const std::unordered_map<std::string, void*>& getSymbols() const { return symbols; }
+        [[nodiscard]] const StringMap<void*>& getSymbols() const { return symbols; }
 
         // Find a specific symbol
-        [[nodiscard]] void* findSymbol(const std::string& symbol) const {
+        [[nodiscard]] void* findSymbol(std::string_view symbol) const {
             auto it = symbols.find(symbol);
             return (it != symbols.end()) ? it->second : nullptr;
         }
@@ -65,7 +76,7 @@ namespace Loader::DL {
         ~File() = default;
     private:
         std::string filename;
-        std::unordered_map<std::string, void*> symbols;
+        StringMap<void*> symbols;
 
         void* handle = nullptr;
         void* handle_orig = nullptr;
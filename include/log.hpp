@@ -1,18 +1,34 @@
 #ifndef LOG_HPP
 #define LOG_HPP
 
-#include <iostream>
-#include <sstream>
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
 #include <string>
+#include <string_view>
 
 // Check if std::format is available
 #if __has_include(<format>) && __cpp_lib_format >= 202110L
 #include <format>
 #define HAS_STD_FORMAT 1
 #else
+#include <charconv>
+#include <iterator>
+#include <type_traits>
 #define HAS_STD_FORMAT 0
 #endif
 
+//
+// Messages are formatted on the calling thread and queued into a lock-free ring,
+// which a background thread writes to stderr. Logging never waits for stderr,
+// and messages logged while the ring is full are dropped and counted instead.
+//
+// Messages below the level set through AFMF_LOG_LEVEL (debug, info, warn, error
+// or none, info by default) are discarded before formatting. Debug messages are
+// compiled out of release builds entirely.
+//
+
 namespace Log {
 
     const std::string_view WHITE = "\033[1;37m";
@@ -21,85 +37,175 @@ namespace Log {
     const std::string_view GRAY = "\033[1;90m";
     const std::string_view RESET = "\033[0m";
 
+    /// Severity of a message.
+    enum class Level : uint8_t { Debug, Info, Warn, Error, None };
+
+#ifdef NDEBUG
+    constexpr bool debugBuild = false;
+#else
+    constexpr bool debugBuild = true;
+#endif
+
+    /// Longest message kept, longer ones are cut off.
+    constexpr size_t maxMessageLength = 256;
+
+    ///
+    /// Get the lowest level logged, read from AFMF_LOG_LEVEL on first use.
+    ///
+    Level getLevel();
+
+    ///
+    /// Queue a formatted message for the background thread.
+    ///
+    /// @param level The severity of the message.
+    /// @param message The message, at most maxMessageLength characters.
+    /// @param truncated Whether the message was cut off.
+    ///
+    void push(Level level, std::string_view message, bool truncated = false);
+
+    ///
+    /// Write every queued message to stderr on the calling thread.
+    ///
+    void flush();
+
+    /// Get the amount of messages dropped because the ring was full.
+    uint64_t getDroppedCount();
+
 #if HAS_STD_FORMAT
+    template<typename... Args>
+    void log(Level level, std::format_string<Args...> fmt, Args&&... args) {
+        if (level < getLevel())
+            return;
+
+        std::array<char, maxMessageLength> message; // NOLINT
+        const auto result = std::format_to_n(message.data(), static_cast<std::ptrdiff_t>(message.size()),
+            fmt, std::forward<Args>(args)...);
+        const auto length = std::min(static_cast<size_t>(result.size), message.size());
+        push(level, std::string_view(message.data(), length), length < static_cast<size_t>(result.size));
+    }
+
     template<typename... Args>
     void info(std::format_string<Args...> fmt, Args&&... args) {
-        std::cerr << WHITE << std::format(fmt, std::forward<Args>(args)...) << RESET << '\n';
+        log(Level::Info, fmt, std::forward<Args>(args)...);
     }
 
     template<typename... Args>
     void warn(std::format_string<Args...> fmt, Args&&... args) {
-        std::cerr << YELLOW << std::format(fmt, std::forward<Args>(args)...) << RESET << '\n';
+        log(Level::Warn, fmt, std::forward<Args>(args)...);
     }
 
     template<typename... Args>
     void error(std::format_string<Args...> fmt, Args&&... args) {
-        std::cerr << RED << std::format(fmt, std::forward<Args>(args)...) << RESET << '\n';
+        log(Level::Error, fmt, std::forward<Args>(args)...);
     }
 
     template<typename... Args>
     void debug(std::format_string<Args...> fmt, Args&&... args) {
-        std::cerr << GRAY << std::format(fmt, std::forward<Args>(args)...) << RESET << '\n';
+        if constexpr (debugBuild)
+            log(Level::Debug, fmt, std::forward<Args>(args)...);
     }
 #else
-    // Simple replacement function for basic {} placeholders
-    template<typename T>
-    std::string simple_format_impl(std::string str, T&& value) {
-        size_t pos = str.find("{}");
-        if (pos != std::string::npos) {
-            std::ostringstream oss;
-            oss << std::forward<T>(value);
-            str.replace(pos, 2, oss.str());
+    ///
+    /// Message formatted without std::format, in place and cut off at maxMessageLength.
+    ///
+    /// Supports the {} and {:x} placeholders of strings, characters, booleans, numbers,
+    /// enums and pointers, which is all AFMF logs.
+    ///
+    class Message {
+    public:
+        /// Append text, cutting it off once the message is full.
+        void append(std::string_view text) {
+            const size_t count = std::min(text.size(), this->data.size() - this->length);
+            std::copy_n(text.data(), count, std::next(this->data.begin(), static_cast<std::ptrdiff_t>(this->length)));
+            this->length += count;
+            this->truncated = this->truncated || count < text.size();
         }
-        return str;
-    }
 
-    template<typename T, typename... Args>
-    std::string simple_format_impl(std::string str, T&& value, Args&&... args) {
-        size_t pos = str.find("{}");
-        if (pos != std::string::npos) {
-            std::ostringstream oss;
-            oss << std::forward<T>(value);
-            str.replace(pos, 2, oss.str());
+        /// Append a value like std::format would for {}, or {:x} if hex is set.
+        template<typename T>
+        void append(const T& value, bool hex) {
+            using Type = std::remove_cvref_t<T>;
+            if constexpr (std::is_same_v<Type, bool>) {
+                this->append(value ? "true" : "false");
+            } else if constexpr (std::is_same_v<Type, char>) {
+                this->append(std::string_view(&value, 1));
+            } else if constexpr (std::is_integral_v<Type>) {
+                this->appendChars(value, hex ? 16 : 10);
+            } else if constexpr (std::is_floating_point_v<Type>) {
+                this->appendChars(value);
+            } else if constexpr (std::is_enum_v<Type>) {
+                this->append(static_cast<std::underlying_type_t<Type>>(value), hex);
+            } else if constexpr (std::is_pointer_v<Type> && !std::is_convertible_v<Type, const char*>) {
+                this->append("0x");
+                this->appendChars(reinterpret_cast<uintptr_t>(value), 16);
+            } else {
+                this->append(std::string_view(value));
+            }
+        }
+
+        /// Get the formatted message.
+        [[nodiscard]] std::string_view view() const { return { this->data.data(), this->length }; }
+        /// Check if the message was cut off.
+        [[nodiscard]] bool isTruncated() const { return this->truncated; }
+    private:
+        template<typename T, typename... Base>
+        void appendChars(T value, Base... base) {
+            std::array<char, 32> chars; // NOLINT
+            const auto result = std::to_chars(chars.data(), chars.data() + chars.size(), value, base...);
+            this->append(std::string_view(chars.data(), static_cast<size_t>(result.ptr - chars.data())));
+        }
+
+        std::array<char, maxMessageLength> data; // NOLINT
+        size_t length{};
+        bool truncated{false};
+    };
+
+    // append fmt up to its next placeholder and the value in place of it, consuming both
+    template<typename T>
+    void formatNext(Message& message, std::string_view& fmt, const T& value) {
+        const size_t open = fmt.find('{');
+        const size_t close = fmt.find('}', open);
+        if (close == std::string_view::npos) {
+            message.append(fmt);
+            fmt = {};
+            return;
         }
-        return simple_format_impl(str, std::forward<Args>(args)...);
+        message.append(fmt.substr(0, open));
+        message.append(value, fmt.substr(open, close + 1 - open) == "{:x}");
+        fmt.remove_prefix(close + 1);
     }
 
     // Fallback implementations for older compilers
     template<typename... Args>
-    void info(const std::string& fmt, Args&&... args) {
-        if constexpr (sizeof...(Args) > 0) {
-            std::cerr << WHITE << simple_format_impl(fmt, std::forward<Args>(args)...) << RESET << '\n';
-        } else {
-            std::cerr << WHITE << fmt << RESET << '\n';
-        }
+    void log(Level level, std::string_view fmt, const Args&... args) {
+        if (level < getLevel())
+            return;
+
+        Message message;
+        (formatNext(message, fmt, args), ...);
+        message.append(fmt);
+        push(level, message.view(), message.isTruncated());
     }
 
     template<typename... Args>
-    void warn(const std::string& fmt, Args&&... args) {
-        if constexpr (sizeof...(Args) > 0) {
-            std::cerr << YELLOW << simple_format_impl(fmt, std::forward<Args>(args)...) << RESET << '\n';
-        } else {
-            std::cerr << YELLOW << fmt << RESET << '\n';
-        }
+    void info(std::string_view fmt, const Args&... args) {
+        log(Level::Info, fmt, args...);
     }
 
     template<typename... Args>
-    void error(const std::string& fmt, Args&&... args) {
-        if constexpr (sizeof...(Args) > 0) {
-            std::cerr << RED << simple_format_impl(fmt, std::forward<Args>(args)...) << RESET << '\n';
-        } else {
-            std::cerr << RED << fmt << RESET << '\n';
-        }
+    void warn(std::string_view fmt, const Args&... args) {
+        log(Level::Warn, fmt, args...);
     }
 
     template<typename... Args>
-    void debug(const std::string& fmt, Args&&... args) {
-        if constexpr (sizeof...(Args) > 0) {
-            std::cerr << GRAY << simple_format_impl(fmt, std::forward<Args>(args)...) << RESET << '\n';
-        } else {
-            std::cerr << GRAY << fmt << RESET << '\n';
-        }
+    void error(std::string_view fmt, const Args&... args) {
+        log(Level::Error, fmt, args...);
+    }
+
+    template<typename... Args>
+    void debug(std::string_view fmt, const Args&... args) {
+        if constexpr (debugBuild)
+            log(Level::Debug, fmt, args...);
     }
 #endif
 
@@ -0,0 +1,61 @@
+#ifndef BUFFER_HPP
+#define BUFFER_HPP
+
+#include "dispatch.hpp"
+
+#include <vulkan/vulkan_core.h>
+
+#include <cstdint>
+#include <memory>
+
+namespace Mini {
+
+    ///
+    /// C++ wrapper class for a host-visible Vulkan buffer.
+    ///
+    /// This class manages the lifetime of a Vulkan buffer and keeps its memory mapped.
+    ///
+    class Buffer {
+    public:
+        Buffer() noexcept = default;
+
+        ///
+        /// Create the buffer in host-visible, host-coherent memory and map it.
+        ///
+        /// @param vk Vulkan device functions, must outlive the object
+        /// @param device Vulkan device
+        /// @param physicalDevice Vulkan physical device
+        /// @param size Size of the buffer in bytes
+        /// @param usage Usage flags for the buffer
+        ///
+        /// @throws LSFG::vulkan_error if object creation fails.
+        ///
+        Buffer(const Hooks::DeviceDispatch& vk, VkDevice device, VkPhysicalDevice physicalDevice,
+            uint64_t size, VkBufferUsageFlags usage);
+
+        /// Get the Vulkan handle.
+        [[nodiscard]] auto handle() const { return *this->buffer; }
+        /// Get the Vulkan device memory handle.
+        [[nodiscard]] auto getMemory() const { return *this->memory; }
+        /// Get the mapped memory of the buffer.
+        [[nodiscard]] void* getData() const { return this->data; }
+        /// Get the size of the buffer in bytes.
+        [[nodiscard]] uint64_t getSize() const { return this->size; }
+
+        /// Trivially copyable, moveable and destructible
+        Buffer(const Buffer&) noexcept = default;
+        Buffer& operator=(const Buffer&) noexcept = default;
+        Buffer(Buffer&&) noexcept = default;
+        Buffer& operator=(Buffer&&) noexcept = default;
+        ~Buffer() = default;
+    private:
+        std::shared_ptr<VkBuffer> buffer;
+        std::shared_ptr<VkDeviceMemory> memory;
+
+        void* data{};
+        uint64_t size{};
+    };
+
+}
+
+#endif // BUFFER_HPP
@@ -1,11 +1,14 @@
 #ifndef COMMANDBUFFER_HPP
 #define COMMANDBUFFER_HPP
 
+#include "dispatch.hpp"
 #include "mini/commandpool.hpp"
+#include "mini/fence.hpp"
 #include "mini/semaphore.hpp"
 
 #include <vulkan/vulkan_core.h>
 
+#include <cstdint>
 #include <vector>
 #include <memory>
 
@@ -37,20 +40,26 @@ namespace Mini {
         ///
         /// Create the command buffer.
         ///
+        /// @param vk Vulkan device functions, must outlive the object
         /// @param device Vulkan device
         /// @param pool Vulkan command pool
         ///
         /// @throws LSFG::vulkan_error if object creation fails.
         ///
-        CommandBuffer(VkDevice device, const CommandPool& pool);
+        CommandBuffer(const Hooks::DeviceDispatch& vk, VkDevice device, const CommandPool& pool);
 
         ///
         /// Begin recording commands in the command buffer.
         ///
+        /// Command buffers recorded without VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+        /// stay in Full state after submission and may be submitted again.
+        ///
+        /// @param flags Usage flags for the recording
+        ///
         /// @throws std::logic_error if the command buffer is in Empty state
         /// @throws LSFG::vulkan_error if beginning the command buffer fails.
         ///
-        void begin();
+        void begin(VkCommandBufferUsageFlags flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
 
         ///
         /// End recording commands in the command buffer.
@@ -66,13 +75,35 @@ namespace Mini {
         /// @param queue Vulkan queue to submit to
         /// @param waitSemaphores Semaphores to wait on before executing the command buffer
         /// @param signalSemaphores Semaphores to signal after executing the command buffer
+        /// @param fence Optional fence to signal after executing the command buffer
         ///
         /// @throws std::logic_error if the command buffer is not in Full state.
         /// @throws LSFG::vulkan_error if submission fails.
         ///
         void submit(VkQueue queue,
             const std::vector<VkSemaphore>& waitSemaphores = {},
-            const std::vector<VkSemaphore>& signalSemaphores = {});
+            const std::vector<VkSemaphore>& signalSemaphores = {},
+            const Fence* fence = nullptr);
+
+        ///
+        /// Submit the command buffer to a queue, waiting on and signaling timeline semaphores.
+        ///
+        /// @param queue Vulkan queue to submit to
+        /// @param waitSemaphores Semaphores to wait on before executing the command buffer
+        /// @param waitValues Values to wait for, one per wait semaphore (ignored for binary semaphores)
+        /// @param signalSemaphores Semaphores to signal after executing the command buffer
+        /// @param signalValues Values to signal, one per signal semaphore (ignored for binary semaphores)
+        /// @param fence Optional fence to signal after executing the command buffer
+        ///
+        /// @throws std::logic_error if the command buffer is not in Full state.
+        /// @throws LSFG::vulkan_error if submission fails.
+        ///
+        void submit(VkQueue queue,
+            const std::vector<VkSemaphore>& waitSemaphores,
+            const std::vector<uint64_t>& waitValues,
+            const std::vector<VkSemaphore>& signalSemaphores,
+            const std::vector<uint64_t>& signalValues,
+            const Fence* fence = nullptr);
 
         /// Get the state of the command buffer.
         [[nodiscard]] CommandBufferState getState() const { return *this->state; }
@@ -86,8 +117,12 @@ namespace Mini {
         CommandBuffer& operator=(CommandBuffer&&) noexcept = default;
         ~CommandBuffer() = default;
     private:
+        friend class SubmitBatch;
+
         std::shared_ptr<CommandBufferState> state;
+        std::shared_ptr<VkCommandBufferUsageFlags> usage;
         std::shared_ptr<VkCommandBuffer> commandBuffer;
+        const Hooks::DeviceDispatch* vk{};
     };
 
 }
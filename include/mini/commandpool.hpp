@@ -1,6 +1,8 @@
 #ifndef COMMANDPOOL_HPP
 #define COMMANDPOOL_HPP
 
+#include "dispatch.hpp"
+
 #include <vulkan/vulkan_core.h>
 
 #include <memory>
@@ -19,12 +21,13 @@ namespace Mini {
         ///
         /// Create the command pool.
         ///
+        /// @param vk Vulkan device functions, must outlive the object
         /// @param device Vulkan device
         /// @param graphicsFamilyIdx Index of the graphics queue family
         ///
         /// @throws LSFG::vulkan_error if object creation fails.
         ///
-        CommandPool(VkDevice device, uint32_t graphicsFamilyIdx);
+        CommandPool(const Hooks::DeviceDispatch& vk, VkDevice device, uint32_t graphicsFamilyIdx);
 
         /// Get the Vulkan handle.
         [[nodiscard]] auto handle() const { return *this->commandPool; }
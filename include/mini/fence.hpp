@@ -0,0 +1,67 @@
+#ifndef FENCE_HPP
+#define FENCE_HPP
+
+#include "dispatch.hpp"
+
+#include <vulkan/vulkan_core.h>
+
+#include <cstdint>
+#include <memory>
+
+namespace Mini {
+
+    ///
+    /// C++ wrapper class for a Vulkan fence.
+    ///
+    /// This class manages the lifetime of a Vulkan fence.
+    ///
+    class Fence {
+    public:
+        Fence() noexcept = default;
+
+        ///
+        /// Create the fence.
+        ///
+        /// @param vk Vulkan device functions, must outlive the object
+        /// @param device Vulkan device
+        /// @param signaled Whether the fence is created in the signaled state
+        ///
+        /// @throws LSFG::vulkan_error if object creation fails.
+        ///
+        Fence(const Hooks::DeviceDispatch& vk, VkDevice device, bool signaled = false);
+
+        ///
+        /// Reset the fence to the unsignaled state.
+        ///
+        /// @throws LSFG::vulkan_error if resetting fails.
+        ///
+        void reset() const;
+
+        ///
+        /// Wait for the fence to be signaled.
+        ///
+        /// @param timeout Timeout in nanoseconds
+        /// @return true if the fence was signaled, false if the timeout expired.
+        ///
+        /// @throws LSFG::vulkan_error if waiting fails.
+        ///
+        [[nodiscard]] bool wait(uint64_t timeout = UINT64_MAX) const;
+
+        /// Get the Vulkan handle.
+        [[nodiscard]] auto handle() const { return *this->fence; }
+
+        // Trivially copyable, moveable and destructible
+        Fence(const Fence&) noexcept = default;
+        Fence& operator=(const Fence&) noexcept = default;
+        Fence(Fence&&) noexcept = default;
+        Fence& operator=(Fence&&) noexcept = default;
+        ~Fence() = default;
+    private:
+        std::shared_ptr<VkFence> fence;
+        const Hooks::DeviceDispatch* vk{};
+        VkDevice device{};
+    };
+
+}
+
+#endif // FENCE_HPP
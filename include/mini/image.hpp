@@ -1,6 +1,8 @@
 #ifndef IMAGE_HPP
 #define IMAGE_HPP
 
+#include "dispatch.hpp"
+
 #include <vulkan/vulkan_core.h>
 
 #include <memory>
@@ -19,6 +21,7 @@ namespace Mini {
         ///
         /// Create the image and export the backing fd
         ///
+        /// @param vk Vulkan device functions, must outlive the object
         /// @param device Vulkan device
         /// @param physicalDevice Vulkan physical device
         /// @param extent Extent of the image in pixels.
@@ -29,9 +32,25 @@ namespace Mini {
         ///
         /// @throws LSFG::vulkan_error if object creation fails.
         ///
-        Image(VkDevice device, VkPhysicalDevice physicalDevice, VkExtent2D extent, VkFormat format,
+        Image(const Hooks::DeviceDispatch& vk, VkDevice device, VkPhysicalDevice physicalDevice,
+            VkExtent2D extent, VkFormat format,
             VkImageUsageFlags usage, VkImageAspectFlags aspectFlags, int* fd);
 
+        ///
+        /// Create an exportable image without memory, to be bound by an ImageArena.
+        ///
+        /// @param vk Vulkan device functions, must outlive the object
+        /// @param device Vulkan device
+        /// @param extent Extent of the image in pixels.
+        /// @param format Vulkan format of the image
+        /// @param usage Usage flags for the image
+        /// @param aspectFlags Aspect flags for the image view
+        ///
+        /// @throws LSFG::vulkan_error if object creation fails.
+        ///
+        Image(const Hooks::DeviceDispatch& vk, VkDevice device, VkExtent2D extent, VkFormat format,
+            VkImageUsageFlags usage, VkImageAspectFlags aspectFlags);
+
         /// Get the Vulkan handle.
         [[nodiscard]] auto handle() const { return *this->image; }
         /// Get the Vulkan device memory handle.
@@ -51,7 +70,9 @@ namespace Mini {
         ~Image() = default;
     private:
         std::shared_ptr<VkImage> image;
-        std::shared_ptr<VkDeviceMemory> memory;
+        std::shared_ptr<VkDeviceMemory> memory; // possibly shared with other images of an arena
+
+        friend class ImageArena;
 
         VkExtent2D extent{};
         VkFormat format{};
@@ -0,0 +1,122 @@
+#ifndef IMAGEARENA_HPP
+#define IMAGEARENA_HPP
+
+#include "dispatch.hpp"
+#include "mini/image.hpp"
+
+#include <vulkan/vulkan_core.h>
+
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace Mini {
+
+    ///
+    /// C++ wrapper class for a Vulkan device memory block shared by several images.
+    ///
+    /// Images are created through the arena first and bound at their offsets once the
+    /// block is allocated, so the whole block is exported as a single file descriptor.
+    /// The block stays alive as long as any of its images does.
+    ///
+    /// Images the driver only shares through memory of their own are given a dedicated
+    /// block instead, at offset 0, exported as a file descriptor of its own.
+    ///
+    class ImageArena {
+    public:
+        ImageArena() noexcept = default;
+
+        ///
+        /// Create an empty arena.
+        ///
+        /// @param vk Vulkan device functions, must outlive the object
+        /// @param device Vulkan device
+        /// @param physicalDevice Vulkan physical device
+        ///
+        ImageArena(const Hooks::DeviceDispatch& vk, VkDevice device, VkPhysicalDevice physicalDevice);
+
+        ///
+        /// Create an image in the arena. It is bound once the arena is allocated.
+        ///
+        /// @param extent Extent of the image in pixels.
+        /// @param format Vulkan format of the image
+        /// @param usage Usage flags for the image
+        /// @param aspectFlags Aspect flags for the image view
+        /// @param offset Pointer to an integer where the image's offset in the block will be stored.
+        /// @return The unbound image.
+        ///
+        /// @throws LSFG::vulkan_error if object creation fails or the image can't be shared.
+        /// @throws std::logic_error if the arena has already been allocated.
+        ///
+        Image createImage(VkExtent2D extent, VkFormat format,
+            VkImageUsageFlags usage, VkImageAspectFlags aspectFlags, uint64_t* offset);
+
+        ///
+        /// Allocate the memory block, bind every image to it and export the backing fds.
+        ///
+        /// @param fd Pointer to an integer where the file descriptor will be stored, -1 if every image is dedicated.
+        /// @param dedicatedFds Vector the file descriptors of the dedicated blocks will be stored in, in creation order.
+        ///
+        /// @throws LSFG::vulkan_error if allocation, binding or export fails.
+        /// @throws std::logic_error if the arena has already been allocated.
+        ///
+        void allocate(int* fd, std::vector<int>* dedicatedFds);
+
+        ///
+        /// Import a memory block exported by another arena and bind every image to it.
+        ///
+        /// The images must be created in the same order and with the same parameters as
+        /// in the exporting arena, so they end up at the same offsets.
+        ///
+        /// @param fd File descriptor of the memory block, ownership is transferred. Ignored if every image is dedicated.
+        /// @param size Size of the memory block.
+        /// @param dedicatedFds File descriptors of the dedicated blocks in creation order, ownership is transferred.
+        ///
+        /// @throws LSFG::vulkan_error if import or binding fails, or the dedicated blocks don't match.
+        /// @throws std::logic_error if the arena has already been allocated.
+        ///
+        void import(int fd, uint64_t size, const std::vector<int>& dedicatedFds);
+
+        /// Get the Vulkan device memory handle of the shared block, or VK_NULL_HANDLE before allocation.
+        [[nodiscard]] VkDeviceMemory getMemory() const { return this->memory ? *this->memory : VK_NULL_HANDLE; }
+        /// Get the size of the memory block.
+        [[nodiscard]] uint64_t getSize() const { return this->size; }
+
+        /// Trivially copyable, moveable and destructible
+        ImageArena(const ImageArena&) noexcept = default;
+        ImageArena& operator=(const ImageArena&) noexcept = default;
+        ImageArena(ImageArena&&) noexcept = default;
+        ImageArena& operator=(ImageArena&&) noexcept = default;
+        ~ImageArena() = default;
+    private:
+        /// Image needing a memory block of its own.
+        struct Dedicated {
+            VkImage image;
+            uint64_t size;
+            uint32_t memoryTypeBits;
+            std::shared_ptr<VkDeviceMemory> memory; // shared with the image, set on allocation
+        };
+
+        [[nodiscard]] uint32_t findMemoryType(uint32_t memoryTypeBits) const;
+        [[nodiscard]] bool requiresDedicated(VkImage image, VkFormat format, VkImageUsageFlags usage,
+            VkMemoryRequirements* memReqs) const;
+        void bindImages();
+        void allocateDedicated(Dedicated& dedicated, int fd);
+        [[nodiscard]] int exportMemory(VkDeviceMemory memory) const;
+
+        std::shared_ptr<VkDeviceMemory> memory; // shared with every image, set on allocation
+        std::vector<Dedicated> dedicated; // images with memory of their own, in creation order
+
+        const Hooks::DeviceDispatch* vk{};
+        VkDevice device{};
+        VkPhysicalDevice physicalDevice{};
+        std::vector<std::pair<VkImage, uint64_t>> bindings; // images to bind and their offsets
+        uint32_t memoryTypeBits{~0U}; // memory types supported by every image
+        uint64_t size{0};
+        bool allocated{false};
+    };
+
+}
+
+#endif // IMAGEARENA_HPP
@@ -1,8 +1,11 @@
 #ifndef SEMAPHORE_HPP
 #define SEMAPHORE_HPP
 
+#include "dispatch.hpp"
+
 #include <vulkan/vulkan_core.h>
 
+#include <cstdint>
 #include <memory>
 
 namespace Mini {
@@ -19,21 +22,76 @@ namespace Mini {
         ///
         /// Create the semaphore.
         ///
+        /// @param vk Vulkan device functions, must outlive the object
+        /// @param device Vulkan device
+        ///
+        /// @throws LSFG::vulkan_error if object creation fails.
+        ///
+        Semaphore(const Hooks::DeviceDispatch& vk, VkDevice device);
+
+        ///
+        /// Create an exportable semaphore.
+        ///
+        /// @param vk Vulkan device functions, must outlive the object
         /// @param device Vulkan device
+        /// @param fd Pointer to an integer where the file descriptor will be stored,
+        ///           or nullptr to only export it later via `exportFd`.
         ///
         /// @throws LSFG::vulkan_error if object creation fails.
         ///
-        Semaphore(VkDevice device);
+        Semaphore(const Hooks::DeviceDispatch& vk, VkDevice device, int* fd);
 
         ///
-        /// Import a semaphore.
+        /// Create an exportable timeline semaphore.
         ///
+        /// @param vk Vulkan device functions, must outlive the object
         /// @param device Vulkan device
-        /// @param fd File descriptor to import the semaphore from.
+        /// @param initialValue Initial counter value of the semaphore
+        /// @param fd Pointer to an integer where the file descriptor will be stored,
+        ///           or nullptr to only export it later via `exportFd`.
         ///
         /// @throws LSFG::vulkan_error if object creation fails.
         ///
-        Semaphore(VkDevice device, int* fd);
+        Semaphore(const Hooks::DeviceDispatch& vk, VkDevice device, uint64_t initialValue, int* fd);
+
+        ///
+        /// Export a new file descriptor referencing the semaphore.
+        ///
+        /// @return The file descriptor. Ownership is passed to the caller.
+        ///
+        /// @throws LSFG::vulkan_error if the export fails.
+        ///
+        [[nodiscard]] int exportFd() const;
+
+        ///
+        /// Import a file descriptor into the semaphore.
+        ///
+        /// @param fd File descriptor of the semaphore payload. Ownership is transferred.
+        /// @param temporary Whether the import only lasts until the next wait on the semaphore
+        ///
+        /// @throws LSFG::vulkan_error if the import fails.
+        ///
+        void importFd(int fd, bool temporary) const;
+
+        ///
+        /// Wait on the host for a timeline semaphore to reach a value.
+        ///
+        /// @param value Value to wait for
+        /// @param timeout Timeout in nanoseconds
+        /// @return true if the value was reached, false on timeout
+        ///
+        /// @throws LSFG::vulkan_error if waiting fails.
+        ///
+        [[nodiscard]] bool wait(uint64_t value, uint64_t timeout = UINT64_MAX) const;
+
+        ///
+        /// Signal a timeline semaphore from the host.
+        ///
+        /// @param value Value to set the semaphore to
+        ///
+        /// @throws LSFG::vulkan_error if signaling fails.
+        ///
+        void signal(uint64_t value) const;
 
         /// Get the Vulkan handle.
         [[nodiscard]] auto handle() const { return *this->semaphore; }
@@ -46,6 +104,8 @@ namespace Mini {
         ~Semaphore() = default;
     private:
         std::shared_ptr<VkSemaphore> semaphore;
+        const Hooks::DeviceDispatch* vk{};
+        VkDevice device{};
     };
 
 }
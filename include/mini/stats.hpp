@@ -0,0 +1,47 @@
+#ifndef STATS_HPP
+#define STATS_HPP
+
+#include <cstdint>
+
+//
+// Counters for the Vulkan objects created by the Mini wrappers. These are used to
+// verify that the present path doesn't create any objects once it has warmed up.
+//
+// Creations are counted per thread, so presents of other contexts happening at the
+// same time aren't counted against each other.
+//
+
+namespace Mini::Stats {
+
+    /// Record the creation of a Vulkan object.
+    void recordCreation();
+
+    ///
+    /// Counter of the Vulkan objects created on the calling thread while it is alive.
+    ///
+    /// Counters must be destroyed on the thread they were created on, in reverse order.
+    /// Creations counted by a nested counter are counted by the outer one as well.
+    ///
+    class Counter {
+    public:
+        Counter() noexcept;
+
+        /// Get the amount of Vulkan objects created so far.
+        [[nodiscard]] uint64_t getCount() const { return this->count; }
+
+        /// Non-copyable, non-moveable, counters are tied to their thread
+        Counter(const Counter&) = delete;
+        Counter& operator=(const Counter&) = delete;
+        Counter(Counter&&) = delete;
+        Counter& operator=(Counter&&) = delete;
+        ~Counter();
+    private:
+        Counter* outer; // counter active on the thread before this one, if any
+        uint64_t count{0};
+
+        friend void recordCreation();
+    };
+
+}
+
+#endif // STATS_HPP
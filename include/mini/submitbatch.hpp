@@ -0,0 +1,106 @@
+#ifndef SUBMITBATCH_HPP
+#define SUBMITBATCH_HPP
+
+#include "dispatch.hpp"
+#include "mini/commandbuffer.hpp"
+#include "mini/fence.hpp"
+
+#include <vulkan/vulkan_core.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace Mini {
+
+    ///
+    /// Collects command buffer submissions and submits them in a single vkQueueSubmit.
+    ///
+    /// Batches are submitted in the order they were added. Storage is kept between
+    /// flushes, so a batch reused every frame doesn't allocate once it has warmed up.
+    ///
+    class SubmitBatch {
+    public:
+        SubmitBatch() noexcept = default;
+
+        ///
+        /// Create an empty batch.
+        ///
+        /// @param vk Vulkan device functions, must outlive the batch
+        ///
+        explicit SubmitBatch(const Hooks::DeviceDispatch& vk) : vk(&vk) {}
+
+        ///
+        /// Add a command buffer submission to the batch.
+        ///
+        /// @param buf Command buffer to submit
+        /// @param waitSemaphores Semaphores to wait on before executing the command buffer
+        /// @param waitValues Values to wait for, one per wait semaphore (ignored for binary semaphores)
+        /// @param signalSemaphores Semaphores to signal after executing the command buffer
+        /// @param signalValues Values to signal, one per signal semaphore (ignored for binary semaphores)
+        ///
+        /// @throws std::logic_error if the command buffer is not in Full state.
+        ///
+        void add(const CommandBuffer& buf,
+            const std::vector<VkSemaphore>& waitSemaphores = {},
+            const std::vector<uint64_t>& waitValues = {},
+            const std::vector<VkSemaphore>& signalSemaphores = {},
+            const std::vector<uint64_t>& signalValues = {});
+
+        ///
+        /// Add a submission without a command buffer to the batch, which only
+        /// signals semaphores once the semaphores it waits on have been signaled.
+        ///
+        /// @param waitSemaphores Semaphores to wait on before signaling
+        /// @param waitValues Values to wait for, one per wait semaphore (ignored for binary semaphores)
+        /// @param signalSemaphores Semaphores to signal
+        /// @param signalValues Values to signal, one per signal semaphore (ignored for binary semaphores)
+        ///
+        void addSignal(const std::vector<VkSemaphore>& waitSemaphores,
+            const std::vector<uint64_t>& waitValues,
+            const std::vector<VkSemaphore>& signalSemaphores,
+            const std::vector<uint64_t>& signalValues = {});
+
+        ///
+        /// Submit all added command buffers in a single call and empty the batch.
+        /// Nothing is submitted if the batch is empty and no fence is given.
+        ///
+        /// @param queue Vulkan queue to submit to
+        /// @param fence Optional fence to signal after executing all command buffers
+        ///
+        /// @throws LSFG::vulkan_error if submission fails.
+        ///
+        void flush(VkQueue queue, const Fence* fence = nullptr);
+
+        /// Get the amount of vkQueueSubmit calls made since the counter was last reset.
+        [[nodiscard]] uint32_t getSubmitCount() const { return this->submitCount; }
+        /// Reset the submit counter.
+        void resetSubmitCount() { this->submitCount = 0; }
+
+        // Non-copyable, trivially moveable and destructible
+        SubmitBatch(const SubmitBatch&) = delete;
+        SubmitBatch& operator=(const SubmitBatch&) = delete;
+        SubmitBatch(SubmitBatch&&) noexcept = default;
+        SubmitBatch& operator=(SubmitBatch&&) noexcept = default;
+        ~SubmitBatch() = default;
+    private:
+        struct Entry {
+            CommandBuffer buf; // empty for submissions that only signal
+            std::vector<VkSemaphore> waitSemaphores;
+            std::vector<uint64_t> waitValues;
+            std::vector<VkPipelineStageFlags> waitStages;
+            std::vector<VkSemaphore> signalSemaphores;
+            std::vector<uint64_t> signalValues;
+        };
+        std::vector<Entry> entries; // only the first entryCount are part of the batch
+        size_t entryCount{0};
+
+        std::vector<VkTimelineSemaphoreSubmitInfo> timelineInfos;
+        std::vector<VkSubmitInfo> submitInfos;
+
+        const Hooks::DeviceDispatch* vk{};
+        uint32_t submitCount{0};
+    };
+
+}
+
+#endif // SUBMITBATCH_HPP
@@ -0,0 +1,73 @@
+#ifndef MULTIPLIER_HPP
+#define MULTIPLIER_HPP
+
+#include <cstdint>
+
+///
+/// Picks the amount of frames to generate per real frame, so the output matches the display.
+///
+/// The real frame time is averaged over the last presents, and as many frames are generated
+/// as fit into it at the refresh rate, never more. A new amount only applies once it has been
+/// picked for several presents in a row, so jitter doesn't switch back and forth.
+///
+/// Generating is over budget once it keeps AFMF busy for most of a real frame, or once
+/// presents find every frame still in flight. Generation then stops for a while before
+/// retrying, the pause doubling every time it's over budget again soon after.
+///
+class MultiplierController {
+public:
+    MultiplierController() noexcept = default;
+
+    ///
+    /// Create a controller.
+    ///
+    /// @param maxOutputs Most frames to generate per real frame, resources are allocated for these.
+    /// @param refreshPeriod Time between two display refreshes in nanoseconds, or 0 if unknown
+    ///                      to generate the most frames that fit the budget.
+    ///
+    MultiplierController(uint64_t maxOutputs, uint64_t refreshPeriod);
+
+    ///
+    /// Record the present of a real frame and pick the amount of frames to generate for it.
+    ///
+    /// @param now Time of the present in nanoseconds, on any monotonic clock.
+    /// @param generationTime Time AFMF spent generating frames since the last present, in nanoseconds.
+    /// @param backpressure Whether the present found every frame still in flight.
+    /// @return The amount of frames to generate, at most the maximum.
+    ///
+    uint64_t update(uint64_t now, uint64_t generationTime, bool backpressure);
+
+    /// Get the amount of frames generated per real frame.
+    [[nodiscard]] uint64_t getOutputs() const { return this->outputs; }
+    /// Get the averaged time between real frames in nanoseconds, 0 until measured.
+    [[nodiscard]] uint64_t getFrameTime() const { return this->frameTime; }
+    /// Get the averaged time spent generating per real frame, in nanoseconds.
+    [[nodiscard]] uint64_t getGenerationTime() const { return this->generationTime; }
+    /// Get the amount of times generation was paused for being over budget.
+    [[nodiscard]] uint64_t getBackoffCount() const { return this->backoffCount; }
+
+    // Trivially copyable, moveable and destructible
+    MultiplierController(const MultiplierController&) = default;
+    MultiplierController& operator=(const MultiplierController&) = default;
+    MultiplierController(MultiplierController&&) noexcept = default;
+    MultiplierController& operator=(MultiplierController&&) noexcept = default;
+    ~MultiplierController() = default;
+private:
+    uint64_t maxOutputs{1};
+    uint64_t refreshPeriod{0};
+    uint64_t outputs{1};
+
+    uint64_t lastPresent{0}; // time of the previous present, 0 before the first
+    uint64_t frameTime{0}; // averaged time between real frames
+    uint64_t generationTime{0}; // averaged time spent generating per real frame
+
+    uint64_t candidate{0}; // amount of frames that would match the display
+    uint64_t candidateFrames{0}; // presents the candidate has been picked in a row
+
+    uint64_t backoff{0}; // presents left until generation is retried
+    uint64_t backoffLength{0}; // presents the next pause lasts
+    uint64_t stableFrames{0}; // presents generated within budget since the last pause
+    uint64_t backoffCount{0};
+};
+
+#endif // MULTIPLIER_HPP
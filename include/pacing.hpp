@@ -0,0 +1,103 @@
+#ifndef PACING_HPP
+#define PACING_HPP
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/// Way present times are enforced.
+enum class PacingMethod : uint8_t {
+    None, // present as soon as possible, leaving pacing to the present mode
+    DisplayTiming, // pass the present times to the driver through VK_GOOGLE_display_timing
+    PresentWait // sleep until each present time, measuring presents through VK_KHR_present_wait
+};
+
+///
+/// Spreads the frames of every present evenly across the predicted real frame time.
+///
+/// The generated frames and the real one continue the cadence of the previous present,
+/// each a real frame time divided by the amount of frames apart. With a known refresh
+/// period, that spacing is rounded to whole refreshes, so every frame stays on screen
+/// equally long. Presents never start in the past, nor more than one spacing ahead.
+///
+/// The clock and sleep are injectable, so pacing can run without a display.
+///
+class FramePacer {
+public:
+    using ClockFn = std::function<uint64_t()>; // current time in nanoseconds
+    using SleepFn = std::function<void(uint64_t until)>; // block until a time of the clock
+
+    FramePacer() noexcept = default;
+
+    ///
+    /// Create a frame pacer on CLOCK_MONOTONIC, which present timing extensions report in.
+    ///
+    /// @param refreshPeriod Time between two display refreshes in nanoseconds, or 0 if unknown.
+    ///
+    explicit FramePacer(uint64_t refreshPeriod);
+
+    ///
+    /// Create a frame pacer on a custom clock.
+    ///
+    /// @param refreshPeriod Time between two display refreshes in nanoseconds, or 0 if unknown.
+    /// @param clock Function returning the current time.
+    /// @param sleep Function blocking until a time.
+    ///
+    FramePacer(uint64_t refreshPeriod, ClockFn clock, SleepFn sleep);
+
+    ///
+    /// Schedule the frames of a present.
+    ///
+    /// @param count Amount of generated frames.
+    /// @param frameTime Predicted time between real frames in nanoseconds, or 0 if unknown.
+    /// @return The present time of every generated frame, followed by the real one's.
+    ///         Valid until the next call.
+    ///
+    const std::vector<uint64_t>& schedule(uint64_t count, uint64_t frameTime);
+
+    ///
+    /// Block until a present time, returning right away if it has passed.
+    ///
+    /// @param time Present time to wait for.
+    ///
+    void wait(uint64_t time) const;
+
+    ///
+    /// Record when a scheduled frame was actually presented.
+    ///
+    /// @param target Time the frame was scheduled for.
+    /// @param actual Time it was presented at.
+    ///
+    void presented(uint64_t target, uint64_t actual);
+
+    /// Get the current time of the pacer's clock.
+    [[nodiscard]] uint64_t now() const { return this->clock(); }
+    /// Get the time between two display refreshes, 0 if unknown.
+    [[nodiscard]] uint64_t getRefreshPeriod() const { return this->refreshPeriod; }
+    /// Get the amount of frames reported presented so far.
+    [[nodiscard]] uint64_t getPresentCount() const { return this->presentCount; }
+    /// Get the amount of frames presented more than half a refresh after their time.
+    [[nodiscard]] uint64_t getLateCount() const { return this->lateCount; }
+    /// Get the averaged distance between scheduled and actual present times, in nanoseconds.
+    [[nodiscard]] uint64_t getError() const { return this->error; }
+
+    // Trivially copyable, moveable and destructible
+    FramePacer(const FramePacer&) = default;
+    FramePacer& operator=(const FramePacer&) = default;
+    FramePacer(FramePacer&&) noexcept = default;
+    FramePacer& operator=(FramePacer&&) noexcept = default;
+    ~FramePacer() = default;
+private:
+    uint64_t refreshPeriod{0};
+    ClockFn clock;
+    SleepFn sleep;
+
+    std::vector<uint64_t> times; // present times of the last schedule
+    uint64_t last{0}; // present time of the last real frame, 0 before the first
+
+    uint64_t presentCount{0};
+    uint64_t lateCount{0};
+    uint64_t error{0};
+};
+
+#endif // PACING_HPP
@@ -0,0 +1,76 @@
+#ifndef PRESENTER_HPP
+#define PRESENTER_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+
+///
+/// Runs the presents of frames on a thread of its own, so the thread handing
+/// them over returns as soon as a frame is queued.
+///
+/// Frames are handed over through a single-producer single-consumer ring without locks.
+/// The producer only advances the head and the present thread only the tail, either side
+/// sleeping on the other's counter through atomic waits when the ring is full or empty.
+/// Jobs must only be pushed from the producing thread. The other functions may be called
+/// from any thread, called from another one they may miss jobs pushed meanwhile.
+///
+class Presenter {
+public:
+    using PresentFn = std::function<void(uint64_t job)>; // must not throw
+
+    ///
+    /// Create a presenter and start its thread.
+    ///
+    /// @param capacity Most jobs queued or running at once.
+    /// @param present Function called on the present thread for every job, in order.
+    ///
+    Presenter(size_t capacity, PresentFn present);
+
+    ///
+    /// Queue a job, blocking while the ring is full.
+    ///
+    /// @param job Value passed to the present function.
+    ///
+    void push(uint64_t job);
+
+    ///
+    /// Block until at most a number of jobs are queued or running.
+    ///
+    /// @param outstanding Amount of jobs left to wait for, 0 to wait until the thread is idle.
+    ///
+    void wait(size_t outstanding) const;
+
+    /// Get the amount of jobs queued or running.
+    [[nodiscard]] size_t getOutstanding() const {
+        // the tail never passes the head, so the head read after it is at least as far
+        const uint32_t done = this->tail.load(std::memory_order_acquire);
+        return this->head.load(std::memory_order_acquire) - done;
+    }
+    /// Get the most jobs queued or running at once.
+    [[nodiscard]] size_t getCapacity() const { return this->jobs.size(); }
+    /// Get the amount of jobs pushed so far, wrapping around.
+    [[nodiscard]] uint32_t getPushCount() const { return this->head.load(std::memory_order_acquire); }
+
+    // Non-copyable and non-moveable, the thread refers to the presenter
+    Presenter(const Presenter&) = delete;
+    Presenter& operator=(const Presenter&) = delete;
+    Presenter(Presenter&&) = delete;
+    Presenter& operator=(Presenter&&) = delete;
+    ~Presenter();
+private:
+    void work();
+
+    std::vector<uint64_t> jobs; // ring of queued jobs, indexed by counter modulo capacity
+    std::atomic<uint32_t> head{0}; // jobs pushed, only written by the producer
+    std::atomic<uint32_t> tail{0}; // jobs done, only written by the present thread
+    std::atomic<bool> stopping{false};
+
+    PresentFn present;
+    std::thread thread;
+};
+
+#endif // PRESENTER_HPP
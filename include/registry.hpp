@@ -0,0 +1,158 @@
+#ifndef REGISTRY_HPP
+#define REGISTRY_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+///
+/// Map from Vulkan handles to the state AFMF keeps for them, readable from any thread without locks.
+///
+/// Lookups read an immutable snapshot of the map, announced through reader counts striped
+/// across cache lines, so threads looking up at once don't contend. Inserting and erasing
+/// lock, publish a modified copy of the snapshot and retire the old one.
+///
+/// Retired snapshots are reclaimed by epoch: lookups are counted under the parity of the
+/// epoch they started in, and every change advances the epoch once the lookups of the
+/// other parity have finished. A snapshot retired in epoch e is freed once the epoch
+/// reaches e + 2, so lookups on the current snapshot never hold up reclaiming old ones.
+///
+/// Values are owned by the registry and never move. A value found by a lookup stays
+/// valid until its key is erased, which Vulkan's external synchronization rules keep
+/// from happening while the handle is in use. A value replaced by inserting its key
+/// again is retired with the snapshot referring to it.
+///
+template<typename Key, typename Value>
+class Registry {
+public:
+    Registry() : current(new Map()) {}
+
+    ///
+    /// Find the value of a key. Wait-free.
+    ///
+    /// @param key Handle to look up.
+    /// @return The value, or nullptr if the key isn't registered.
+    ///
+    [[nodiscard]] Value* find(const Key& key) const {
+        auto& count = this->readers.at(stripe()).counts.at(this->epoch.load() & 1);
+        count.fetch_add(1);
+        const Map* map = this->current.load();
+        const auto it = map->find(key);
+        Value* value = it == map->end() ? nullptr : it->second;
+        count.fetch_sub(1);
+        return value;
+    }
+
+    ///
+    /// Register a value, replacing the key's previous value if any.
+    ///
+    /// A replaced value is destroyed once no lookup can still be reading it.
+    ///
+    /// @param key Handle to register the value under.
+    /// @param value Value to take ownership of.
+    /// @return The registered value.
+    ///
+    Value& insert(const Key& key, std::unique_ptr<Value> value) {
+        std::vector<Retired> freed; // destroyed after unlocking
+        const std::lock_guard<std::mutex> lock(this->mutex);
+        Value& registered = *value;
+        auto map = std::make_unique<Map>(*this->current.load());
+        (*map)[key] = value.get();
+        auto previous = std::exchange(this->values[key], std::move(value));
+        this->publish(std::move(map), std::move(previous), freed);
+        return registered;
+    }
+
+    ///
+    /// Unregister a key and destroy its value.
+    ///
+    /// @param key Handle to unregister, ignored if it isn't registered.
+    ///
+    void erase(const Key& key) {
+        std::unique_ptr<Value> value; // destroyed after unlocking
+        std::vector<Retired> freed;
+        const std::lock_guard<std::mutex> lock(this->mutex);
+        auto it = this->values.find(key);
+        if (it == this->values.end())
+            return;
+        value = std::move(it->second);
+        this->values.erase(it);
+
+        auto map = std::make_unique<Map>(*this->current.load());
+        map->erase(key);
+        this->publish(std::move(map), nullptr, freed);
+    }
+
+    // Non-copyable and non-moveable, lookups may be reading the snapshot
+    Registry(const Registry&) = delete;
+    Registry& operator=(const Registry&) = delete;
+    Registry(Registry&&) = delete;
+    Registry& operator=(Registry&&) = delete;
+    ~Registry() { delete this->current.load(); }
+private:
+    using Map = std::unordered_map<Key, Value*>;
+
+    static constexpr size_t stripes = 16;
+    struct alignas(64) Readers {
+        std::array<std::atomic<size_t>, 2> counts{}; // lookups in progress on threads of this stripe, per epoch parity
+    };
+    struct Retired {
+        uint64_t epoch; // epoch the snapshot was replaced in
+        std::unique_ptr<const Map> map;
+        std::unique_ptr<Value> value; // value replaced along with the snapshot, if any
+    };
+
+    // stripe of the calling thread, dealt out round-robin
+    static size_t stripe() {
+        static std::atomic<size_t> next{0};
+        thread_local const size_t slot = next.fetch_add(1, std::memory_order_relaxed) % stripes;
+        return slot;
+    }
+
+    // check if no lookup counted under the parity of an epoch is in progress
+    bool drained(uint64_t epoch) const {
+        return std::ranges::all_of(this->readers,
+            [epoch](const Readers& entry) { return entry.counts.at(epoch & 1).load() == 0; });
+    }
+
+    // swap in a new snapshot, advance the epoch as far as lookups allow and move the
+    // retired snapshots no lookup can reach anymore into freed.
+    //
+    // lookups announce themselves before loading the snapshot, so a lookup that still
+    // reads a retired snapshot was counted before it was replaced, in its epoch or an
+    // earlier one. the epoch only advances to e + 1 once the parity of e - 1 drained, so
+    // by the time it reaches e + 2 every lookup of e or earlier has finished.
+    void publish(std::unique_ptr<Map> map, std::unique_ptr<Value> replaced, std::vector<Retired>& freed) {
+        this->retired.push_back({
+            .epoch = this->epoch.load(),
+            .map = std::unique_ptr<const Map>(this->current.exchange(map.release())),
+            .value = std::move(replaced)
+        });
+        for (size_t step = 0; step < 2 && this->drained(this->epoch.load() + 1); step++)
+            this->epoch.fetch_add(1);
+
+        const uint64_t epoch = this->epoch.load();
+        const auto unreachable = std::ranges::partition(this->retired,
+            [epoch](const Retired& entry) { return entry.epoch + 2 > epoch; });
+        std::ranges::move(unreachable, std::back_inserter(freed));
+        this->retired.erase(unreachable.begin(), unreachable.end());
+    }
+
+    mutable std::array<Readers, stripes> readers;
+    alignas(64) std::atomic<const Map*> current; // snapshot lookups read
+    std::atomic<uint64_t> epoch{0}; // advanced by changes, see publish
+
+    std::mutex mutex; // held while changing the registry
+    std::unordered_map<Key, std::unique_ptr<Value>> values; // owned values, guarded by the mutex
+    std::vector<Retired> retired; // snapshots lookups may still read, guarded by the mutex
+};
+
+#endif // REGISTRY_HPP
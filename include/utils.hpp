@@ -1,26 +1,58 @@
 #ifndef UTILS_HPP
 #define UTILS_HPP
 
+#include "dispatch.hpp"
+
 #include <vector>
 #include <vulkan/vulkan_core.h>
 
+#include <cstddef>
+#include <memory>
+#include <optional>
 #include <utility>
 
 namespace Utils {
 
     ///
-    /// Find a queue in the physical device that supports the given queue flags.
+    /// Find a queue family enabled in the device creation info that supports the given queue flags.
     ///
-    /// @param device The Vulkan device to use for queue retrieval.
-    /// @param physicalDevice The physical device to search in.
+    /// @param vk Functions of the physical device's instance.
+    /// @param physicalDevice The physical device the device is created on.
     /// @param desc The device creation info, used to determine enabled queue families.
     /// @param flags The queue flags to search for (e.g., VK_QUEUE_GRAPHICS_BIT).
-    /// @return Pair of queue family index and queue handle.
+    /// @return The queue family index, or std::nullopt if no enabled family supports the flags.
+    ///
+    std::optional<uint32_t> findEnabledQueueFamily(const Hooks::InstanceDispatch& vk,
+        VkPhysicalDevice physicalDevice, const VkDeviceCreateInfo* desc, VkQueueFlags flags);
+
     ///
-    /// @throws LSFG::vulkan_error if no suitable queue is found.
+    /// Find a queue family that supports the given queue flags, but none of the excluded ones.
     ///
-    std::pair<uint32_t, VkQueue> findQueue(VkDevice device, VkPhysicalDevice physicalDevice,
-        VkDeviceCreateInfo* desc, VkQueueFlags flags);
+    /// @param vk Functions of the physical device's instance.
+    /// @param physicalDevice The physical device to search in.
+    /// @param flags The queue flags to search for (e.g., VK_QUEUE_TRANSFER_BIT).
+    /// @param excludedFlags The queue flags the family must not support (e.g., VK_QUEUE_GRAPHICS_BIT).
+    /// @return The queue family index, or std::nullopt if there is no such family.
+    ///
+    std::optional<uint32_t> findQueueFamily(const Hooks::InstanceDispatch& vk,
+        VkPhysicalDevice physicalDevice, VkQueueFlags flags, VkQueueFlags excludedFlags);
+
+    ///
+    /// Request a queue on a queue family in the device creation info, without
+    /// sharing one of the application's queues if the family has any left.
+    ///
+    /// @param vk Functions of the physical device's instance.
+    /// @param desc The device creation info to modify.
+    /// @param physicalDevice The physical device the device is created on.
+    /// @param family The queue family to request a queue on.
+    /// @param queueInfos Storage for the queue creation infos, must outlive the device creation.
+    /// @param priorities Storage for the queue priorities, must outlive the device creation.
+    /// @return The index of the requested queue within the family, or std::nullopt if the
+    ///         application uses all of the family's queues. Its first queue is shared then.
+    ///
+    std::optional<uint32_t> requestQueue(const Hooks::InstanceDispatch& vk,
+        VkDeviceCreateInfo* desc, VkPhysicalDevice physicalDevice, uint32_t family,
+        std::vector<VkDeviceQueueCreateInfo>& queueInfos, std::vector<float>& priorities);
 
     ///
     /// Ensure a list of extensions is present in the given array.
@@ -31,9 +63,124 @@ namespace Utils {
     std::vector<const char*> addExtensions(const char* const* extensions, size_t count,
         const std::vector<const char*>& requiredExtensions);
 
+    ///
+    /// Check if a physical device supports timeline semaphores through VK_KHR_timeline_semaphore.
+    ///
+    /// @param vk Functions of the physical device's instance.
+    /// @param physicalDevice The physical device to check.
+    /// @return true if the extension and the timelineSemaphore feature are available.
+    ///
+    bool supportsTimelineSemaphores(const Hooks::InstanceDispatch& vk, VkPhysicalDevice physicalDevice);
+
+    /// Storage for structures chained into a creation info by the layer.
+    using StructureStorage = std::vector<std::unique_ptr<std::byte[]>>;
+
+    ///
+    /// Enable the timelineSemaphore feature in a device creation info.
+    ///
+    /// The application's pNext chain is left untouched. If it already contains a structure
+    /// with the feature, that structure and every one in front of it are copied and the
+    /// feature is enabled in the copy. Otherwise a new structure is prepended to the chain.
+    ///
+    /// @param desc The device creation info to modify, a copy of the application's.
+    /// @param storage Storage for the chained structures, must outlive the device creation.
+    /// @return false if a structure in front of the feature's can't be copied.
+    ///
+    bool enableTimelineSemaphores(VkDeviceCreateInfo* desc, StructureStorage& storage);
+
+    ///
+    /// Check if a physical device supports waiting for presents through VK_KHR_present_wait.
+    ///
+    /// @param vk Functions of the physical device's instance.
+    /// @param physicalDevice The physical device to check.
+    /// @return true if VK_KHR_present_id and VK_KHR_present_wait and their features are available.
+    ///
+    bool supportsPresentWait(const Hooks::InstanceDispatch& vk, VkPhysicalDevice physicalDevice);
+
+    ///
+    /// Enable the presentId and presentWait features in a device creation info.
+    ///
+    /// Features already requested through the pNext chain are enabled in copies,
+    /// otherwise new structures are prepended to the chain, see enableTimelineSemaphores.
+    ///
+    /// @param desc The device creation info to modify, a copy of the application's.
+    /// @param storage Storage for the chained structures, must outlive the device creation.
+    /// @return false if a structure in front of the features' can't be copied.
+    ///
+    bool enablePresentWait(VkDeviceCreateInfo* desc, StructureStorage& storage);
+
+    ///
+    /// Check if a physical device supports VK_GOOGLE_display_timing.
+    ///
+    /// @param vk Functions of the physical device's instance.
+    /// @param physicalDevice The physical device to check.
+    /// @return true if the extension is available.
+    ///
+    bool supportsDisplayTiming(const Hooks::InstanceDispatch& vk, VkPhysicalDevice physicalDevice);
+
+    ///
+    /// Check if a surface supports a present mode.
+    ///
+    /// @param vk Functions of the physical device's instance.
+    /// @param physicalDevice The physical device the swapchain is created on.
+    /// @param surface The surface the swapchain is created for.
+    /// @param mode The present mode to check.
+    /// @return true if the mode is supported.
+    ///
+    bool supportsPresentMode(const Hooks::InstanceDispatch& vk, VkPhysicalDevice physicalDevice,
+        VkSurfaceKHR surface, VkPresentModeKHR mode);
+
+    ///
+    /// Get the most images a swapchain on a surface may have.
+    ///
+    /// @param vk Functions of the physical device's instance.
+    /// @param physicalDevice The physical device the swapchain is created on.
+    /// @param surface The surface the swapchain is created for.
+    /// @return The maximum image count, or 0 if there's no limit or it can't be queried.
+    ///
+    uint32_t getMaxImageCount(const Hooks::InstanceDispatch& vk, VkPhysicalDevice physicalDevice,
+        VkSurfaceKHR surface);
+
+    ///
+    /// Check if a queue family can present to a surface.
+    ///
+    /// @param vk Functions of the physical device's instance.
+    /// @param physicalDevice The physical device the swapchain is created on.
+    /// @param family The queue family to check.
+    /// @param surface The surface the swapchain is created for.
+    /// @return true if queues of the family can present to the surface.
+    ///
+    bool supportsPresentQueue(const Hooks::InstanceDispatch& vk, VkPhysicalDevice physicalDevice,
+        uint32_t family, VkSurfaceKHR surface);
+
+    ///
+    /// Check if a pNext chain contains a structure.
+    ///
+    /// @param chain The first structure of the chain, or nullptr.
+    /// @param type The structure type to look for.
+    /// @return true if any structure in the chain has the type.
+    ///
+    bool hasStructure(const void* chain, VkStructureType type);
+
+    ///
+    /// Check if swapchain images can be used in place by AFMF instead of being copied.
+    ///
+    /// @param vk Functions of the physical device's instance.
+    /// @param physicalDevice The physical device the swapchain is created on.
+    /// @param surface The surface the swapchain is created for.
+    /// @param format The format of the swapchain images.
+    /// @param usage The image usage AFMF needs (e.g., VK_IMAGE_USAGE_SAMPLED_BIT).
+    /// @param features The format features AFMF needs (e.g., VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT).
+    /// @return true if the surface allows the usage and the format supports the features.
+    ///
+    bool supportsSwapchainUsage(const Hooks::InstanceDispatch& vk, VkPhysicalDevice physicalDevice,
+        VkSurfaceKHR surface, VkFormat format,
+        VkImageUsageFlags usage, VkFormatFeatureFlags features);
+
     ///
     /// Copy an image from source to destination in a command buffer.
     ///
+    /// @param vk Functions of the device.
     /// @param buf The command buffer to record the copy operation into.
     /// @param src The source image to copy from.
     /// @param dst The destination image to copy to.
@@ -43,12 +190,40 @@ namespace Utils {
     /// @param post The pipeline stage to provide after the copy.
     /// @param makeSrcPresentable If true, the source image will be made presentable after the copy.
     /// @param makeDstPresentable If true, the destination image will be made presentable after the copy.
+    /// @param queueFamily The queue family the command buffer is submitted on.
+    /// @param ownerFamily The queue family owning the presentable image outside the copy, or
+    ///                    VK_QUEUE_FAMILY_IGNORED if it's shared with queueFamily.
+    ///
+    /// Images not made presentable are shared with AFMF. A source image is acquired from
+    /// VK_QUEUE_FAMILY_EXTERNAL in VK_IMAGE_LAYOUT_GENERAL, a destination image is released
+    /// to VK_QUEUE_FAMILY_EXTERNAL in VK_IMAGE_LAYOUT_GENERAL after the copy.
     ///
-    void copyImage(VkCommandBuffer buf,
+    /// A presentable image owned by another family is acquired from it if it's the source,
+    /// and released back to it after the copy, see transferOwnership for the other halves.
+    ///
+    void copyImage(const Hooks::DeviceDispatch& vk, VkCommandBuffer buf,
             VkImage src, VkImage dst,
             uint32_t width, uint32_t height,
             VkPipelineStageFlags pre, VkPipelineStageFlags post,
-            bool makeSrcPresentable, bool makeDstPresentable);
+            bool makeSrcPresentable, bool makeDstPresentable,
+            uint32_t queueFamily, uint32_t ownerFamily);
+
+    ///
+    /// Record the owning family's half of an ownership transfer of a presentable image.
+    ///
+    /// @param vk Functions of the device.
+    /// @param buf The command buffer to record into, submitted on ownerFamily.
+    /// @param image The presentable image to transfer.
+    /// @param layout The layout the other family uses the image in, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+    ///               to read it or VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL to write it.
+    /// @param ownerFamily The queue family owning the image while it's presented.
+    /// @param queueFamily The queue family reading or writing the image.
+    /// @param release If true, release the image in VK_IMAGE_LAYOUT_PRESENT_SRC_KHR for queueFamily
+    ///                to read. Otherwise acquire it back in VK_IMAGE_LAYOUT_PRESENT_SRC_KHR.
+    ///
+    void transferOwnership(const Hooks::DeviceDispatch& vk, VkCommandBuffer buf,
+            VkImage image, VkImageLayout layout,
+            uint32_t ownerFamily, uint32_t queueFamily, bool release);
 
 }
 
@@ -1,28 +1,37 @@
 #include <afmf.hpp>
+#include "afmf/engine.hpp"
+#include "afmf/interpolator.hpp"
+#include "afmf/kernels.hpp"
 #include "log.hpp"
 
-// TODO: Enable once FidelityFX SDK is properly integrated
-// #include <FidelityFX/host/ffx_frameinterpolation.h>
-// #include <FidelityFX/host/backends/vk/ffx_vk.h>
-
+#include <algorithm>
+#include <mutex>
+#include <shared_mutex>
 #include <unordered_map>
 #include <memory>
+#include <string>
 
 namespace AFMF {
 
 namespace {
 
 struct AFMFContext {
-    // TODO: Enable once FidelityFX SDK is integrated
-    // FfxFrameInterpolationContext context;
-    uint32_t width, height;
-    std::vector<int> outputDescriptors;
-    int input0, input1;
+    ContextDescription desc;
+    VkExtent2D extent; // interpolated area, at most the size of the shared images
+    std::unique_ptr<Engine> engine; // transfers and generation, unless working on host memory
+    Interpolator interpolator; // generation for contexts working on host memory
+
+    // selected images, for inputs read and outputs written in place
+    uint32_t previousInput{0}, currentInput{0};
+    std::vector<uint32_t> outputImages;
 };
 
+// contexts are looked up from any thread, but only created and deleted by one at a time
 std::unordered_map<int32_t, std::unique_ptr<AFMFContext>> contexts;
+std::shared_mutex contextsMutex;
 int32_t nextContextId = 1;
-bool initialized = false;
+uint32_t users = 0; // initialize calls not yet matched by finalize, guarded by usersMutex
+std::mutex usersMutex;
 
 } // anonymous namespace
 
@@ -33,50 +42,164 @@ vulkan_error::vulkan_error(VkResult result, const std::string& message)
 vulkan_error::~vulkan_error() noexcept = default;
 
 void initialize() {
-    if (initialized) {
-        Log::warn("AFMF already initialized");
+    const std::lock_guard<std::mutex> lock(usersMutex);
+    if (users++ > 0) {
+        Log::debug("AFMF already initialized, {} users", users);
         return;
     }
-    
+
     Log::info("Initializing AFMF (AMD FidelityFX Motion Frames)");
-    
-    // TODO: Initialize FidelityFX backend
-    // This will need to be implemented once we have the FidelityFX SDK integration
-    
-    initialized = true;
-    Log::info("AFMF initialized successfully");
+
+    Log::info("AFMF initialized successfully, using {} kernels",
+              Kernels::getIsaName(Kernels::getIsa()));
 }
 
-int32_t createContext(uint32_t width, uint32_t height, int in0, int in1, 
-                      const std::vector<int>& outN) {
-    if (!initialized) {
+bool supportsFormat(VkFormat format) {
+    switch (format) {
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+        case VK_FORMAT_B8G8R8A8_UNORM:
+        case VK_FORMAT_B8G8R8A8_SRGB:
+        case VK_FORMAT_A8B8G8R8_UNORM_PACK32:
+        case VK_FORMAT_A8B8G8R8_SRGB_PACK32:
+        case VK_FORMAT_A2R10G10B10_UNORM_PACK32:
+        case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+        case VK_FORMAT_R16G16B16A16_SFLOAT:
+            return true;
+        default:
+            return false;
+    }
+}
+
+int32_t createContext(const ContextDescription& desc) {
+    // held throughout, so finalize can't clear the contexts while one is being created
+    const std::lock_guard<std::mutex> usersLock(usersMutex);
+    if (users == 0) {
         throw vulkan_error(VK_ERROR_INITIALIZATION_FAILED, "AFMF not initialized");
     }
+    if (!supportsFormat(desc.format)) {
+        throw vulkan_error(VK_ERROR_FORMAT_NOT_SUPPORTED,
+                          "Unsupported image format: " + std::to_string(static_cast<int>(desc.format)));
+    }
+    const bool inPlaceOutputs = std::ranges::count(desc.outN, inPlace) > 0;
+    if (inPlaceOutputs && desc.images.empty()) {
+        throw vulkan_error(VK_ERROR_INITIALIZATION_FAILED, "No images given to use in place");
+    }
+    if (desc.blockSize != 0 && desc.blockSize != 8 && desc.blockSize != 16 && desc.blockSize != 32) {
+        throw vulkan_error(VK_ERROR_INITIALIZATION_FAILED,
+                          "Unsupported motion estimation block size: " + std::to_string(desc.blockSize));
+    }
+    if (desc.device != VK_NULL_HANDLE && desc.queue == VK_NULL_HANDLE) {
+        throw vulkan_error(VK_ERROR_INITIALIZATION_FAILED, "No queue given to transfer frames on");
+    }
+    if (desc.device != VK_NULL_HANDLE && desc.dispatch == nullptr) {
+        throw vulkan_error(VK_ERROR_INITIALIZATION_FAILED, "No device functions given");
+    }
     
-    Log::info("Creating AFMF context: {}x{}, inputs: {}, {}, outputs: {}", 
-              width, height, in0, in1, outN.size());
+    Log::info("Creating AFMF context: {}x{}, format: {}, memory: {} ({} bytes, {} dedicated), outputs: {}", 
+              desc.width, desc.height, static_cast<int>(desc.format),
+              desc.memory, desc.memorySize, desc.dedicatedMemory.size(), desc.outN.size());
     
     auto context = std::make_unique<AFMFContext>();
-    context->width = width;
-    context->height = height;
-    context->input0 = in0;
-    context->input1 = in1;
-    context->outputDescriptors = outN;
-    
-    // TODO: Create FidelityFX Frame Interpolation context
-    // FfxFrameInterpolationContextDescription desc = {};
-    // desc.maxRenderSize.width = width;
-    // desc.maxRenderSize.height = height;
-    // auto result = ffxFrameInterpolationContextCreate(&context->context, &desc);
+    context->desc = desc;
+    context->extent = { .width = desc.width, .height = desc.height };
+    context->outputImages.resize(desc.outN.size());
+    if (desc.device != VK_NULL_HANDLE)
+        context->engine = std::make_unique<Engine>(desc);
+    else
+        context->interpolator = Interpolator(desc.format,
+            { .blockSize = desc.blockSize, .searchRange = desc.searchRange, .scale = desc.motionScale },
+            desc.sceneDetection,
+            std::make_shared<Scheduler>(desc.threads, desc.tileSize));
     
+    const std::unique_lock<std::shared_mutex> lock(contextsMutex);
     int32_t id = nextContextId++;
     contexts[id] = std::move(context);
     
-    Log::info("AFMF context created with ID: {}", id);
+    Log::info("AFMF context created with ID: {}{}", id,
+              desc.device == VK_NULL_HANDLE ? " (host memory)" : "");
+    if (desc.syncSemaphore >= 0)
+        Log::info("AFMF context {} synchronized through timeline semaphore: {}", id, desc.syncSemaphore);
+    if (!desc.images.empty())
+        Log::info("AFMF context {} using {} images in place", id, desc.images.size());
+    const auto& created = *contexts[id];
+    const auto& scheduler = created.engine
+        ? created.engine->getInterpolator().getScheduler() : created.interpolator.getScheduler();
+    Log::info("AFMF context {} generating frames on {} threads in {}px tiles", id,
+              scheduler.getThreadCount(), scheduler.getTileSize());
     return id;
 }
 
-void presentContext(int32_t id, int inSem, const std::vector<int>& outSem) {
+void resizeContext(int32_t id, uint32_t width, uint32_t height,
+                   const std::vector<VkImage>& images) {
+    const std::shared_lock<std::shared_mutex> lock(contextsMutex);
+    auto it = contexts.find(id);
+    if (it == contexts.end()) {
+        throw vulkan_error(VK_ERROR_INVALID_EXTERNAL_HANDLE,
+                          "Invalid context ID: " + std::to_string(id));
+    }
+
+    auto& context = it->second;
+    if (width > context->desc.width || height > context->desc.height) {
+        throw vulkan_error(VK_ERROR_INITIALIZATION_FAILED,
+                          "Area exceeds the shared images: " + std::to_string(width) + "x" + std::to_string(height));
+    }
+    if (!context->desc.images.empty() && images.empty()) {
+        throw vulkan_error(VK_ERROR_INITIALIZATION_FAILED, "No images given to use in place");
+    }
+
+    Log::info("Resizing AFMF context ID: {} to {}x{} (shared images: {}x{})",
+              id, width, height, context->desc.width, context->desc.height);
+
+    context->extent = { .width = width, .height = height };
+    if (!context->desc.images.empty())
+        context->desc.images = images;
+    context->previousInput = context->currentInput = 0;
+    if (context->engine)
+        context->engine->resize(context->extent, context->desc.images);
+}
+
+void selectInput(int32_t id, uint32_t index) {
+    const std::shared_lock<std::shared_mutex> lock(contextsMutex);
+    auto it = contexts.find(id);
+    if (it == contexts.end()) {
+        throw vulkan_error(VK_ERROR_INVALID_EXTERNAL_HANDLE,
+                          "Invalid context ID: " + std::to_string(id));
+    }
+
+    auto& context = it->second;
+    if (index >= context->desc.images.size()) {
+        throw vulkan_error(VK_ERROR_INITIALIZATION_FAILED,
+                          "Invalid input image index: " + std::to_string(index));
+    }
+
+    context->previousInput = context->currentInput;
+    context->currentInput = index;
+}
+
+void selectOutput(int32_t id, uint32_t output, uint32_t index) {
+    const std::shared_lock<std::shared_mutex> lock(contextsMutex);
+    auto it = contexts.find(id);
+    if (it == contexts.end()) {
+        throw vulkan_error(VK_ERROR_INVALID_EXTERNAL_HANDLE,
+                          "Invalid context ID: " + std::to_string(id));
+    }
+
+    auto& context = it->second;
+    if (output >= context->desc.outN.size() || context->desc.outN.at(output) != inPlace) {
+        throw vulkan_error(VK_ERROR_INITIALIZATION_FAILED,
+                          "Output is not written in place: " + std::to_string(output));
+    }
+    if (index >= context->desc.images.size()) {
+        throw vulkan_error(VK_ERROR_INITIALIZATION_FAILED,
+                          "Invalid output image index: " + std::to_string(index));
+    }
+
+    context->outputImages.at(output) = index;
+}
+
+void presentContext(int32_t id, int inSem, const std::vector<int>& outSem, int readSem) {
+    const std::shared_lock<std::shared_mutex> lock(contextsMutex);
     auto it = contexts.find(id);
     if (it == contexts.end()) {
         throw vulkan_error(VK_ERROR_INVALID_EXTERNAL_HANDLE, 
@@ -84,16 +207,98 @@ void presentContext(int32_t id, int inSem, const std::vector<int>& outSem) {
     }
     
     auto& context = it->second;
+    if (!context->engine) {
+        throw vulkan_error(VK_ERROR_INITIALIZATION_FAILED,
+                          "Context works on host memory: " + std::to_string(id));
+    }
+    if (context->desc.syncSemaphore >= 0) {
+        throw vulkan_error(VK_ERROR_INITIALIZATION_FAILED,
+                          "Context uses a timeline semaphore: " + std::to_string(id));
+    }
     
     Log::debug("Presenting AFMF context ID: {}, inSem: {}, outSem count: {}", 
                id, inSem, outSem.size());
     
-    // TODO: Implement FidelityFX frame interpolation dispatch
-    // FfxFrameInterpolationDispatchDescription dispatchDesc = {};
-    // auto result = ffxFrameInterpolationDispatch(&context->context, &dispatchDesc);
+    context->engine->present(context->currentInput, context->outputImages, inSem, outSem, readSem);
+}
+
+void presentContext(int32_t id, uint64_t inValue, uint64_t outValue, size_t count) {
+    const std::shared_lock<std::shared_mutex> lock(contextsMutex);
+    auto it = contexts.find(id);
+    if (it == contexts.end()) {
+        throw vulkan_error(VK_ERROR_INVALID_EXTERNAL_HANDLE,
+                          "Invalid context ID: " + std::to_string(id));
+    }
+
+    auto& context = it->second;
+    if (!context->engine) {
+        throw vulkan_error(VK_ERROR_INITIALIZATION_FAILED,
+                          "Context works on host memory: " + std::to_string(id));
+    }
+    if (context->desc.syncSemaphore < 0) {
+        throw vulkan_error(VK_ERROR_INITIALIZATION_FAILED,
+                          "Context has no timeline semaphore: " + std::to_string(id));
+    }
+
+    Log::debug("Presenting AFMF context ID: {}, wait value: {}, signal values: {}..{}, generating: {}",
+               id, inValue, outValue, outValue + context->desc.outN.size() - 1, count);
+
+    context->engine->present(context->currentInput, context->outputImages, inValue, outValue, count);
+}
+
+void presentContext(int32_t id, const HostImage& in0, const HostImage& in1,
+                    const std::vector<HostImage>& outN) {
+    const std::shared_lock<std::shared_mutex> lock(contextsMutex);
+    auto it = contexts.find(id);
+    if (it == contexts.end()) {
+        throw vulkan_error(VK_ERROR_INVALID_EXTERNAL_HANDLE,
+                          "Invalid context ID: " + std::to_string(id));
+    }
+
+    auto& context = it->second;
+    if (context->engine) {
+        throw vulkan_error(VK_ERROR_INITIALIZATION_FAILED,
+                          "Context works on Vulkan images: " + std::to_string(id));
+    }
+    if (in0.width != context->extent.width || in0.height != context->extent.height
+            || outN.size() > context->desc.outN.size()) {
+        throw vulkan_error(VK_ERROR_INITIALIZATION_FAILED,
+                          "Images don't match the context: " + std::to_string(id));
+    }
+
+    Log::debug("Presenting AFMF context ID: {} in host memory, outputs: {}", id, outN.size());
+
+    context->interpolator.interpolate(in0, in1, outN);
+}
+
+void flushContext(int32_t id, size_t pending) {
+    const std::shared_lock<std::shared_mutex> lock(contextsMutex);
+    auto it = contexts.find(id);
+    if (it == contexts.end()) {
+        throw vulkan_error(VK_ERROR_INVALID_EXTERNAL_HANDLE,
+                          "Invalid context ID: " + std::to_string(id));
+    }
+
+    const auto& context = it->second;
+    if (context->engine)
+        context->engine->flush(pending);
+}
+
+uint64_t getGenerationTime(int32_t id) {
+    const std::shared_lock<std::shared_mutex> lock(contextsMutex);
+    auto it = contexts.find(id);
+    if (it == contexts.end()) {
+        throw vulkan_error(VK_ERROR_INVALID_EXTERNAL_HANDLE,
+                          "Invalid context ID: " + std::to_string(id));
+    }
+
+    const auto& context = it->second;
+    return context->engine
+        ? context->engine->getGenerationTime() : context->interpolator.getTime();
 }
 
 void deleteContext(int32_t id) {
+    const std::unique_lock<std::shared_mutex> lock(contextsMutex);
     auto it = contexts.find(id);
     if (it == contexts.end()) {
         Log::warn("Attempted to delete non-existent AFMF context ID: {}", id);
@@ -101,31 +306,48 @@ void deleteContext(int32_t id) {
     }
     
     Log::info("Deleting AFMF context ID: {}", id);
-    
-    // TODO: Destroy FidelityFX context
-    // ffxFrameInterpolationContextDestroy(&it->second->context);
+
+    auto& context = it->second;
+    if (context->engine)
+        context->engine->waitIdle();
+    const auto& interpolator = context->engine
+        ? context->engine->getInterpolator() : context->interpolator;
+    const auto& estimator = interpolator.getMotionEstimator();
+    if (interpolator.hasMotion() && estimator.getTime() > 0)
+        Log::info("AFMF context {} estimated motion for {} pixels at {} Mpixels/s", id,
+                  estimator.getPixelCount(), estimator.getPixelCount() * 1000 / estimator.getTime());
+    if (interpolator.hasMotion() && estimator.getSearchCost().exhaustive > 0)
+        Log::info("AFMF context {} compared {} blocks, {}% of an exhaustive search", id,
+                  estimator.getSearchCost().evaluations,
+                  estimator.getSearchCost().evaluations * 100 / estimator.getSearchCost().exhaustive);
+    const auto& detector = interpolator.getSceneDetector();
+    if (interpolator.hasSceneDetection())
+        Log::info("AFMF context {} duplicated {} static and {} scene cut frame pairs, generated {}", id,
+                  detector.getCount(SceneChange::Static), detector.getCount(SceneChange::Cut),
+                  detector.getCount(SceneChange::Normal));
+    const auto& scheduler = interpolator.getScheduler();
+    if (scheduler.getTaskCount() > 0)
+        Log::info("AFMF context {} ran {} tasks on {} threads, {} of them stolen", id,
+                  scheduler.getTaskCount(), scheduler.getThreadCount(), scheduler.getStealCount());
     
     contexts.erase(it);
 }
 
 void finalize() {
-    if (!initialized) {
+    const std::lock_guard<std::mutex> lock(usersMutex);
+    if (users == 0 || --users > 0) {
         return;
     }
-    
+
     Log::info("Finalizing AFMF");
-    
+
     // Clean up all remaining contexts
+    const std::unique_lock<std::shared_mutex> contextsLock(contextsMutex);
     for (auto& [id, context] : contexts) {
         Log::warn("Cleaning up remaining AFMF context ID: {}", id);
-        // TODO: Destroy FidelityFX context
-        // ffxFrameInterpolationContextDestroy(&context->context);
     }
     contexts.clear();
-    
-    // TODO: Finalize FidelityFX backend
-    
-    initialized = false;
+
     Log::info("AFMF finalized");
 }
 
@@ -0,0 +1,484 @@
+#include "afmf/engine.hpp"
+#include "log.hpp"
+
+#include <exception>
+#include <memory>
+#include <string>
+
+using namespace AFMF;
+
+namespace {
+
+    constexpr VkImageSubresourceRange colorRange{
+        .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+        .levelCount = 1,
+        .layerCount = 1
+    };
+
+    constexpr uint64_t idleTimeout = 1000ULL * 1000 * 1000; // 1s, in ns
+
+    ///
+    /// Record copying an image into a host-visible buffer.
+    ///
+    /// Shared images are acquired from VK_QUEUE_FAMILY_EXTERNAL in VK_IMAGE_LAYOUT_GENERAL,
+    /// in-place images are read in VK_IMAGE_LAYOUT_PRESENT_SRC_KHR and left in it. In-place
+    /// images owned by another family are acquired from it and released back to it.
+    ///
+    void recordReadback(const Hooks::DeviceDispatch& vk, VkCommandBuffer buf, VkImage image, VkBuffer buffer,
+            VkExtent2D extent, bool inPlace, uint32_t queueFamily, uint32_t imageFamily) {
+        const bool owned = inPlace && imageFamily != VK_QUEUE_FAMILY_IGNORED;
+        const VkImageMemoryBarrier acquireBarrier{
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+            .oldLayout = inPlace ? VK_IMAGE_LAYOUT_PRESENT_SRC_KHR : VK_IMAGE_LAYOUT_GENERAL,
+            .newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            .srcQueueFamilyIndex = inPlace ? imageFamily : VK_QUEUE_FAMILY_EXTERNAL,
+            .dstQueueFamilyIndex = inPlace && !owned ? VK_QUEUE_FAMILY_IGNORED : queueFamily,
+            .image = image,
+            .subresourceRange = colorRange
+        };
+        vk.cmdPipelineBarrier(buf,
+            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+            0, nullptr, 0, nullptr, 1, &acquireBarrier);
+
+        const VkBufferImageCopy region{
+            .imageSubresource = {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .layerCount = 1
+            },
+            .imageExtent = { .width = extent.width, .height = extent.height, .depth = 1 }
+        };
+        vk.cmdCopyImageToBuffer(buf,
+            image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            buffer, 1, &region);
+
+        // make the copy visible to the host, and return in-place images to the presentation engine
+        const VkBufferMemoryBarrier hostBarrier{
+            .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .buffer = buffer,
+            .size = VK_WHOLE_SIZE
+        };
+        const VkImageMemoryBarrier presentBarrier{
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            .newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+            .srcQueueFamilyIndex = owned ? queueFamily : VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = owned ? imageFamily : VK_QUEUE_FAMILY_IGNORED,
+            .image = image,
+            .subresourceRange = colorRange
+        };
+        vk.cmdPipelineBarrier(buf,
+            VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+            0, nullptr, 1, &hostBarrier, inPlace ? 1 : 0, &presentBarrier);
+    }
+
+    ///
+    /// Record copying a host-visible buffer into an image.
+    ///
+    /// Shared images are released to VK_QUEUE_FAMILY_EXTERNAL in VK_IMAGE_LAYOUT_GENERAL,
+    /// in-place images are left in VK_IMAGE_LAYOUT_PRESENT_SRC_KHR. Their previous contents are
+    /// discarded, so in-place images owned by another family are only released to it.
+    ///
+    void recordUpload(const Hooks::DeviceDispatch& vk, VkCommandBuffer buf, VkBuffer buffer, VkImage image,
+            VkExtent2D extent, bool inPlace, uint32_t queueFamily, uint32_t imageFamily) {
+        const bool owned = inPlace && imageFamily != VK_QUEUE_FAMILY_IGNORED;
+        // the buffer is written on the host after submission, before the wait is satisfied
+        const VkBufferMemoryBarrier hostBarrier{
+            .sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_HOST_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .buffer = buffer,
+            .size = VK_WHOLE_SIZE
+        };
+        const VkImageMemoryBarrier dstBarrier{
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = image,
+            .subresourceRange = colorRange
+        };
+        vk.cmdPipelineBarrier(buf,
+            VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+            0, nullptr, 1, &hostBarrier, 1, &dstBarrier);
+
+        const VkBufferImageCopy region{
+            .imageSubresource = {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .layerCount = 1
+            },
+            .imageExtent = { .width = extent.width, .height = extent.height, .depth = 1 }
+        };
+        vk.cmdCopyBufferToImage(buf,
+            buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            1, &region);
+
+        const VkImageMemoryBarrier releaseBarrier{
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .dstAccessMask = inPlace ? static_cast<VkAccessFlags>(VK_ACCESS_MEMORY_READ_BIT) : 0U,
+            .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            .newLayout = inPlace ? VK_IMAGE_LAYOUT_PRESENT_SRC_KHR : VK_IMAGE_LAYOUT_GENERAL,
+            .srcQueueFamilyIndex = inPlace && !owned ? VK_QUEUE_FAMILY_IGNORED : queueFamily,
+            .dstQueueFamilyIndex = !inPlace ? VK_QUEUE_FAMILY_EXTERNAL : imageFamily,
+            .image = image,
+            .subresourceRange = colorRange
+        };
+        vk.cmdPipelineBarrier(buf,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+            0, nullptr, 0, nullptr, 1, &releaseBarrier);
+    }
+
+}
+
+Engine::Engine(const ContextDescription& desc)
+        : desc(desc),
+          extent{ .width = desc.width, .height = desc.height },
+          interpolator(desc.format,
+              { .blockSize = desc.blockSize, .searchRange = desc.searchRange, .scale = desc.motionScale },
+              desc.sceneDetection,
+              std::make_shared<Scheduler>(desc.threads, desc.tileSize)) {
+    // recreate the shared images exactly like the exporter, so they land on the same offsets
+    this->arena = Mini::ImageArena(*desc.dispatch, desc.device, desc.physicalDevice);
+    const auto createImage = [this](uint64_t expectedOffset) {
+        uint64_t offset{};
+        auto image = this->arena.createImage(this->extent, this->desc.format,
+            VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+            VK_IMAGE_ASPECT_COLOR_BIT,
+            &offset);
+        if (offset != expectedOffset)
+            throw vulkan_error(VK_ERROR_INVALID_EXTERNAL_HANDLE,
+                "Shared image offset mismatch: " + std::to_string(offset)
+                    + " != " + std::to_string(expectedOffset));
+        return image;
+    };
+    if (desc.images.empty()) {
+        this->inputs.at(0) = createImage(desc.in0);
+        this->inputs.at(1) = createImage(desc.in1);
+    }
+    this->outputs.resize(desc.outN.size());
+    for (size_t i = 0; i < desc.outN.size(); i++)
+        if (desc.outN.at(i) != inPlace)
+            this->outputs.at(i) = createImage(desc.outN.at(i));
+    if (desc.memory >= 0 || !desc.dedicatedMemory.empty())
+        this->arena.import(desc.memory, desc.memorySize, desc.dedicatedMemory);
+
+    // host copies are sized for the shared images, so resizing never reallocates them
+    const uint64_t size = static_cast<uint64_t>(desc.width) * desc.height
+        * Kernels::getPixelSize(desc.format);
+    for (auto& buffer : this->inputBuffers)
+        buffer = Mini::Buffer(*desc.dispatch, desc.device, desc.physicalDevice, size,
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+    for (size_t i = 0; i < desc.outN.size(); i++)
+        this->outputBuffers.emplace_back(*desc.dispatch, desc.device, desc.physicalDevice, size,
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+
+    this->submitBatch = Mini::SubmitBatch(*desc.dispatch);
+    this->cmdPool = Mini::CommandPool(*desc.dispatch, desc.device, desc.queueFamily);
+    this->record();
+
+    if (desc.syncSemaphore >= 0) {
+        this->syncSemaphore = Mini::Semaphore(*desc.dispatch, desc.device, 0, nullptr);
+        this->syncSemaphore.importFd(desc.syncSemaphore, false);
+        this->progress = Mini::Semaphore(*desc.dispatch, desc.device, 0, nullptr);
+    } else {
+        for (auto& slot : this->slots) {
+            slot.inSemaphore = Mini::Semaphore(*desc.dispatch, desc.device);
+            for (size_t i = 0; i < desc.outN.size(); i++)
+                slot.outSemaphores.emplace_back(*desc.dispatch, desc.device);
+            slot.readSemaphore = Mini::Semaphore(*desc.dispatch, desc.device);
+            slot.fence = Mini::Fence(*desc.dispatch, desc.device);
+            slot.targets.reserve(desc.outN.size());
+        }
+    }
+    if (!this->desc.queueMutex)
+        this->desc.queueMutex = std::make_shared<std::mutex>();
+    this->worker = std::thread(&Engine::work, this);
+}
+
+void Engine::record() {
+    // transfers are recorded once per source and target image and only selected when
+    // presenting. they may still be pending when submitted again, hence the simultaneous use.
+    this->readbackBufs.clear();
+    this->uploadBufs.clear();
+
+    const bool inPlaceInput = !this->desc.images.empty();
+    const std::vector<VkImage> sources = inPlaceInput ? this->desc.images
+        : std::vector<VkImage>{ this->inputs.at(0).handle(), this->inputs.at(1).handle() };
+    for (const auto& source : sources) {
+        auto& bufs = this->readbackBufs.emplace_back();
+        for (size_t i = 0; i < 2; i++) {
+            bufs.at(i) = Mini::CommandBuffer(*this->desc.dispatch, this->desc.device, this->cmdPool);
+            bufs.at(i).begin(VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT);
+            recordReadback(*this->desc.dispatch, bufs.at(i).handle(), source, this->inputBuffers.at(i).handle(),
+                this->extent, inPlaceInput, this->desc.queueFamily, this->desc.imageQueueFamily);
+            bufs.at(i).end();
+        }
+    }
+
+    for (size_t i = 0; i < this->desc.outN.size(); i++) {
+        const bool inPlaceOutput = this->desc.outN.at(i) == inPlace;
+        const std::vector<VkImage> targets = inPlaceOutput ? this->desc.images
+            : std::vector<VkImage>{ this->outputs.at(i).handle() };
+        auto& bufs = this->uploadBufs.emplace_back();
+        for (const auto& target : targets) {
+            auto& buf = bufs.emplace_back(*this->desc.dispatch, this->desc.device, this->cmdPool);
+            buf.begin(VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT);
+            recordUpload(*this->desc.dispatch, buf.handle(), this->outputBuffers.at(i).handle(), target,
+                this->extent, inPlaceOutput, this->desc.queueFamily, this->desc.imageQueueFamily);
+            buf.end();
+        }
+    }
+}
+
+void Engine::resize(VkExtent2D extent, const std::vector<VkImage>& images) {
+    this->waitIdle();
+
+    this->extent = extent;
+    if (!this->desc.images.empty())
+        this->desc.images = images;
+    this->firstFrame = this->frame;
+    this->record();
+}
+
+void Engine::present(uint32_t input, const std::vector<uint32_t>& outputs,
+        int inSem, const std::vector<int>& outSem, int readSem) {
+    if (outSem.size() > this->desc.outN.size())
+        throw vulkan_error(VK_ERROR_INITIALIZATION_FAILED,
+            "Expected at most " + std::to_string(this->desc.outN.size()) + " output semaphores");
+
+    const uint64_t frame = this->frame;
+    const Job job{
+        .frame = frame,
+        .extent = this->extent,
+        .outputs = outSem.size(),
+        .first = frame == this->firstFrame
+    };
+
+    // the slot's previous present must be done before its semaphores are replaced
+    auto& slot = this->slots.at(job.frame % 2);
+    for (uint64_t done = this->submitted.load(); done + 1 < frame; done = this->submitted.load())
+        this->submitted.wait(done);
+    if (slot.pending) {
+        (void)slot.fence.wait();
+        slot.pending = false;
+    }
+    slot.inSemaphore.importFd(inSem, true);
+    for (size_t i = 0; i < outSem.size(); i++)
+        slot.outSemaphores.at(i).importFd(outSem.at(i), false);
+    slot.signalRead = readSem >= 0;
+    if (slot.signalRead)
+        slot.readSemaphore.importFd(readSem, false);
+    slot.source = this->desc.images.empty() ? job.frame % 2 : input;
+    slot.targets.assign(outputs.begin(), outputs.end());
+
+    // read back, interpolate and upload on the worker
+    this->frame++;
+    {
+        const std::lock_guard<std::mutex> lock(this->mutex);
+        this->jobs.push_back(job);
+    }
+    this->queued.store(this->frame);
+    this->cv.notify_one();
+}
+
+void Engine::present(uint32_t input, const std::vector<uint32_t>& outputs,
+        uint64_t inValue, uint64_t outValue, size_t count) {
+    if (count > this->desc.outN.size())
+        throw vulkan_error(VK_ERROR_INITIALIZATION_FAILED,
+            "Expected at most " + std::to_string(this->desc.outN.size()) + " outputs");
+
+    const uint64_t frame = this->frame++;
+    const Job job{
+        .frame = frame,
+        .extent = this->extent,
+        .outputs = count,
+        .first = frame == this->firstFrame
+    };
+    const uint64_t base = job.frame * 3;
+    const size_t slot = job.frame % 2;
+    const size_t source = this->desc.images.empty() ? slot : input;
+
+    // read back once the input is ready and the previous frame is uploaded
+    this->submitBatch.add(this->readbackBufs.at(source).at(slot),
+        { this->syncSemaphore.handle(), this->progress.handle() }, { inValue, base },
+        { this->progress.handle() }, { base + 1 });
+
+    // upload once the worker is done. the last signal covers every earlier upload,
+    // and reaches the last output's value even if fewer outputs are generated.
+    const uint64_t lastValue = outValue + this->desc.outN.size() - 1;
+    for (size_t i = 0; i < job.outputs; i++) {
+        std::vector<VkSemaphore> signalSemaphores{ this->syncSemaphore.handle() };
+        std::vector<uint64_t> signalValues{ outValue + i };
+        if (i + 1 == job.outputs) {
+            signalValues.back() = lastValue;
+            signalSemaphores.emplace_back(this->progress.handle());
+            signalValues.emplace_back(base + 3);
+        }
+        this->submitBatch.add(this->uploadBufs.at(i).at(this->desc.outN.at(i) == inPlace ? outputs.at(i) : 0),
+            { this->progress.handle() }, { base + 2 },
+            signalSemaphores, signalValues);
+    }
+    if (job.outputs == 0 && this->desc.outN.empty())
+        this->submitBatch.addSignal({ this->progress.handle() }, { base + 2 },
+            { this->progress.handle() }, { base + 3 });
+    else if (job.outputs == 0)
+        this->submitBatch.addSignal({ this->progress.handle() }, { base + 2 },
+            { this->syncSemaphore.handle(), this->progress.handle() }, { lastValue, base + 3 });
+    this->submitBatch.flush(this->desc.queue);
+
+    {
+        const std::lock_guard<std::mutex> lock(this->mutex);
+        this->jobs.push_back(job);
+    }
+    this->cv.notify_one();
+}
+
+void Engine::interpolate(const Job& job) {
+    const uint64_t stride = static_cast<uint64_t>(job.extent.width)
+        * Kernels::getPixelSize(this->desc.format);
+    const auto hostImage = [&job, stride, this](const Mini::Buffer& buffer) {
+        return HostImage{
+            .data = buffer.getData(),
+            .width = job.extent.width,
+            .height = job.extent.height,
+            .stride = stride,
+            .format = this->desc.format
+        };
+    };
+
+    const auto& current = this->inputBuffers.at(job.frame % 2);
+    const auto& previous = job.first ? current : this->inputBuffers.at((job.frame + 1) % 2);
+    std::vector<HostImage> outN;
+    outN.reserve(job.outputs);
+    for (size_t i = 0; i < job.outputs; i++)
+        outN.emplace_back(hostImage(this->outputBuffers.at(i)));
+
+    this->interpolator.interpolate(hostImage(previous), hostImage(current), outN);
+    this->generationTime.store(this->interpolator.getTime());
+}
+
+void Engine::generate(const Job& job) {
+    auto& slot = this->slots.at(job.frame % 2);
+
+    // outputs are submitted even if reading back or interpolating failed, so they are signaled
+    bool read{false};
+    try {
+        {
+            const std::lock_guard<std::mutex> lock(*this->desc.queueMutex);
+            slot.fence.reset();
+            std::vector<VkSemaphore> readSemaphores;
+            if (slot.signalRead)
+                readSemaphores.emplace_back(slot.readSemaphore.handle());
+            this->readbackBufs.at(slot.source).at(job.frame % 2).submit(this->desc.queue,
+                { slot.inSemaphore.handle() }, readSemaphores, &slot.fence);
+            read = true;
+        }
+        while (!slot.fence.wait(idleTimeout))
+            if (this->stopping.load())
+                return;
+        this->interpolate(job);
+    } catch (const std::exception& e) {
+        Log::error("AFMF failed to generate frame {}: {}", job.frame, e.what());
+    }
+    try {
+        const std::lock_guard<std::mutex> lock(*this->desc.queueMutex);
+        slot.fence.reset();
+        for (size_t i = 0; i < job.outputs; i++)
+            this->submitBatch.add(this->uploadBufs.at(i).at(this->desc.outN.at(i) == inPlace ? slot.targets.at(i) : 0),
+                {}, {}, { slot.outSemaphores.at(i).handle() });
+        if (slot.signalRead && !read)
+            this->submitBatch.addSignal({}, {}, { slot.readSemaphore.handle() });
+        this->submitBatch.flush(this->desc.queue, &slot.fence);
+        slot.pending = true;
+    } catch (const std::exception& e) {
+        Log::error("AFMF failed to submit frame {}: {}", job.frame, e.what());
+    }
+}
+
+void Engine::work() {
+    while (true) {
+        Job job{};
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->cv.wait(lock, [this]() { return this->stopping.load() || !this->jobs.empty(); });
+            if (this->jobs.empty())
+                return;
+            job = this->jobs.front();
+            this->jobs.pop_front();
+        }
+
+        if (this->desc.syncSemaphore < 0) {
+            this->generate(job);
+            this->submitted.store(job.frame + 1);
+            this->submitted.notify_all();
+            continue;
+        }
+
+        // uploads are released even if interpolating failed, so the queue never stalls
+        const uint64_t base = job.frame * 3;
+        try {
+            while (!this->progress.wait(base + 1, idleTimeout))
+                if (this->stopping.load())
+                    return;
+            this->interpolate(job);
+        } catch (const std::exception& e) {
+            Log::error("AFMF failed to generate frame {}: {}", job.frame, e.what());
+        }
+        try {
+            this->progress.signal(base + 2);
+        } catch (const std::exception& e) {
+            Log::error("AFMF failed to release frame {}: {}", job.frame, e.what());
+        }
+    }
+}
+
+void Engine::flush(uint64_t pending) const {
+    const uint64_t frames = this->queued.load();
+    for (uint64_t done = this->submitted.load(); done + pending < frames; done = this->submitted.load())
+        this->submitted.wait(done);
+}
+
+void Engine::waitIdle() {
+    if (this->desc.syncSemaphore >= 0) {
+        if (!this->progress.wait(this->frame * 3, idleTimeout))
+            Log::warn("AFMF engine still busy after 1s, continuing anyway");
+        return;
+    }
+
+    this->flush();
+    for (auto& slot : this->slots) {
+        if (slot.pending) {
+            if (!slot.fence.wait(idleTimeout))
+                Log::warn("AFMF engine still busy after 1s, continuing anyway");
+            slot.pending = false;
+        }
+    }
+}
+
+Engine::~Engine() {
+    try {
+        this->waitIdle();
+    } catch (const std::exception& e) {
+        Log::error("AFMF failed to wait for the engine: {}", e.what());
+    }
+
+    if (this->worker.joinable()) {
+        {
+            const std::lock_guard<std::mutex> lock(this->mutex);
+            this->stopping.store(true);
+        }
+        this->cv.notify_one();
+        this->worker.join();
+    }
+}
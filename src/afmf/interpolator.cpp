@@ -0,0 +1,157 @@
+#include "afmf/interpolator.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <utility>
+
+using namespace AFMF;
+
+namespace {
+
+    // scale a quarter pixel vector by a weight out of 256, rounded to whole pixels
+    int32_t scaleVector(int32_t value, int32_t weight) {
+        return (value * weight + 512) >> 10;
+    }
+
+}
+
+Interpolator::Interpolator(VkFormat format, const MotionEstimator::Config& motion, bool sceneDetection,
+        std::shared_ptr<Scheduler> scheduler)
+        : format(format),
+          pixelSize(Kernels::getPixelSize(format)),
+          isa(Kernels::getIsa()),
+          blend(Kernels::getBlend(format, this->isa)),
+          scheduler(std::move(scheduler)),
+          motion(motion.blockSize != 0),
+          sceneDetection(sceneDetection) {
+    if (!this->blend)
+        throw vulkan_error(VK_ERROR_FORMAT_NOT_SUPPORTED,
+            "Unsupported image format: " + std::to_string(static_cast<int>(format)));
+    if (!this->scheduler)
+        throw vulkan_error(VK_ERROR_INITIALIZATION_FAILED, "No scheduler given to interpolate on");
+    if (this->motion)
+        this->estimator = MotionEstimator(format, motion, this->scheduler);
+    if (this->sceneDetection)
+        this->detector = SceneDetector(format, this->scheduler);
+}
+
+void Interpolator::interpolate(const HostImage& in0, const HostImage& in1,
+        const std::vector<HostImage>& outN) {
+    const auto matches = [&in0, this](const HostImage& image) {
+        return image.data && image.format == this->format
+            && image.width == in0.width && image.height == in0.height
+            && image.stride >= static_cast<uint64_t>(in0.width) * this->pixelSize;
+    };
+    if (!matches(in0) || !matches(in1))
+        throw vulkan_error(VK_ERROR_INITIALIZATION_FAILED, "Input images don't match the context");
+    for (const auto& out : outN)
+        if (!matches(out))
+            throw vulkan_error(VK_ERROR_INITIALIZATION_FAILED, "Output images don't match the context");
+    if (outN.empty())
+        return;
+
+    const auto start = std::chrono::steady_clock::now();
+    this->generate(in0, in1, outN);
+    this->time += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count());
+}
+
+void Interpolator::generate(const HostImage& in0, const HostImage& in1,
+        const std::vector<HostImage>& outN) {
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunsafe-buffer-usage"
+    const auto pixel = [this](const HostImage& image, uint32_t x, uint32_t y) {
+        return static_cast<uint8_t*>(image.data) + y * image.stride
+            + static_cast<size_t>(x) * this->pixelSize;
+    };
+#pragma clang diagnostic pop
+
+    // static pairs and cuts duplicate an input, the motion of a cut doesn't carry over
+    const SceneChange change = this->sceneDetection
+        ? this->detector.classify(in0, in1) : SceneChange::Normal;
+    if (change != SceneChange::Normal) {
+        const HostImage& source = change == SceneChange::Cut ? in0 : in1;
+        if (change == SceneChange::Cut && this->motion)
+            this->estimator.reset();
+        this->scheduler->runTiles(1, in0.height, 1,
+                [&](const Scheduler::Tile& tile, uint32_t /* thread */) {
+            for (const auto& out : outN)
+                for (uint32_t y = tile.top; y < tile.bottom; y++)
+                    std::memcpy(pixel(out, 0, y), pixel(source, 0, y),
+                        static_cast<size_t>(in0.width) * this->pixelSize);
+        });
+        return;
+    }
+
+    const auto phases = static_cast<uint32_t>(outN.size() + 1);
+    if (!this->motion) {
+        for (uint32_t i = 0; i < outN.size(); i++) {
+            const uint32_t weight = ((i + 1) * 256 + phases / 2) / phases;
+            this->scheduler->runTiles(1, in0.height, 1,
+                    [&](const Scheduler::Tile& tile, uint32_t /* thread */) {
+                for (uint32_t y = tile.top; y < tile.bottom; y++)
+                    this->blend(pixel(in0, 0, y), pixel(in1, 0, y), pixel(outN.at(i), 0, y),
+                        in0.width, weight);
+            });
+        }
+        return;
+    }
+
+    // the content of a block at phase t is found at t * v in the older frame
+    // and at (t - 1) * v in the newer one, clamped to the edges of the image
+    const MotionField& field = this->estimator.estimate(in0, in1);
+    const auto width = static_cast<int32_t>(in0.width);
+    const auto height = static_cast<int32_t>(in0.height);
+    for (uint32_t i = 0; i < outN.size(); i++) {
+        const uint32_t weight = ((i + 1) * 256 + phases / 2) / phases;
+        this->scheduler->runTiles(field.columns, field.rows, field.blockSize,
+                [&](const Scheduler::Tile& tile, uint32_t /* thread */) {
+            for (uint32_t row = tile.top; row < tile.bottom; row++) {
+                const uint32_t top = row * field.blockSize;
+                const uint32_t bottom = std::min(top + field.blockSize, in0.height);
+
+                // neighbouring blocks moving alike are blended as one span
+                for (uint32_t column = tile.left; column < tile.right;) {
+                    const MotionVector& vector = field.at(column, row);
+                    uint32_t end = column + 1;
+                    while (end < tile.right && field.at(end, row).x == vector.x
+                            && field.at(end, row).y == vector.y)
+                        end++;
+
+                    const auto left = static_cast<int32_t>(column * field.blockSize);
+                    const auto right = static_cast<int32_t>(std::min(end * field.blockSize, in0.width));
+                    const int32_t dx0 = scaleVector(vector.x, static_cast<int32_t>(weight));
+                    const int32_t dx1 = scaleVector(vector.x, static_cast<int32_t>(weight) - 256);
+                    const int32_t dy0 = scaleVector(vector.y, static_cast<int32_t>(weight));
+                    const int32_t dy1 = scaleVector(vector.y, static_cast<int32_t>(weight) - 256);
+
+                    // pixels sourced from outside the image are clamped one by one
+                    const int32_t innerLeft = std::clamp(std::max({ left, -dx0, -dx1 }), left, right);
+                    const int32_t innerRight = std::clamp(std::min({ right, width - dx0, width - dx1 }),
+                        innerLeft, right);
+                    for (uint32_t y = top; y < bottom; y++) {
+                        const auto y0 = static_cast<uint32_t>(std::clamp(static_cast<int32_t>(y) + dy0, 0, height - 1));
+                        const auto y1 = static_cast<uint32_t>(std::clamp(static_cast<int32_t>(y) + dy1, 0, height - 1));
+                        const auto blendRange = [&](int32_t from, int32_t to) {
+                            if (from >= to)
+                                return;
+                            const auto x0 = static_cast<uint32_t>(std::clamp(from + dx0, 0, width - 1));
+                            const auto x1 = static_cast<uint32_t>(std::clamp(from + dx1, 0, width - 1));
+                            this->blend(pixel(in0, x0, y0), pixel(in1, x1, y1),
+                                pixel(outN.at(i), static_cast<uint32_t>(from), y),
+                                static_cast<size_t>(to - from), weight);
+                        };
+                        for (int32_t x = left; x < innerLeft; x++)
+                            blendRange(x, x + 1);
+                        blendRange(innerLeft, innerRight);
+                        for (int32_t x = innerRight; x < right; x++)
+                            blendRange(x, x + 1);
+                    }
+                    column = end;
+                }
+            }
+        });
+    }
+}
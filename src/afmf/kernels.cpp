@@ -0,0 +1,326 @@
+#include "afmf/kernels.hpp"
+#include "log.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <cstring>
+#include <string_view>
+
+using namespace AFMF;
+
+namespace {
+
+    Kernels::Isa detectIsa() {
+        auto isa = Kernels::Isa::Scalar;
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("f16c")
+                && __builtin_cpu_supports("fma"))
+            isa = Kernels::Isa::AVX2;
+        else if (__builtin_cpu_supports("sse4.1"))
+            isa = Kernels::Isa::SSE4;
+#endif
+
+        // allow forcing a lower instruction set, e.g. to compare against the scalar kernels
+        const char* env = std::getenv("AFMF_ISA");
+        if (env) {
+            const std::string_view name(env);
+            if (name == "scalar")
+                isa = Kernels::Isa::Scalar;
+            else if (name == "sse4" && isa == Kernels::Isa::AVX2)
+                isa = Kernels::Isa::SSE4;
+            else if (name != "sse4" && name != "avx2")
+                Log::warn("Unknown AFMF_ISA '{}', using {}", name, Kernels::getIsaName(isa));
+        }
+        return isa;
+    }
+
+    // IEEE half precision conversion, rounding to nearest even
+    float halfToFloat(uint16_t half) {
+        const uint32_t sign = static_cast<uint32_t>(half & 0x8000U) << 16;
+        uint32_t exponent = (half >> 10) & 0x1FU;
+        uint32_t mantissa = half & 0x3FFU;
+
+        uint32_t bits{};
+        if (exponent == 0x1F) { // infinity or nan
+            bits = sign | 0x7F800000U | (mantissa << 13);
+        } else if (exponent != 0) { // normal
+            bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+        } else if (mantissa == 0) { // zero
+            bits = sign;
+        } else { // subnormal, normalize it
+            exponent = 113;
+            while (!(mantissa & 0x400U)) {
+                mantissa <<= 1;
+                exponent--;
+            }
+            bits = sign | (exponent << 23) | ((mantissa & 0x3FFU) << 13);
+        }
+
+        float value{};
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    uint16_t floatToHalf(float value) {
+        uint32_t bits{};
+        std::memcpy(&bits, &value, sizeof(bits));
+        const uint32_t sign = (bits >> 16) & 0x8000U;
+        bits &= 0x7FFFFFFFU;
+
+        if (bits >= 0x47800000U) // overflow, infinity or nan
+            return static_cast<uint16_t>(sign | (bits > 0x7F800000U ? 0x7E00U : 0x7C00U));
+
+        if (bits < 0x38800000U) { // subnormal or zero, let the fpu round
+            float rounded{};
+            std::memcpy(&rounded, &bits, sizeof(rounded));
+            rounded += 0.5F;
+            std::memcpy(&bits, &rounded, sizeof(bits));
+            return static_cast<uint16_t>(sign | (bits - 0x3F000000U));
+        }
+
+        // rebias the exponent and round the mantissa
+        bits += 0xC8000FFFU + ((bits >> 13) & 1U);
+        return static_cast<uint16_t>(sign | (bits >> 13));
+    }
+
+}
+
+Kernels::Isa Kernels::getIsa() {
+    static const Isa isa = detectIsa();
+    return isa;
+}
+
+const char* Kernels::getIsaName(Isa isa) {
+    switch (isa) {
+        case Isa::Scalar: return "scalar";
+        case Isa::SSE4: return "sse4";
+        case Isa::AVX2: return "avx2";
+    }
+    return "unknown";
+}
+
+uint32_t Kernels::getPixelSize(VkFormat format) {
+    switch (format) {
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+        case VK_FORMAT_B8G8R8A8_UNORM:
+        case VK_FORMAT_B8G8R8A8_SRGB:
+        case VK_FORMAT_A8B8G8R8_UNORM_PACK32:
+        case VK_FORMAT_A8B8G8R8_SRGB_PACK32:
+        case VK_FORMAT_A2R10G10B10_UNORM_PACK32:
+        case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+            return 4;
+        case VK_FORMAT_R16G16B16A16_SFLOAT:
+            return 8;
+        default:
+            return 0;
+    }
+}
+
+Kernels::BlendFn Kernels::getBlend(VkFormat format, Isa isa) {
+    // channel order doesn't matter when blending, only the channel layout
+    switch (format) {
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+        case VK_FORMAT_B8G8R8A8_UNORM:
+        case VK_FORMAT_B8G8R8A8_SRGB:
+        case VK_FORMAT_A8B8G8R8_UNORM_PACK32:
+        case VK_FORMAT_A8B8G8R8_SRGB_PACK32:
+#if defined(__x86_64__) || defined(__i386__)
+            if (isa == Isa::AVX2)
+                return &AVX2::blendRgba8;
+            if (isa == Isa::SSE4)
+                return &SSE4::blendRgba8;
+#endif
+            return &Scalar::blendRgba8;
+        case VK_FORMAT_A2R10G10B10_UNORM_PACK32:
+        case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+#if defined(__x86_64__) || defined(__i386__)
+            if (isa == Isa::AVX2)
+                return &AVX2::blendRgb10a2;
+#endif
+            return &Scalar::blendRgb10a2;
+        case VK_FORMAT_R16G16B16A16_SFLOAT:
+#if defined(__x86_64__) || defined(__i386__)
+            if (isa == Isa::AVX2)
+                return &AVX2::blendRgba16f;
+#endif
+            return &Scalar::blendRgba16f;
+        default:
+            return nullptr;
+    }
+}
+
+Kernels::LumaFn Kernels::getLuma(VkFormat format, Isa isa) {
+    switch (format) {
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+        case VK_FORMAT_B8G8R8A8_UNORM:
+        case VK_FORMAT_B8G8R8A8_SRGB:
+        case VK_FORMAT_A8B8G8R8_UNORM_PACK32:
+        case VK_FORMAT_A8B8G8R8_SRGB_PACK32:
+#if defined(__x86_64__) || defined(__i386__)
+            if (isa == Isa::AVX2)
+                return &AVX2::lumaRgba8;
+#endif
+            return &Scalar::lumaRgba8;
+        case VK_FORMAT_A2R10G10B10_UNORM_PACK32:
+        case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+            return &Scalar::lumaRgb10a2;
+        case VK_FORMAT_R16G16B16A16_SFLOAT:
+            return &Scalar::lumaRgba16f;
+        default:
+            return nullptr;
+    }
+}
+
+Kernels::CostFn Kernels::getSad(Isa isa) {
+#if defined(__x86_64__) || defined(__i386__)
+    if (isa == Isa::AVX2)
+        return &AVX2::sad;
+    if (isa == Isa::SSE4)
+        return &SSE4::sad;
+#endif
+    return &Scalar::sad;
+}
+
+Kernels::CostFn Kernels::getSatd(Isa isa) {
+#if defined(__x86_64__) || defined(__i386__)
+    // the 8x8 transform fills 128-bit registers exactly, avx2 has nothing to add
+    if (isa == Isa::AVX2 || isa == Isa::SSE4)
+        return &SSE4::satd;
+#endif
+    return &Scalar::satd;
+}
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunsafe-buffer-usage"
+
+void Kernels::Scalar::blendRgba8(const void* a, const void* b, void* out,
+        size_t count, uint32_t weight) {
+    const auto* pa = static_cast<const uint8_t*>(a);
+    const auto* pb = static_cast<const uint8_t*>(b);
+    auto* po = static_cast<uint8_t*>(out);
+    for (size_t i = 0; i < count * 4; i++)
+        po[i] = static_cast<uint8_t>((pa[i] * (256 - weight) + pb[i] * weight + 128) >> 8);
+}
+
+void Kernels::Scalar::blendRgb10a2(const void* a, const void* b, void* out,
+        size_t count, uint32_t weight) {
+    const auto* pa = static_cast<const uint8_t*>(a);
+    const auto* pb = static_cast<const uint8_t*>(b);
+    auto* po = static_cast<uint8_t*>(out);
+    for (size_t i = 0; i < count; i++) {
+        uint32_t pixelA{};
+        uint32_t pixelB{};
+        std::memcpy(&pixelA, pa + i * 4, 4);
+        std::memcpy(&pixelB, pb + i * 4, 4);
+
+        uint32_t pixel{};
+        for (const uint32_t shift : { 0U, 10U, 20U, 30U }) {
+            const uint32_t mask = shift == 30 ? 0x3U : 0x3FFU;
+            const uint32_t channelA = (pixelA >> shift) & mask;
+            const uint32_t channelB = (pixelB >> shift) & mask;
+            pixel |= ((channelA * (256 - weight) + channelB * weight + 128) >> 8) << shift;
+        }
+        std::memcpy(po + i * 4, &pixel, 4);
+    }
+}
+
+void Kernels::Scalar::blendRgba16f(const void* a, const void* b, void* out,
+        size_t count, uint32_t weight) {
+    const auto* pa = static_cast<const uint8_t*>(a);
+    const auto* pb = static_cast<const uint8_t*>(b);
+    auto* po = static_cast<uint8_t*>(out);
+    const float t = static_cast<float>(weight) / 256.0F;
+    for (size_t i = 0; i < count * 4; i++) {
+        uint16_t halfA{};
+        uint16_t halfB{};
+        std::memcpy(&halfA, pa + i * 2, 2);
+        std::memcpy(&halfB, pb + i * 2, 2);
+
+        const float valueA = halfToFloat(halfA);
+        const uint16_t half = floatToHalf(valueA + (halfToFloat(halfB) - valueA) * t);
+        std::memcpy(po + i * 2, &half, 2);
+    }
+}
+
+void Kernels::Scalar::lumaRgba8(const void* in, uint8_t* out, size_t count) {
+    const auto* pin = static_cast<const uint8_t*>(in);
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t* pixel = pin + i * 4;
+        out[i] = static_cast<uint8_t>((pixel[0] + 2 * pixel[1] + pixel[2] + 2) >> 2);
+    }
+}
+
+void Kernels::Scalar::lumaRgb10a2(const void* in, uint8_t* out, size_t count) {
+    const auto* pin = static_cast<const uint8_t*>(in);
+    for (size_t i = 0; i < count; i++) {
+        uint32_t pixel{};
+        std::memcpy(&pixel, pin + i * 4, 4);
+        const uint32_t sum = (pixel & 0x3FFU) + 2 * ((pixel >> 10) & 0x3FFU) + ((pixel >> 20) & 0x3FFU);
+        out[i] = static_cast<uint8_t>(std::min((sum + 8) >> 4, 255U));
+    }
+}
+
+void Kernels::Scalar::lumaRgba16f(const void* in, uint8_t* out, size_t count) {
+    const auto* pin = static_cast<const uint8_t*>(in);
+    for (size_t i = 0; i < count; i++) {
+        std::array<uint16_t, 3> halves{};
+        std::memcpy(halves.data(), pin + i * 8, 6);
+        const float value = (halfToFloat(halves[0]) + 2.0F * halfToFloat(halves[1])
+            + halfToFloat(halves[2])) * 0.25F;
+        out[i] = static_cast<uint8_t>(std::clamp(value, 0.0F, 1.0F) * 255.0F + 0.5F);
+    }
+}
+
+uint32_t Kernels::Scalar::sad(const uint8_t* a, size_t strideA,
+        const uint8_t* b, size_t strideB, uint32_t size) {
+    uint32_t sum{0};
+    for (uint32_t y = 0; y < size; y++)
+        for (uint32_t x = 0; x < size; x++)
+            sum += static_cast<uint32_t>(std::abs(a[y * strideA + x] - b[y * strideB + x]));
+    return sum;
+}
+
+namespace {
+
+    // in-place 8-point hadamard transform, the order of the outputs doesn't matter for satd
+    void hadamard8(std::array<int32_t, 64>& block, size_t offset, size_t stride) {
+        for (size_t len = 1; len < 8; len <<= 1) {
+            for (size_t i = 0; i < 8; i += 2 * len) {
+                for (size_t j = i; j < i + len; j++) {
+                    const int32_t first = block.at(offset + j * stride);
+                    const int32_t second = block.at(offset + (j + len) * stride);
+                    block.at(offset + j * stride) = first + second;
+                    block.at(offset + (j + len) * stride) = first - second;
+                }
+            }
+        }
+    }
+
+}
+
+uint32_t Kernels::Scalar::satd(const uint8_t* a, size_t strideA,
+        const uint8_t* b, size_t strideB, uint32_t size) {
+    uint32_t sum{0};
+    std::array<int32_t, 64> block{};
+    for (uint32_t by = 0; by < size; by += 8) {
+        for (uint32_t bx = 0; bx < size; bx += 8) {
+            for (size_t y = 0; y < 8; y++)
+                for (size_t x = 0; x < 8; x++)
+                    block.at(y * 8 + x) = a[(by + y) * strideA + bx + x] - b[(by + y) * strideB + bx + x];
+            for (size_t i = 0; i < 8; i++)
+                hadamard8(block, i * 8, 1); // rows
+            for (size_t i = 0; i < 8; i++)
+                hadamard8(block, i, 8); // columns
+            for (const int32_t coefficient : block)
+                sum += static_cast<uint32_t>(std::abs(coefficient));
+        }
+    }
+    return sum;
+}
+
+#pragma clang diagnostic pop
@@ -0,0 +1,302 @@
+#include "afmf/kernels.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <immintrin.h>
+
+#include <array>
+
+// kernels are compiled for their instruction set regardless of the build's target,
+// and only dispatched to if the cpu supports it, see Kernels::getBlend.
+#define AFMF_TARGET_SSE4 __attribute__((target("sse4.1")))
+#define AFMF_TARGET_AVX2 __attribute__((target("avx2,f16c,fma")))
+
+using namespace AFMF;
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunsafe-buffer-usage"
+
+namespace {
+
+    template<typename T>
+    const T* vec(const uint8_t* ptr) { return static_cast<const T*>(static_cast<const void*>(ptr)); }
+    template<typename T>
+    T* vec(uint8_t* ptr) { return static_cast<T*>(static_cast<void*>(ptr)); }
+
+    // blend 10-bit (or 2-bit) channels held in 32-bit lanes
+    AFMF_TARGET_AVX2 __m256i blendChannels(__m256i a, __m256i b, __m256i weightA, __m256i weightB) {
+        const __m256i sum = _mm256_add_epi32(
+            _mm256_mullo_epi32(a, weightA),
+            _mm256_mullo_epi32(b, weightB));
+        return _mm256_srli_epi32(_mm256_add_epi32(sum, _mm256_set1_epi32(128)), 8);
+    }
+
+}
+
+AFMF_TARGET_SSE4 void Kernels::SSE4::blendRgba8(const void* a, const void* b, void* out,
+        size_t count, uint32_t weight) {
+    const auto* pa = static_cast<const uint8_t*>(a);
+    const auto* pb = static_cast<const uint8_t*>(b);
+    auto* po = static_cast<uint8_t*>(out);
+
+    // a * (256 - w) + b * w + 128 stays below 2^16, so 16-bit lanes suffice
+    const __m128i weightA = _mm_set1_epi16(static_cast<short>(256 - weight));
+    const __m128i weightB = _mm_set1_epi16(static_cast<short>(weight));
+    const __m128i round = _mm_set1_epi16(128);
+    const __m128i zero = _mm_setzero_si128();
+
+    const size_t bytes = count * 4;
+    size_t i = 0;
+    for (; i + 16 <= bytes; i += 16) {
+        const __m128i va = _mm_loadu_si128(vec<__m128i>(pa + i));
+        const __m128i vb = _mm_loadu_si128(vec<__m128i>(pb + i));
+
+        const __m128i lo = _mm_add_epi16(_mm_add_epi16(
+            _mm_mullo_epi16(_mm_cvtepu8_epi16(va), weightA),
+            _mm_mullo_epi16(_mm_cvtepu8_epi16(vb), weightB)), round);
+        const __m128i hi = _mm_add_epi16(_mm_add_epi16(
+            _mm_mullo_epi16(_mm_unpackhi_epi8(va, zero), weightA),
+            _mm_mullo_epi16(_mm_unpackhi_epi8(vb, zero), weightB)), round);
+        _mm_storeu_si128(vec<__m128i>(po + i),
+            _mm_packus_epi16(_mm_srli_epi16(lo, 8), _mm_srli_epi16(hi, 8)));
+    }
+    Scalar::blendRgba8(pa + i, pb + i, po + i, (bytes - i) / 4, weight);
+}
+
+AFMF_TARGET_AVX2 void Kernels::AVX2::blendRgba8(const void* a, const void* b, void* out,
+        size_t count, uint32_t weight) {
+    const auto* pa = static_cast<const uint8_t*>(a);
+    const auto* pb = static_cast<const uint8_t*>(b);
+    auto* po = static_cast<uint8_t*>(out);
+
+    const __m256i weightA = _mm256_set1_epi16(static_cast<short>(256 - weight));
+    const __m256i weightB = _mm256_set1_epi16(static_cast<short>(weight));
+    const __m256i round = _mm256_set1_epi16(128);
+    const __m256i zero = _mm256_setzero_si256();
+
+    // unpacking and packing both work per 128-bit lane, so the byte order is kept
+    const size_t bytes = count * 4;
+    size_t i = 0;
+    for (; i + 32 <= bytes; i += 32) {
+        const __m256i va = _mm256_loadu_si256(vec<__m256i>(pa + i));
+        const __m256i vb = _mm256_loadu_si256(vec<__m256i>(pb + i));
+
+        const __m256i lo = _mm256_add_epi16(_mm256_add_epi16(
+            _mm256_mullo_epi16(_mm256_unpacklo_epi8(va, zero), weightA),
+            _mm256_mullo_epi16(_mm256_unpacklo_epi8(vb, zero), weightB)), round);
+        const __m256i hi = _mm256_add_epi16(_mm256_add_epi16(
+            _mm256_mullo_epi16(_mm256_unpackhi_epi8(va, zero), weightA),
+            _mm256_mullo_epi16(_mm256_unpackhi_epi8(vb, zero), weightB)), round);
+        _mm256_storeu_si256(vec<__m256i>(po + i),
+            _mm256_packus_epi16(_mm256_srli_epi16(lo, 8), _mm256_srli_epi16(hi, 8)));
+    }
+    Scalar::blendRgba8(pa + i, pb + i, po + i, (bytes - i) / 4, weight);
+}
+
+AFMF_TARGET_AVX2 void Kernels::AVX2::blendRgb10a2(const void* a, const void* b, void* out,
+        size_t count, uint32_t weight) {
+    const auto* pa = static_cast<const uint8_t*>(a);
+    const auto* pb = static_cast<const uint8_t*>(b);
+    auto* po = static_cast<uint8_t*>(out);
+
+    const __m256i weightA = _mm256_set1_epi32(static_cast<int>(256 - weight));
+    const __m256i weightB = _mm256_set1_epi32(static_cast<int>(weight));
+    const __m256i mask = _mm256_set1_epi32(0x3FF);
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256i va = _mm256_loadu_si256(vec<__m256i>(pa + i * 4));
+        const __m256i vb = _mm256_loadu_si256(vec<__m256i>(pb + i * 4));
+
+        const __m256i c0 = blendChannels(
+            _mm256_and_si256(va, mask),
+            _mm256_and_si256(vb, mask), weightA, weightB);
+        const __m256i c1 = blendChannels(
+            _mm256_and_si256(_mm256_srli_epi32(va, 10), mask),
+            _mm256_and_si256(_mm256_srli_epi32(vb, 10), mask), weightA, weightB);
+        const __m256i c2 = blendChannels(
+            _mm256_and_si256(_mm256_srli_epi32(va, 20), mask),
+            _mm256_and_si256(_mm256_srli_epi32(vb, 20), mask), weightA, weightB);
+        const __m256i c3 = blendChannels(
+            _mm256_srli_epi32(va, 30),
+            _mm256_srli_epi32(vb, 30), weightA, weightB);
+
+        const __m256i pixels = _mm256_or_si256(
+            _mm256_or_si256(c0, _mm256_slli_epi32(c1, 10)),
+            _mm256_or_si256(_mm256_slli_epi32(c2, 20), _mm256_slli_epi32(c3, 30)));
+        _mm256_storeu_si256(vec<__m256i>(po + i * 4), pixels);
+    }
+    Scalar::blendRgb10a2(pa + i * 4, pb + i * 4, po + i * 4, count - i, weight);
+}
+
+AFMF_TARGET_AVX2 void Kernels::AVX2::blendRgba16f(const void* a, const void* b, void* out,
+        size_t count, uint32_t weight) {
+    const auto* pa = static_cast<const uint8_t*>(a);
+    const auto* pb = static_cast<const uint8_t*>(b);
+    auto* po = static_cast<uint8_t*>(out);
+
+    const __m256 t = _mm256_set1_ps(static_cast<float>(weight) / 256.0F);
+
+    // two pixels, eight half floats per iteration
+    size_t i = 0;
+    for (; i + 2 <= count; i += 2) {
+        const __m256 va = _mm256_cvtph_ps(_mm_loadu_si128(vec<__m128i>(pa + i * 8)));
+        const __m256 vb = _mm256_cvtph_ps(_mm_loadu_si128(vec<__m128i>(pb + i * 8)));
+        const __m256 blended = _mm256_fmadd_ps(_mm256_sub_ps(vb, va), t, va);
+        _mm_storeu_si128(vec<__m128i>(po + i * 8),
+            _mm256_cvtps_ph(blended, _MM_FROUND_TO_NEAREST_INT));
+    }
+    Scalar::blendRgba16f(pa + i * 8, pb + i * 8, po + i * 8, count - i, weight);
+}
+
+AFMF_TARGET_SSE4 uint32_t Kernels::SSE4::sad(const uint8_t* a, size_t strideA,
+        const uint8_t* b, size_t strideB, uint32_t size) {
+    __m128i sum = _mm_setzero_si128();
+    if (size == 8) {
+        // two rows of eight samples per register
+        for (uint32_t y = 0; y < 8; y += 2) {
+            const __m128i va = _mm_unpacklo_epi64(
+                _mm_loadl_epi64(vec<__m128i>(a + y * strideA)),
+                _mm_loadl_epi64(vec<__m128i>(a + (y + 1) * strideA)));
+            const __m128i vb = _mm_unpacklo_epi64(
+                _mm_loadl_epi64(vec<__m128i>(b + y * strideB)),
+                _mm_loadl_epi64(vec<__m128i>(b + (y + 1) * strideB)));
+            sum = _mm_add_epi64(sum, _mm_sad_epu8(va, vb));
+        }
+    } else {
+        for (uint32_t y = 0; y < size; y++)
+            for (uint32_t x = 0; x < size; x += 16)
+                sum = _mm_add_epi64(sum, _mm_sad_epu8(
+                    _mm_loadu_si128(vec<__m128i>(a + y * strideA + x)),
+                    _mm_loadu_si128(vec<__m128i>(b + y * strideB + x))));
+    }
+    return static_cast<uint32_t>(_mm_cvtsi128_si32(sum) + _mm_extract_epi32(sum, 2));
+}
+
+namespace {
+
+    // 8-point hadamard transform across eight registers, one butterfly stage at a time
+    AFMF_TARGET_SSE4 void hadamard8(std::array<__m128i, 8>& rows) {
+        for (size_t len = 1; len < 8; len <<= 1) {
+            for (size_t i = 0; i < 8; i += 2 * len) {
+                for (size_t j = i; j < i + len; j++) {
+                    const __m128i first = rows.at(j);
+                    const __m128i second = rows.at(j + len);
+                    rows.at(j) = _mm_add_epi16(first, second);
+                    rows.at(j + len) = _mm_sub_epi16(first, second);
+                }
+            }
+        }
+    }
+
+    AFMF_TARGET_SSE4 void transpose8(std::array<__m128i, 8>& rows) {
+        const __m128i t0 = _mm_unpacklo_epi16(rows[0], rows[1]);
+        const __m128i t1 = _mm_unpackhi_epi16(rows[0], rows[1]);
+        const __m128i t2 = _mm_unpacklo_epi16(rows[2], rows[3]);
+        const __m128i t3 = _mm_unpackhi_epi16(rows[2], rows[3]);
+        const __m128i t4 = _mm_unpacklo_epi16(rows[4], rows[5]);
+        const __m128i t5 = _mm_unpackhi_epi16(rows[4], rows[5]);
+        const __m128i t6 = _mm_unpacklo_epi16(rows[6], rows[7]);
+        const __m128i t7 = _mm_unpackhi_epi16(rows[6], rows[7]);
+
+        const __m128i u0 = _mm_unpacklo_epi32(t0, t2);
+        const __m128i u1 = _mm_unpackhi_epi32(t0, t2);
+        const __m128i u2 = _mm_unpacklo_epi32(t1, t3);
+        const __m128i u3 = _mm_unpackhi_epi32(t1, t3);
+        const __m128i u4 = _mm_unpacklo_epi32(t4, t6);
+        const __m128i u5 = _mm_unpackhi_epi32(t4, t6);
+        const __m128i u6 = _mm_unpacklo_epi32(t5, t7);
+        const __m128i u7 = _mm_unpackhi_epi32(t5, t7);
+
+        rows[0] = _mm_unpacklo_epi64(u0, u4);
+        rows[1] = _mm_unpackhi_epi64(u0, u4);
+        rows[2] = _mm_unpacklo_epi64(u1, u5);
+        rows[3] = _mm_unpackhi_epi64(u1, u5);
+        rows[4] = _mm_unpacklo_epi64(u2, u6);
+        rows[5] = _mm_unpackhi_epi64(u2, u6);
+        rows[6] = _mm_unpacklo_epi64(u3, u7);
+        rows[7] = _mm_unpackhi_epi64(u3, u7);
+    }
+
+}
+
+AFMF_TARGET_SSE4 uint32_t Kernels::SSE4::satd(const uint8_t* a, size_t strideA,
+        const uint8_t* b, size_t strideB, uint32_t size) {
+    // differences of 8-bit samples stay within 16 bits through both 8-point transforms
+    const __m128i ones = _mm_set1_epi16(1);
+    __m128i sum = _mm_setzero_si128();
+    std::array<__m128i, 8> rows{};
+    for (uint32_t by = 0; by < size; by += 8) {
+        for (uint32_t bx = 0; bx < size; bx += 8) {
+            for (size_t y = 0; y < 8; y++)
+                rows.at(y) = _mm_sub_epi16(
+                    _mm_cvtepu8_epi16(_mm_loadl_epi64(vec<__m128i>(a + (by + y) * strideA + bx))),
+                    _mm_cvtepu8_epi16(_mm_loadl_epi64(vec<__m128i>(b + (by + y) * strideB + bx))));
+            hadamard8(rows); // columns
+            transpose8(rows);
+            hadamard8(rows); // rows
+            for (const __m128i& row : rows)
+                sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_abs_epi16(row), ones));
+        }
+    }
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+    return static_cast<uint32_t>(_mm_cvtsi128_si32(sum));
+}
+
+AFMF_TARGET_AVX2 void Kernels::AVX2::lumaRgba8(const void* in, uint8_t* out, size_t count) {
+    const auto* pin = static_cast<const uint8_t*>(in);
+
+    // r + 2g + b per pixel: byte pairs weighted (1, 2) and (1, 0), then the pairs summed
+    const __m256i weights = _mm256_set1_epi32(0x00010201);
+    const __m256i ones = _mm256_set1_epi16(1);
+    const __m256i round = _mm256_set1_epi32(2);
+    const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    const auto luma = [&](size_t offset) AFMF_TARGET_AVX2 {
+        const __m256i pixels = _mm256_loadu_si256(vec<__m256i>(pin + offset));
+        const __m256i sum = _mm256_madd_epi16(_mm256_maddubs_epi16(pixels, weights), ones);
+        return _mm256_srli_epi32(_mm256_add_epi32(sum, round), 2);
+    };
+
+    // 32 pixels per iteration. packing works per 128-bit lane, the permute restores the order
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32) {
+        const __m256i lo = _mm256_packus_epi32(luma(i * 4), luma(i * 4 + 32));
+        const __m256i hi = _mm256_packus_epi32(luma(i * 4 + 64), luma(i * 4 + 96));
+        _mm256_storeu_si256(vec<__m256i>(out + i),
+            _mm256_permutevar8x32_epi32(_mm256_packus_epi16(lo, hi), order));
+    }
+    Scalar::lumaRgba8(pin + i * 4, out + i, count - i);
+}
+
+AFMF_TARGET_AVX2 uint32_t Kernels::AVX2::sad(const uint8_t* a, size_t strideA,
+        const uint8_t* b, size_t strideB, uint32_t size) {
+    if (size < 16)
+        return SSE4::sad(a, strideA, b, strideB, size);
+
+    __m256i sum = _mm256_setzero_si256();
+    if (size == 16) {
+        // two rows of sixteen samples per register
+        for (uint32_t y = 0; y < 16; y += 2) {
+            const __m256i va = _mm256_set_m128i(
+                _mm_loadu_si128(vec<__m128i>(a + (y + 1) * strideA)),
+                _mm_loadu_si128(vec<__m128i>(a + y * strideA)));
+            const __m256i vb = _mm256_set_m128i(
+                _mm_loadu_si128(vec<__m128i>(b + (y + 1) * strideB)),
+                _mm_loadu_si128(vec<__m128i>(b + y * strideB)));
+            sum = _mm256_add_epi64(sum, _mm256_sad_epu8(va, vb));
+        }
+    } else {
+        for (uint32_t y = 0; y < size; y++)
+            for (uint32_t x = 0; x < size; x += 32)
+                sum = _mm256_add_epi64(sum, _mm256_sad_epu8(
+                    _mm256_loadu_si256(vec<__m256i>(a + y * strideA + x)),
+                    _mm256_loadu_si256(vec<__m256i>(b + y * strideB + x))));
+    }
+    const __m128i half = _mm_add_epi64(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    return static_cast<uint32_t>(_mm_cvtsi128_si32(half) + _mm_extract_epi32(half, 2));
+}
+
+#pragma clang diagnostic pop
+
+#endif
@@ -0,0 +1,534 @@
+#include "afmf/motion.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <span>
+#include <string>
+#include <utility>
+
+using namespace AFMF;
+
+namespace {
+
+    // rank candidates by cost, then by length so static areas don't pick up noise
+    bool isBetter(uint32_t cost, int32_t x, int32_t y, const MotionVector& best) {
+        if (cost != best.cost)
+            return cost < best.cost;
+        return std::abs(x) + std::abs(y) < std::abs(best.x) + std::abs(best.y);
+    }
+
+    // a block and its direct neighbours
+    constexpr std::array<std::pair<int32_t, int32_t>, 5> neighbourCandidates{{
+        {0, 0}, {-1, 0}, {1, 0}, {0, -1}, {0, 1}
+    }};
+
+    // a block's predicted motion is considered wrong if it matches this much worse than
+    // the previous pair's blocks did on average, plus an average luma difference of one
+    constexpr uint32_t fallbackFactor = 2;
+
+    // joint bilateral upsampling of vector fields, in reduced blocks and luma levels
+    constexpr float spatialSigma = 0.5F;
+    constexpr float rangeSigma = 8.0F;
+
+    // divide by a power of two, rounding to nearest
+    int32_t roundShift(int32_t value, uint32_t shift) {
+        return (value + (1 << (shift - 1))) >> shift;
+    }
+
+}
+
+MotionEstimator::MotionEstimator(VkFormat format, const Config& config,
+        std::shared_ptr<Scheduler> scheduler)
+        : config(config),
+          scheduler(std::move(scheduler)),
+          luma(Kernels::getLuma(format)),
+          sad(Kernels::getSad()),
+          satd(Kernels::getSatd()) {
+    if (!this->luma)
+        throw vulkan_error(VK_ERROR_FORMAT_NOT_SUPPORTED,
+            "Unsupported image format: " + std::to_string(static_cast<int>(format)));
+    if (config.blockSize != 8 && config.blockSize != 16 && config.blockSize != 32)
+        throw vulkan_error(VK_ERROR_INITIALIZATION_FAILED,
+            "Unsupported block size: " + std::to_string(config.blockSize));
+    if (config.searchRange < 1 || config.searchRange > 1024)
+        throw vulkan_error(VK_ERROR_INITIALIZATION_FAILED,
+            "Unsupported search range: " + std::to_string(config.searchRange));
+    if (config.scale != 1 && config.scale != 2 && config.scale != 4)
+        throw vulkan_error(VK_ERROR_INITIALIZATION_FAILED,
+            "Unsupported motion estimation scale: " + std::to_string(config.scale));
+    if (config.levels < 1 || config.levels > 8)
+        throw vulkan_error(VK_ERROR_INITIALIZATION_FAILED,
+            "Unsupported pyramid level count: " + std::to_string(config.levels));
+    if (!this->scheduler)
+        throw vulkan_error(VK_ERROR_INITIALIZATION_FAILED, "No scheduler given to estimate motion on");
+
+    // one filtered block and search cost per thread
+    this->blocks.resize(this->scheduler->getThreadCount(),
+        std::vector<uint8_t>(static_cast<size_t>(config.blockSize) * config.blockSize));
+    this->costs.resize(this->scheduler->getThreadCount());
+}
+
+const MotionField& MotionEstimator::estimate(const HostImage& in0, const HostImage& in1) {
+    const auto start = std::chrono::steady_clock::now();
+    const uint32_t blockSize = this->config.blockSize;
+
+    if (in1.width < blockSize || in1.height < blockSize) {
+        this->field.columns = (in1.width + blockSize - 1) / blockSize;
+        this->field.rows = (in1.height + blockSize - 1) / blockSize;
+        this->field.blockSize = blockSize;
+        this->field.vectors.assign(static_cast<size_t>(this->field.columns) * this->field.rows, {});
+        this->previous = this->field;
+        this->previousCost = 0;
+        this->lastCost = {};
+        return this->field;
+    }
+
+    const uint32_t finest = this->build(in0, in1);
+    std::ranges::fill(this->costs, ThreadCost{});
+
+    // search from the coarsest level down, each level seeded with the one above it
+    std::vector<MotionVector> parent;
+    uint32_t parentColumns{};
+    uint32_t parentRows{};
+    for (auto level = static_cast<uint32_t>(this->pyramids.at(1).size()); level-- > finest;) {
+        this->search(level, parent, parentColumns, parentRows);
+        if (parent.empty())
+            this->coarseBlocks = this->field.vectors.size();
+        parent = this->field.vectors;
+        parentColumns = this->field.columns;
+        parentRows = this->field.rows;
+    }
+    this->refine(finest);
+    if (finest > 0)
+        this->upsample(finest);
+    this->previous = this->field;
+    if (this->config.measure)
+        this->measure();
+
+    this->lastCost = {};
+    uint64_t coarseCost{};
+    for (const auto& cost : this->costs) {
+        this->lastCost.evaluations += cost.search.evaluations;
+        this->lastCost.exhaustive += cost.search.exhaustive;
+        coarseCost += cost.coarseCost;
+    }
+    this->previousCost = coarseCost / std::max<uint64_t>(1, this->coarseBlocks);
+    this->totalCost.evaluations += this->lastCost.evaluations;
+    this->totalCost.exhaustive += this->lastCost.exhaustive;
+
+    if (this->config.measure) {
+        uint64_t squaredError{};
+        for (const auto& cost : this->costs)
+            squaredError += cost.squaredError;
+        const double pixels = static_cast<double>(in1.width) * static_cast<double>(in1.height);
+        this->lastPsnr = squaredError == 0 ? std::numeric_limits<double>::infinity()
+            : 10.0 * std::log10(255.0 * 255.0 * pixels / static_cast<double>(squaredError));
+    }
+
+    this->pixelCount += static_cast<uint64_t>(in1.width) * in1.height;
+    this->time += static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count());
+    return this->field;
+}
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunsafe-buffer-usage"
+
+void MotionEstimator::reset() {
+    this->previous = {};
+    this->previousCost = 0;
+}
+
+uint32_t MotionEstimator::build(const HostImage& in0, const HostImage& in1) {
+    const uint32_t blockSize = this->config.blockSize;
+
+    // reduced resolutions are the first levels below the full one, searching stops there.
+    // every level must still fit a block
+    const auto reduced = static_cast<uint32_t>(std::countr_zero(this->config.scale));
+    uint32_t levels = 1;
+    while (levels < reduced + this->config.levels
+            && (in1.width >> levels) >= blockSize && (in1.height >> levels) >= blockSize)
+        levels++;
+    for (auto& pyramid : this->pyramids) {
+        pyramid.resize(levels);
+        for (uint32_t level = 0; level < levels; level++) {
+            Plane& plane = pyramid.at(level);
+            plane.width = in1.width >> level;
+            plane.height = in1.height >> level;
+            plane.data.resize(static_cast<size_t>(plane.width) * plane.height);
+        }
+    }
+
+    // both frames are split into bands of rows, each level waits for the one below it
+    const std::array<const HostImage*, 2> images{ &in0, &in1 };
+    const uint32_t bandHeight = this->scheduler->getTileSize();
+    for (uint32_t level = 0; level < levels; level++) {
+        const uint32_t height = this->pyramids.at(1).at(level).height;
+        const uint32_t bands = (height + bandHeight - 1) / bandHeight;
+        this->scheduler->run(static_cast<size_t>(bands) * 2, [&](size_t task, uint32_t /* thread */) {
+            const HostImage& image = *images.at(task / bands);
+            const Pyramid& pyramid = this->pyramids.at(task / bands);
+            const auto top = static_cast<uint32_t>(task % bands) * bandHeight;
+            const uint32_t bottom = std::min(top + bandHeight, height);
+
+            Plane& dst = this->pyramids.at(task / bands).at(level);
+            if (level == 0) {
+                for (uint32_t y = top; y < bottom; y++)
+                    this->luma(static_cast<const uint8_t*>(image.data) + y * image.stride,
+                        dst.data.data() + static_cast<size_t>(y) * dst.width, dst.width);
+                return;
+            }
+
+            // 2x2 box filter, odd rows and columns are dropped
+            const Plane& src = pyramid.at(level - 1);
+            for (uint32_t y = top; y < bottom; y++) {
+                const uint8_t* upper = src.data.data() + static_cast<size_t>(y) * 2 * src.width;
+                const uint8_t* lower = upper + src.width;
+                uint8_t* row = dst.data.data() + static_cast<size_t>(y) * dst.width;
+                for (uint32_t x = 0; x < dst.width; x++)
+                    row[x] = static_cast<uint8_t>(
+                        (upper[x * 2] + upper[x * 2 + 1] + lower[x * 2] + lower[x * 2 + 1] + 2) >> 2);
+            }
+        });
+    }
+
+    return std::min(reduced, levels - 1);
+}
+
+void MotionEstimator::search(uint32_t level, const std::vector<MotionVector>& parent,
+        uint32_t parentColumns, uint32_t parentRows) {
+    const Plane& ref = this->pyramids.at(0).at(level);
+    const Plane& cur = this->pyramids.at(1).at(level);
+    const uint32_t blockSize = this->config.blockSize;
+    const auto range = static_cast<int32_t>(
+        (this->config.searchRange + (1U << level) - 1) >> level);
+
+    // vectors are in whole pixels of the level until refined
+    this->field.columns = (cur.width + blockSize - 1) / blockSize;
+    this->field.rows = (cur.height + blockSize - 1) / blockSize;
+    this->field.blockSize = blockSize;
+    this->field.vectors.assign(static_cast<size_t>(this->field.columns) * this->field.rows, {});
+
+    // the previous pair's field can only seed the search if the grid hasn't changed
+    const Plane& base = this->pyramids.at(1).front();
+    const bool predicting = this->config.temporal && this->previous.blockSize == blockSize
+        && this->previous.columns == (base.width + blockSize - 1) / blockSize
+        && this->previous.rows == (base.height + blockSize - 1) / blockSize;
+    const auto fallbackCost = static_cast<uint32_t>(std::min<uint64_t>(UINT32_MAX,
+        this->previousCost * fallbackFactor + static_cast<uint64_t>(blockSize) * blockSize));
+
+    this->scheduler->runTiles(this->field.columns, this->field.rows, blockSize,
+            [&](const Scheduler::Tile& tile, uint32_t thread) {
+        auto& costs = this->costs.at(thread);
+        for (uint32_t by = tile.top; by < tile.bottom; by++) {
+            for (uint32_t bx = tile.left; bx < tile.right; bx++) {
+                // cut off blocks are moved inside the image
+                const auto ox = static_cast<int32_t>(std::min(bx * blockSize, cur.width - blockSize));
+                const auto oy = static_cast<int32_t>(std::min(by * blockSize, cur.height - blockSize));
+                const uint8_t* current = cur.data.data() + static_cast<size_t>(oy) * cur.width + ox;
+
+                uint64_t evaluations{1};
+                MotionVector best{ .x = 0, .y = 0, .cost = this->sad(current, cur.width,
+                    ref.data.data() + static_cast<size_t>(oy) * ref.width + ox, ref.width, blockSize) };
+                const auto consider = [&](int32_t x, int32_t y) {
+                    if (std::abs(x) > range || std::abs(y) > range
+                            || ox + x < 0 || oy + y < 0
+                            || ox + x + static_cast<int32_t>(blockSize) > static_cast<int32_t>(ref.width)
+                            || oy + y + static_cast<int32_t>(blockSize) > static_cast<int32_t>(ref.height))
+                        return;
+                    const uint32_t cost = this->sad(current, cur.width,
+                        ref.data.data() + static_cast<size_t>(oy + y) * ref.width + (ox + x),
+                        ref.width, blockSize);
+                    evaluations++;
+                    if (isBetter(cost, x, y, best))
+                        best = { .x = static_cast<int16_t>(x), .y = static_cast<int16_t>(y), .cost = cost };
+                };
+                const auto considerWindow = [&](int32_t centerX, int32_t centerY, int32_t radius) {
+                    for (int32_t y = centerY - radius; y <= centerY + radius; y++)
+                        for (int32_t x = centerX - radius; x <= centerX + radius; x++)
+                            consider(x, y);
+                };
+
+                // the previous pair's vectors around the block, scaled down to the level
+                uint64_t temporalEvaluations{};
+                const auto considerPrevious = [&](std::span<const std::pair<int32_t, int32_t>> neighbours) {
+                    const uint64_t before = evaluations;
+                    const int32_t scale = 1 << level;
+                    for (const auto& [dx, dy] : neighbours) {
+                        const int32_t column = (static_cast<int32_t>(bx) + dx) * scale;
+                        const int32_t row = (static_cast<int32_t>(by) + dy) * scale;
+                        if (column < 0 || row < 0
+                                || column >= static_cast<int32_t>(this->previous.columns)
+                                || row >= static_cast<int32_t>(this->previous.rows))
+                            continue;
+                        // the full resolution block at the center of the block
+                        const auto& vector = this->previous.at(
+                            std::min(static_cast<uint32_t>(column + scale / 2), this->previous.columns - 1),
+                            std::min(static_cast<uint32_t>(row + scale / 2), this->previous.rows - 1));
+                        consider(roundShift(vector.x, 2 + level), roundShift(vector.y, 2 + level));
+                    }
+                    temporalEvaluations += evaluations - before;
+                };
+
+                uint64_t exhaustive{};
+                if (parent.empty()) {
+                    // an exhaustive search compares every position of the window inside the image
+                    const auto windowSize = [range, blockSize](int32_t origin, uint32_t size) {
+                        const int32_t low = std::max(-range, -origin);
+                        const int32_t high = std::min(range,
+                            static_cast<int32_t>(size) - static_cast<int32_t>(blockSize) - origin);
+                        return static_cast<uint64_t>(high - low + 1);
+                    };
+                    exhaustive = 1 + windowSize(ox, ref.width) * windowSize(oy, ref.height);
+
+                    // only search the whole window if the motion doesn't carry over
+                    if (predicting) {
+                        considerPrevious(neighbourCandidates);
+                        const MotionVector center = best;
+                        considerWindow(center.x, center.y, std::max(2, range / 4));
+                    }
+                    if (!predicting || best.cost > fallbackCost)
+                        considerWindow(0, 0, range);
+                    costs.coarseCost += best.cost;
+                } else {
+                    // the parent block's vector and those of its neighbours, at twice the scale
+                    const auto px = static_cast<int32_t>(std::min(bx / 2, parentColumns - 1));
+                    const auto py = static_cast<int32_t>(std::min(by / 2, parentRows - 1));
+                    for (const auto& [dx, dy] : neighbourCandidates) {
+                        if (px + dx < 0 || py + dy < 0
+                                || px + dx >= static_cast<int32_t>(parentColumns)
+                                || py + dy >= static_cast<int32_t>(parentRows))
+                            continue;
+                        const auto& candidate = parent.at(static_cast<size_t>(py + dy) * parentColumns
+                            + static_cast<size_t>(px + dx));
+                        consider(candidate.x * 2, candidate.y * 2);
+                    }
+                    if (predicting)
+                        considerPrevious(std::span(neighbourCandidates).first(1));
+
+                    const MotionVector center = best;
+                    considerWindow(center.x, center.y, 2);
+                    exhaustive = evaluations - temporalEvaluations;
+                }
+
+                costs.search.evaluations += evaluations;
+                costs.search.exhaustive += exhaustive;
+                this->field.vectors.at(static_cast<size_t>(by) * this->field.columns + bx) = best;
+            }
+        }
+    });
+}
+
+void MotionEstimator::refine(uint32_t level) {
+    for (auto& vector : this->field.vectors) {
+        vector.x = static_cast<int16_t>(vector.x * 4);
+        vector.y = static_cast<int16_t>(vector.y * 4);
+    }
+    if (!this->config.subPixel)
+        return;
+
+    const Plane& ref = this->pyramids.at(0).at(level);
+    const Plane& cur = this->pyramids.at(1).at(level);
+    const uint32_t blockSize = this->config.blockSize;
+
+    this->scheduler->runTiles(this->field.columns, this->field.rows, blockSize,
+            [&](const Scheduler::Tile& tile, uint32_t thread) {
+        for (uint32_t by = tile.top; by < tile.bottom; by++) {
+            for (uint32_t bx = tile.left; bx < tile.right; bx++) {
+                const auto ox = static_cast<int32_t>(std::min(bx * blockSize, cur.width - blockSize));
+                const auto oy = static_cast<int32_t>(std::min(by * blockSize, cur.height - blockSize));
+                const uint8_t* current = cur.data.data() + static_cast<size_t>(oy) * cur.width + ox;
+
+                // satd against the reference block at a quarter pixel offset, bilinearly filtered
+                const auto cost = [&](int32_t x, int32_t y) -> uint32_t {
+                    const int32_t ix = ox + (x >> 2);
+                    const int32_t iy = oy + (y >> 2);
+                    const auto fx = static_cast<uint32_t>(x & 3);
+                    const auto fy = static_cast<uint32_t>(y & 3);
+                    if (ix < 0 || iy < 0
+                            || ix + static_cast<int32_t>(blockSize + (fx ? 1 : 0)) > static_cast<int32_t>(ref.width)
+                            || iy + static_cast<int32_t>(blockSize + (fy ? 1 : 0)) > static_cast<int32_t>(ref.height))
+                        return UINT32_MAX;
+
+                    const uint8_t* origin = ref.data.data() + static_cast<size_t>(iy) * ref.width + ix;
+                    if (!fx && !fy)
+                        return this->satd(current, cur.width, origin, ref.width, blockSize);
+
+                    for (uint32_t row = 0; row < blockSize; row++) {
+                        const uint8_t* top = origin + static_cast<size_t>(row) * ref.width;
+                        const uint8_t* bottom = fy ? top + ref.width : top;
+                        uint8_t* out = this->blocks.at(thread).data() + static_cast<size_t>(row) * blockSize;
+                        for (uint32_t col = 0; col < blockSize; col++) {
+                            const uint32_t right = fx ? col + 1 : col;
+                            out[col] = static_cast<uint8_t>(((4 - fx) * (4 - fy) * top[col]
+                                + fx * (4 - fy) * top[right]
+                                + (4 - fx) * fy * bottom[col]
+                                + fx * fy * bottom[right] + 8) >> 4);
+                        }
+                    }
+                    return this->satd(current, cur.width, this->blocks.at(thread).data(), blockSize, blockSize);
+                };
+
+                auto& vector = this->field.vectors.at(static_cast<size_t>(by) * this->field.columns + bx);
+                vector.cost = cost(vector.x, vector.y);
+
+                // half pixel steps around the whole pixel match, then quarter pixel steps
+                for (const int32_t step : { 2, 1 }) {
+                    const MotionVector center = vector;
+                    for (int32_t y = -step; y <= step; y += step) {
+                        for (int32_t x = -step; x <= step; x += step) {
+                            if (!x && !y)
+                                continue;
+                            const uint32_t candidate = cost(center.x + x, center.y + y);
+                            if (isBetter(candidate, center.x + x, center.y + y, vector))
+                                vector = {
+                                    .x = static_cast<int16_t>(center.x + x),
+                                    .y = static_cast<int16_t>(center.y + y),
+                                    .cost = candidate
+                                };
+                        }
+                    }
+                }
+            }
+        }
+    });
+}
+
+void MotionEstimator::upsample(uint32_t level) {
+    const MotionField reduced = this->field;
+    const Plane& full = this->pyramids.at(1).front();
+    const Plane& plane = this->pyramids.at(1).at(level);
+    const uint32_t blockSize = this->config.blockSize;
+    const uint32_t reducedSize = blockSize << level; // full resolution pixels per reduced block
+
+    const auto mean = [](const Plane& image, uint32_t left, uint32_t top, uint32_t width, uint32_t height) {
+        uint32_t sum{};
+        for (uint32_t y = top; y < top + height; y++) {
+            const uint8_t* row = image.data.data() + static_cast<size_t>(y) * image.width;
+            for (uint32_t x = left; x < left + width; x++)
+                sum += row[x];
+        }
+        return static_cast<float>(sum) / static_cast<float>(width * height);
+    };
+
+    // center of a reduced block in full resolution pixels, cut off blocks are moved inside
+    const auto reducedCenter = [blockSize, level](uint32_t index, uint32_t size) {
+        return (static_cast<float>(std::min(index * blockSize, size - blockSize))
+            + static_cast<float>(blockSize) / 2.0F) * static_cast<float>(1U << level);
+    };
+
+    // the luma of the reduced blocks guides the upsampling
+    std::vector<float> guides(reduced.vectors.size());
+    this->scheduler->runTiles(reduced.columns, reduced.rows, reducedSize,
+            [&](const Scheduler::Tile& tile, uint32_t /* thread */) {
+        for (uint32_t by = tile.top; by < tile.bottom; by++)
+            for (uint32_t bx = tile.left; bx < tile.right; bx++)
+                guides.at(static_cast<size_t>(by) * reduced.columns + bx) = mean(plane,
+                    std::min(bx * blockSize, plane.width - blockSize),
+                    std::min(by * blockSize, plane.height - blockSize), blockSize, blockSize);
+    });
+
+    this->field.columns = (full.width + blockSize - 1) / blockSize;
+    this->field.rows = (full.height + blockSize - 1) / blockSize;
+    this->field.vectors.assign(static_cast<size_t>(this->field.columns) * this->field.rows, {});
+
+    // joint bilateral filter: every block takes the vectors of the reduced blocks around it,
+    // weighted by distance and by how close their luma is to its own, so motion doesn't
+    // bleed across edges
+    this->scheduler->runTiles(this->field.columns, this->field.rows, blockSize,
+            [&](const Scheduler::Tile& tile, uint32_t /* thread */) {
+        for (uint32_t by = tile.top; by < tile.bottom; by++) {
+            for (uint32_t bx = tile.left; bx < tile.right; bx++) {
+                const uint32_t left = bx * blockSize;
+                const uint32_t top = by * blockSize;
+                const uint32_t width = std::min(blockSize, full.width - left);
+                const uint32_t height = std::min(blockSize, full.height - top);
+                const float guide = mean(full, left, top, width, height);
+                const float centerX = static_cast<float>(left) + static_cast<float>(width) / 2.0F;
+                const float centerY = static_cast<float>(top) + static_cast<float>(height) / 2.0F;
+
+                const auto column = static_cast<int32_t>(std::min(left / reducedSize, reduced.columns - 1));
+                const auto row = static_cast<int32_t>(std::min(top / reducedSize, reduced.rows - 1));
+                float sumX{};
+                float sumY{};
+                float sumWeight{};
+                float bestWeight{-1.0F};
+                uint32_t cost{};
+                for (int32_t dy = -1; dy <= 1; dy++) {
+                    for (int32_t dx = -1; dx <= 1; dx++) {
+                        if (column + dx < 0 || row + dy < 0
+                                || column + dx >= static_cast<int32_t>(reduced.columns)
+                                || row + dy >= static_cast<int32_t>(reduced.rows))
+                            continue;
+                        const auto rx = static_cast<uint32_t>(column + dx);
+                        const auto ry = static_cast<uint32_t>(row + dy);
+                        const auto& vector = reduced.at(rx, ry);
+
+                        // distances in reduced blocks, luma differences in levels
+                        const float distanceX = (centerX - reducedCenter(rx, plane.width)) / static_cast<float>(reducedSize);
+                        const float distanceY = (centerY - reducedCenter(ry, plane.height)) / static_cast<float>(reducedSize);
+                        const float difference = guide - guides.at(static_cast<size_t>(ry) * reduced.columns + rx);
+                        const float weight = std::exp(
+                            -(distanceX * distanceX + distanceY * distanceY) / (2.0F * spatialSigma * spatialSigma)
+                            - difference * difference / (2.0F * rangeSigma * rangeSigma));
+
+                        sumX += weight * static_cast<float>(vector.x);
+                        sumY += weight * static_cast<float>(vector.y);
+                        sumWeight += weight;
+                        if (weight > bestWeight) {
+                            bestWeight = weight;
+                            cost = vector.cost;
+                        }
+                    }
+                }
+
+                // reduced quarter pixels to full resolution ones
+                const float scale = static_cast<float>(1U << level) / sumWeight;
+                this->field.vectors.at(static_cast<size_t>(by) * this->field.columns + bx) = {
+                    .x = static_cast<int16_t>(std::lround(sumX * scale)),
+                    .y = static_cast<int16_t>(std::lround(sumY * scale)),
+                    .cost = cost
+                };
+            }
+        }
+    });
+}
+
+void MotionEstimator::measure() {
+    const Plane& ref = this->pyramids.at(0).front();
+    const Plane& cur = this->pyramids.at(1).front();
+    const uint32_t blockSize = this->config.blockSize;
+    const auto width = static_cast<int32_t>(cur.width);
+    const auto height = static_cast<int32_t>(cur.height);
+
+    // error of predicting the newer frame from the older one, at whole pixels
+    this->scheduler->runTiles(this->field.columns, this->field.rows, blockSize,
+            [&](const Scheduler::Tile& tile, uint32_t thread) {
+        uint64_t squaredError{};
+        for (uint32_t by = tile.top; by < tile.bottom; by++) {
+            for (uint32_t bx = tile.left; bx < tile.right; bx++) {
+                const auto& vector = this->field.at(bx, by);
+                const int32_t dx = roundShift(vector.x, 2);
+                const int32_t dy = roundShift(vector.y, 2);
+                for (uint32_t y = by * blockSize; y < std::min((by + 1) * blockSize, cur.height); y++) {
+                    const uint8_t* current = cur.data.data() + static_cast<size_t>(y) * cur.width;
+                    const uint8_t* reference = ref.data.data() + static_cast<size_t>(
+                        std::clamp(static_cast<int32_t>(y) + dy, 0, height - 1)) * ref.width;
+                    for (uint32_t x = bx * blockSize; x < std::min((bx + 1) * blockSize, cur.width); x++) {
+                        const int32_t difference = current[x]
+                            - reference[std::clamp(static_cast<int32_t>(x) + dx, 0, width - 1)];
+                        squaredError += static_cast<uint64_t>(difference * difference);
+                    }
+                }
+            }
+        }
+        this->costs.at(thread).squaredError += squaredError;
+    });
+}
+
+#pragma clang diagnostic pop
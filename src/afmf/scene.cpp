@@ -0,0 +1,103 @@
+#include "afmf/scene.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdlib>
+#include <string>
+#include <utility>
+
+using namespace AFMF;
+
+namespace {
+
+    // thumbnails average this many pixels of every this many rows
+    constexpr uint32_t thumbnailScale = 8;
+
+    // a pair is static if no thumbnail pixel changed by more than this many luma levels
+    constexpr uint32_t staticDifference = 2;
+
+    // a pair is a cut if more than half of the luma histogram moved to other bins
+    // and thumbnail pixels changed by this many luma levels on average
+    constexpr uint32_t histogramBins = 64;
+    constexpr uint32_t cutDifference = 32;
+
+}
+
+SceneDetector::SceneDetector(VkFormat format, std::shared_ptr<Scheduler> scheduler)
+        : scheduler(std::move(scheduler)),
+          luma(Kernels::getLuma(format)) {
+    if (!this->luma)
+        throw vulkan_error(VK_ERROR_FORMAT_NOT_SUPPORTED,
+            "Unsupported image format: " + std::to_string(static_cast<int>(format)));
+    if (!this->scheduler)
+        throw vulkan_error(VK_ERROR_INITIALIZATION_FAILED, "No scheduler given to detect scenes on");
+
+    this->rows.resize(this->scheduler->getThreadCount());
+}
+
+SceneChange SceneDetector::classify(const HostImage& in0, const HostImage& in1) {
+    this->width = (in1.width + thumbnailScale - 1) / thumbnailScale;
+    this->height = (in1.height + thumbnailScale - 1) / thumbnailScale;
+    const size_t pixels = static_cast<size_t>(this->width) * this->height;
+    for (auto& thumbnail : this->thumbnails)
+        thumbnail.resize(pixels);
+
+    // shrink both frames in bands of thumbnail rows, sampling the middle row of each group
+    const std::array<const HostImage*, 2> images{ &in0, &in1 };
+    this->scheduler->runTiles(1, this->height, thumbnailScale,
+            [&](const Scheduler::Tile& tile, uint32_t thread) {
+        auto& row = this->rows.at(thread);
+        row.resize(in1.width);
+        for (size_t image = 0; image < images.size(); image++) {
+            const HostImage& src = *images.at(image);
+            for (uint32_t y = tile.top; y < tile.bottom; y++) {
+                const uint32_t srcY = std::min(y * thumbnailScale + thumbnailScale / 2, in1.height - 1);
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunsafe-buffer-usage"
+                this->luma(static_cast<const uint8_t*>(src.data) + srcY * src.stride,
+                    row.data(), row.size());
+#pragma clang diagnostic pop
+
+                uint8_t* dst = &this->thumbnails.at(image).at(static_cast<size_t>(y) * this->width);
+                for (uint32_t x = 0; x < this->width; x++) {
+                    const uint32_t left = x * thumbnailScale;
+                    const uint32_t right = std::min(left + thumbnailScale, in1.width);
+                    uint32_t sum{};
+                    for (uint32_t i = left; i < right; i++)
+                        sum += row.at(i);
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunsafe-buffer-usage"
+                    dst[x] = static_cast<uint8_t>((sum + (right - left) / 2) / (right - left));
+#pragma clang diagnostic pop
+                }
+            }
+        }
+    });
+
+    // the thumbnails are small enough to compare on a single thread
+    std::array<std::array<uint32_t, histogramBins>, 2> histograms{};
+    uint64_t difference{};
+    uint32_t maxDifference{};
+    for (size_t i = 0; i < pixels; i++) {
+        const uint8_t a = this->thumbnails.at(0).at(i);
+        const uint8_t b = this->thumbnails.at(1).at(i);
+        histograms.at(0).at(a * histogramBins / 256)++;
+        histograms.at(1).at(b * histogramBins / 256)++;
+        const auto delta = static_cast<uint32_t>(std::abs(a - b));
+        difference += delta;
+        maxDifference = std::max(maxDifference, delta);
+    }
+    uint64_t moved{};
+    for (size_t bin = 0; bin < histogramBins; bin++)
+        moved += static_cast<uint64_t>(std::abs(
+            static_cast<int64_t>(histograms.at(0).at(bin)) - histograms.at(1).at(bin)));
+
+    // every moved pixel is counted twice, once leaving a bin and once entering another
+    SceneChange change = SceneChange::Normal;
+    if (maxDifference <= staticDifference)
+        change = SceneChange::Static;
+    else if (moved > pixels && difference > static_cast<uint64_t>(pixels) * cutDifference)
+        change = SceneChange::Cut;
+    this->counts.at(static_cast<size_t>(change))++;
+    return change;
+}
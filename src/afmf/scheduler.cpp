@@ -0,0 +1,159 @@
+#include "afmf/scheduler.hpp"
+
+#include <afmf.hpp>
+
+#include <algorithm>
+#include <exception>
+#include <string>
+#include <utility>
+
+using namespace AFMF;
+
+Scheduler::Scheduler(uint32_t threads, uint32_t tileSize) : tileSize(tileSize) {
+    if (tileSize == 0)
+        throw vulkan_error(VK_ERROR_INITIALIZATION_FAILED, "Unsupported tile size: 0");
+    if (threads == 0)
+        threads = std::max(1U, std::thread::hardware_concurrency());
+
+    for (uint32_t i = 0; i < threads; i++)
+        this->queues.emplace_back(std::make_unique<Queue>());
+    for (uint32_t i = 1; i < threads; i++)
+        this->threads.emplace_back(&Scheduler::work, this, i);
+}
+
+void Scheduler::run(size_t count, const TaskFn& task) {
+    if (count == 0)
+        return;
+    const std::lock_guard<std::mutex> runLock(this->runMutex);
+
+    const size_t threadCount = this->queues.size();
+    if (threadCount == 1 || count == 1) {
+        for (size_t i = 0; i < count; i++)
+            task(i, 0);
+        this->taskCount += count;
+        return;
+    }
+
+    {
+        const std::lock_guard<std::mutex> lock(this->mutex);
+        // deal out contiguous chunks, so neighbouring tiles stay on one thread
+        for (size_t i = 0; i < count; i++) {
+            auto& queue = *this->queues.at(i * threadCount / count);
+            const std::lock_guard<std::mutex> queueLock(queue.mutex);
+            queue.tasks.push_back(i);
+        }
+        this->job = &task;
+        this->remaining = count;
+        this->error = nullptr;
+        this->generation++;
+    }
+    this->cv.notify_all();
+
+    this->drain(0, task);
+
+    // threads still holding the job must let go of it before it goes out of scope
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->doneCv.wait(lock, [this]() { return this->remaining == 0 && this->active == 0; });
+    this->job = nullptr;
+    if (this->error)
+        std::rethrow_exception(std::exchange(this->error, nullptr));
+}
+
+void Scheduler::runTiles(uint32_t columns, uint32_t rows, uint32_t cellSize, const TileFn& tile) {
+    const uint32_t edge = std::max(1U, this->tileSize / std::max(1U, cellSize));
+    const uint32_t tileColumns = (columns + edge - 1) / edge;
+    const uint32_t tileRows = (rows + edge - 1) / edge;
+    this->run(static_cast<size_t>(tileColumns) * tileRows, [&](size_t task, uint32_t thread) {
+        const auto left = static_cast<uint32_t>(task % tileColumns) * edge;
+        const auto top = static_cast<uint32_t>(task / tileColumns) * edge;
+        tile({
+            .left = left,
+            .top = top,
+            .right = std::min(left + edge, columns),
+            .bottom = std::min(top + edge, rows)
+        }, thread);
+    });
+}
+
+void Scheduler::work(uint32_t thread) {
+    uint64_t seen{0};
+    while (true) {
+        const TaskFn* task{};
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            this->cv.wait(lock, [this, seen]() { return this->stopping || this->generation != seen; });
+            if (this->stopping)
+                return;
+            seen = this->generation;
+            if (this->remaining == 0)
+                continue;
+            task = this->job;
+            this->active++;
+        }
+
+        this->drain(thread, *task);
+
+        {
+            const std::lock_guard<std::mutex> lock(this->mutex);
+            this->active--;
+        }
+        this->doneCv.notify_all();
+    }
+}
+
+void Scheduler::drain(uint32_t thread, const TaskFn& task) {
+    const auto threadCount = static_cast<uint32_t>(this->queues.size());
+    while (true) {
+        // own tasks front to back, then steal others' from the back
+        size_t index{};
+        bool found{false};
+        bool stolen{false};
+        for (uint32_t offset = 0; !found && offset < threadCount; offset++) {
+            auto& queue = *this->queues.at((thread + offset) % threadCount);
+            const std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.tasks.empty())
+                continue;
+            if (offset == 0) {
+                index = queue.tasks.front();
+                queue.tasks.pop_front();
+            } else {
+                index = queue.tasks.back();
+                queue.tasks.pop_back();
+                stolen = true;
+            }
+            found = true;
+        }
+        if (!found)
+            return;
+
+        // the remaining tasks still run if one fails, the first error is rethrown by run
+        try {
+            task(index, thread);
+        } catch (...) {
+            const std::lock_guard<std::mutex> lock(this->mutex);
+            if (!this->error)
+                this->error = std::current_exception();
+        }
+        this->taskCount++;
+        if (stolen)
+            this->stealCount++;
+
+        bool done{};
+        {
+            const std::lock_guard<std::mutex> lock(this->mutex);
+            done = --this->remaining == 0;
+        }
+        if (done)
+            this->doneCv.notify_all();
+    }
+}
+
+Scheduler::~Scheduler() {
+    {
+        const std::lock_guard<std::mutex> lock(this->mutex);
+        this->stopping = true;
+    }
+    this->cv.notify_all();
+    for (auto& thread : this->threads)
+        thread.join();
+}
@@ -1,161 +1,809 @@
 #include "context.hpp"
+#include "log.hpp"
+#include "mini/stats.hpp"
 #include "utils.hpp"
 
 #include <afmf.hpp>
 
+#include <algorithm>
+#include <chrono>
+#include <exception>
 #include <vector>
 #include <vulkan/vulkan_core.h>
 
+namespace {
+
+    // weight of the newest sample in the averaged hook time, as a fraction 1/smoothing
+    constexpr uint64_t smoothing = 8;
+
+    uint64_t steadyNow() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+}
+
 LsContext::LsContext(const Hooks::DeviceInfo& info, VkSwapchainKHR swapchain,
-        VkExtent2D extent, const std::vector<VkImage>& swapchainImages)
+        VkExtent2D extent, VkFormat format, const std::vector<VkImage>& swapchainImages,
+        uint32_t framesInFlight, bool directInput, bool directOutput, bool presentThread,
+        bool exclusive, const LsContext* previous)
         : swapchain(swapchain), swapchainImages(swapchainImages),
-          extent(extent) {
-    // initialize afmf
-    int frame_0_fd{};
-    this->frame_0 = Mini::Image(
-        info.device, info.physicalDevice,
-        extent, VK_FORMAT_R8G8B8A8_UNORM,
-        VK_IMAGE_USAGE_TRANSFER_DST_BIT,
-        VK_IMAGE_ASPECT_COLOR_BIT,
-        &frame_0_fd);
-
-    int frame_1_fd{};
-    this->frame_1 = Mini::Image(
-        info.device, info.physicalDevice,
-        extent, VK_FORMAT_R8G8B8A8_UNORM,
-        VK_IMAGE_USAGE_TRANSFER_DST_BIT,
-        VK_IMAGE_ASPECT_COLOR_BIT,
-        &frame_1_fd);
-
-    std::vector<int> out_n_fds(info.frameGen);
-    for (size_t i = 0; i < info.frameGen; ++i)
-        this->out_n.emplace_back(
-            info.device, info.physicalDevice,
-            extent, VK_FORMAT_R8G8B8A8_UNORM,
-            VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
-            VK_IMAGE_ASPECT_COLOR_BIT,
-            &out_n_fds.at(i));
-
-    this->lsfgCtxId = std::shared_ptr<int32_t>(
-        new int32_t(AFMF::createContext(extent.width, extent.height,
-            frame_0_fd, frame_1_fd, out_n_fds)),
-        [](const int32_t* id) {
-            AFMF::deleteContext(*id);
-        }
-    );
-
-    // prepare render passes
-    this->cmdPool = Mini::CommandPool(info.device, info.queue.first);
-    for (size_t i = 0; i < 8; i++) {
-        auto& pass = this->passInfos.at(i);
-        pass.renderSemaphores.resize(info.frameGen);
-        pass.acquireSemaphores.resize(info.frameGen);
-        pass.postCopyBufs.resize(info.frameGen);
-        pass.postCopySemaphores.resize(info.frameGen);
-        pass.prevPostCopySemaphores.resize(info.frameGen);
+          extent(extent), capacity(extent), format(format),
+          directInput(directInput), directOutput(directInput && directOutput && !presentThread),
+          imageFamily(exclusive && info.transferQueue.first != info.queue.first
+              ? info.queue.first : VK_QUEUE_FAMILY_IGNORED),
+          transferMutex(info.transferMutex) {
+    // reuse the previous swapchain's afmf context and images if the new one fits
+    if (previous
+            && previous->format == format
+            && previous->directInput == this->directInput
+            && previous->directOutput == this->directOutput
+            && previous->imageFamily == this->imageFamily
+            && previous->out_n.size() == (this->directOutput ? 0 : info.frameGen)
+            && extent.width <= previous->capacity.width
+            && extent.height <= previous->capacity.height) {
+        // make sure nothing still uses the images about to be rewritten
+        for (const auto& pass : previous->passInfos)
+            if (pass.pending)
+                (void)pass.fence.wait();
+
+        this->capacity = previous->capacity;
+        this->arena = previous->arena;
+        this->frame_0 = previous->frame_0;
+        this->frame_1 = previous->frame_1;
+        this->out_n = previous->out_n;
+        this->syncSemaphore = previous->syncSemaphore;
+        this->lsfgCtxId = previous->lsfgCtxId;
+
+        // keep counting frames, so timeline values only ever increase
+        this->frameIdx = previous->frameIdx;
+        this->firstFrameIdx = previous->frameIdx;
+
+        AFMF::resizeContext(*this->lsfgCtxId, extent.width, extent.height,
+            directInput ? swapchainImages : std::vector<VkImage>());
+        Log::debug("Reusing AFMF context {} for {}x{} swapchain",
+            *this->lsfgCtxId, extent.width, extent.height);
+    } else {
+        // initialize afmf. all shared images are carved out of a single exported memory block,
+        // unless the driver needs them in memory of their own. outputs without an image are
+        // written to the acquired swapchain images.
+        AFMF::ContextDescription desc{
+            .width = extent.width,
+            .height = extent.height,
+            .format = format,
+            .blockSize = info.blockSize,
+            .searchRange = info.searchRange,
+            .motionScale = info.motionScale,
+            .sceneDetection = info.sceneDetection,
+            .threads = info.threads,
+            .tileSize = info.tileSize,
+            .outN = std::vector<uint64_t>(info.frameGen, AFMF::inPlace)
+        };
+        this->arena = Mini::ImageArena(info.next, info.device, info.physicalDevice);
+        if (!directInput) {
+            this->frame_0 = this->arena.createImage(
+                extent, format,
+                VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+                VK_IMAGE_ASPECT_COLOR_BIT,
+                &desc.in0);
+            this->frame_1 = this->arena.createImage(
+                extent, format,
+                VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+                VK_IMAGE_ASPECT_COLOR_BIT,
+                &desc.in1);
+        }
+        for (size_t i = 0; i < info.frameGen && !this->directOutput; ++i)
+            this->out_n.emplace_back(this->arena.createImage(
+                extent, format,
+                VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+                VK_IMAGE_ASPECT_COLOR_BIT,
+                &desc.outN.at(i)));
+        if (!directInput || !this->directOutput) {
+            this->arena.allocate(&desc.memory, &desc.dedicatedMemory);
+            desc.memorySize = this->arena.getSize();
+        }
+
+        if (info.timelineSemaphores)
+            this->syncSemaphore = Mini::Semaphore(info.next, info.device, 0, &desc.syncSemaphore);
+
+        // afmf transfers frames on the same queue as the copies, and reads
+        // (and writes) the swapchain images in place if possible
+        desc.device = info.device;
+        desc.physicalDevice = info.physicalDevice;
+        desc.dispatch = &info.next;
+        desc.queueFamily = info.transferQueue.first;
+        desc.queue = info.transferQueue.second;
+        desc.queueMutex = info.transferMutex;
+        if (directInput)
+            desc.images = swapchainImages;
+        desc.imageQueueFamily = this->imageFamily;
+
+        const int32_t ctxId = AFMF::createContext(desc);
+        this->lsfgCtxId = std::shared_ptr<int32_t>(
+            new int32_t(ctxId),
+            [](const int32_t* id) {
+                AFMF::deleteContext(*id);
+            }
+        );
+    }
+
+    // record copy commands for every swapchain image. these may still be pending from
+    // a previous frame when they are submitted again, hence the simultaneous use.
+    this->submitBatch = Mini::SubmitBatch(info.next);
+    this->copyBatch = Mini::SubmitBatch(info.next);
+    this->cmdPool = Mini::CommandPool(info.next, info.device, info.transferQueue.first);
+    if (!directInput) {
+        for (const auto& swapchainImage : swapchainImages) {
+            auto& bufs = this->preCopyBufs.emplace_back();
+            for (size_t i = 0; i < 2; i++) {
+                bufs.at(i) = Mini::CommandBuffer(info.next, info.device, this->cmdPool);
+                bufs.at(i).begin(VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT);
+                Utils::copyImage(info.next, bufs.at(i).handle(),
+                    swapchainImage,
+                    i == 0 ? this->frame_0.handle() : this->frame_1.handle(),
+                    extent.width, extent.height,
+                    VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                    true, false, info.transferQueue.first, this->imageFamily);
+                bufs.at(i).end();
+            }
+        }
+    }
+    for (const auto& outImage : this->out_n) {
+        auto& bufs = this->postCopyBufs.emplace_back();
+        for (const auto& swapchainImage : swapchainImages) {
+            auto& buf = bufs.emplace_back(info.next, info.device, this->cmdPool);
+            buf.begin(VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT);
+            Utils::copyImage(info.next, buf.handle(),
+                outImage.handle(),
+                swapchainImage,
+                extent.width, extent.height,
+                VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                false, true, info.transferQueue.first, this->imageFamily);
+            buf.end();
+        }
+    }
+
+    // record the owning family's halves of the ownership transfers around the copies
+    this->ownershipBatch = Mini::SubmitBatch(info.next);
+    if (this->imageFamily != VK_QUEUE_FAMILY_IGNORED) {
+        this->ownershipPool = Mini::CommandPool(info.next, info.device, this->imageFamily);
+        for (const auto& swapchainImage : swapchainImages) {
+            auto& bufs = this->ownershipBufs.emplace_back();
+            for (size_t i = 0; i < 3; i++) {
+                bufs.at(i) = Mini::CommandBuffer(info.next, info.device, this->ownershipPool);
+                bufs.at(i).begin(VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT);
+                Utils::transferOwnership(info.next, bufs.at(i).handle(), swapchainImage,
+                    i == 2 ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL : VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                    this->imageFamily, info.transferQueue.first, i == 0);
+                bufs.at(i).end();
+            }
+        }
+    }
+
+    // pace presents through the device's method. the driver knows the refresh period
+    // better than the configuration, if it tells.
+    uint64_t refreshPeriod = info.refreshRate == 0 ? 0 : 1000ULL * 1000 * 1000 / info.refreshRate;
+    this->pacing = info.pacing;
+    if (this->pacing == PacingMethod::DisplayTiming) {
+        auto getRefreshCycleDuration = reinterpret_cast<PFN_vkGetRefreshCycleDurationGOOGLE>(
+            info.next.getDeviceProcAddr(info.device, "vkGetRefreshCycleDurationGOOGLE"));
+        this->getPastPresentationTiming = reinterpret_cast<PFN_vkGetPastPresentationTimingGOOGLE>(
+            info.next.getDeviceProcAddr(info.device, "vkGetPastPresentationTimingGOOGLE"));
+        VkRefreshCycleDurationGOOGLE refreshCycle{};
+        if (getRefreshCycleDuration
+                && getRefreshCycleDuration(info.device, swapchain, &refreshCycle) == VK_SUCCESS)
+            refreshPeriod = refreshCycle.refreshDuration;
+        if (!this->getPastPresentationTiming)
+            this->pacing = PacingMethod::None;
+    } else if (this->pacing == PacingMethod::PresentWait) {
+        this->waitForPresent = reinterpret_cast<PFN_vkWaitForPresentKHR>(
+            info.next.getDeviceProcAddr(info.device, "vkWaitForPresentKHR"));
+        if (!this->waitForPresent)
+            this->pacing = PacingMethod::None;
+    }
+    this->pacer = FramePacer(refreshPeriod);
+    this->presentTimes.resize(info.frameGen + 1);
+    this->presentTimesInfos.resize(info.frameGen + 1);
+    this->presentIds.resize(info.frameGen + 1);
+    this->presentIdInfos.resize(info.frameGen + 1);
+    this->pastTimings.resize((info.frameGen + 1) * framesInFlight);
+    Log::debug("Pacing presents through method {}, refresh period {}us",
+        static_cast<int>(this->pacing), refreshPeriod / 1000);
+
+    // generation is measured from here on, the amount of frames starts at the most
+    // and follows the refresh period the presents are paced to
+    this->multiplier = MultiplierController(info.frameGen, refreshPeriod);
+    this->generationTime = AFMF::getGenerationTime(*this->lsfgCtxId);
+
+    // prepare render passes. every object is created up front and recycled
+    // once the pass' fence has signaled, so presenting doesn't create any.
+    this->passInfos.resize(framesInFlight);
+    for (auto& pass : this->passInfos) {
+        pass.fence = Mini::Fence(info.next, info.device);
+
+        if (!info.timelineSemaphores) {
+            pass.preCopySemaphores.at(0) = Mini::Semaphore(info.next, info.device, nullptr);
+            pass.preCopySemaphores.at(1) = Mini::Semaphore(info.next, info.device);
+            for (size_t j = 0; j < info.frameGen; j++)
+                pass.renderSemaphores.emplace_back(info.next, info.device, nullptr);
+        }
+
+        for (size_t j = 0; j < info.frameGen; j++) {
+            pass.acquireSemaphores.emplace_back(info.next, info.device);
+            pass.acquiredImages.emplace_back();
+            // without generated frames, lsfg signals the first one once it has read a frame in place
+            if (j == 0 && this->directInput && !info.timelineSemaphores)
+                pass.postCopySemaphores.emplace_back(info.next, info.device, nullptr);
+            else
+                pass.postCopySemaphores.emplace_back(info.next, info.device);
+            pass.prevPostCopySemaphores.emplace_back(info.next, info.device);
+        }
+
+        if (this->imageFamily != VK_QUEUE_FAMILY_IGNORED) {
+            pass.releaseSemaphore = Mini::Semaphore(info.next, info.device);
+            for (size_t j = 0; j <= info.frameGen; j++)
+                pass.presentSemaphores.emplace_back(info.next, info.device);
+        }
     }
+
+    // started last, once everything it uses is in place
+    if (presentThread)
+        this->presenter = std::make_unique<Presenter>(this->passInfos.size(),
+            [this, info](uint64_t passIdx) { this->presentPass(info, passIdx); });
 }
 
 VkResult LsContext::present(const Hooks::DeviceInfo& info, const void* pNext, VkQueue queue,
         const std::vector<VkSemaphore>& gameRenderSemaphores, uint32_t presentIdx) {
-    auto& pass = this->passInfos.at(this->frameIdx % 8);
-
-    // 1. copy swapchain image to frame_0/frame_1
-    int preCopySemaphoreFd{};
-    pass.preCopySemaphores.at(0) = Mini::Semaphore(info.device, &preCopySemaphoreFd);
-    pass.preCopySemaphores.at(1) = Mini::Semaphore(info.device);
-    pass.preCopyBuf = Mini::CommandBuffer(info.device, this->cmdPool);
-    pass.preCopyBuf.begin();
-
-    Utils::copyImage(pass.preCopyBuf.handle(),
-        this->swapchainImages.at(presentIdx),
-        this->frameIdx % 2 == 0 ? this->frame_0.handle() : this->frame_1.handle(),
-        this->extent.width, this->extent.height,
-        VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
-        true, false);
-
-    pass.preCopyBuf.end();
-
-    std::vector<VkSemaphore> gameRenderSemaphores2 = gameRenderSemaphores;
-    if (this->frameIdx > 0)
-        gameRenderSemaphores2.emplace_back(this->passInfos.at((this->frameIdx - 1) % 8)
-            .preCopySemaphores.at(1).handle());
-    pass.preCopyBuf.submit(info.queue.second,
-        gameRenderSemaphores2,
-        { pass.preCopySemaphores.at(0).handle(),
-          pass.preCopySemaphores.at(1).handle() });
-
-    // 2. render intermediary frames
-    std::vector<int> renderSemaphoreFds(info.frameGen);
-    for (size_t i = 0; i < info.frameGen; ++i)
-        pass.renderSemaphores.at(i) = Mini::Semaphore(info.device, &renderSemaphoreFds.at(i));
-
-    AFMF::presentContext(*this->lsfgCtxId,
-        preCopySemaphoreFd,
-        renderSemaphoreFds);
-
-    for (size_t i = 0; i < info.frameGen; i++) {
-        // 3. acquire next swapchain image
-        pass.acquireSemaphores.at(i) = Mini::Semaphore(info.device);
-        uint32_t imageIdx{};
-        auto res = vkAcquireNextImageKHR(info.device, this->swapchain, UINT64_MAX,
-            pass.acquireSemaphores.at(i).handle(), VK_NULL_HANDLE, &imageIdx);
-        if (res != VK_SUCCESS && res != VK_SUBOPTIMAL_KHR)
-            throw AFMF::vulkan_error(res, "Failed to acquire next swapchain image");
-
-        // 4. copy output image to swapchain image
-        pass.postCopySemaphores.at(i) = Mini::Semaphore(info.device);
-        pass.prevPostCopySemaphores.at(i) = Mini::Semaphore(info.device);
-        pass.postCopyBufs.at(i) = Mini::CommandBuffer(info.device, this->cmdPool);
-        pass.postCopyBufs.at(i).begin();
-
-        Utils::copyImage(pass.postCopyBufs.at(i).handle(),
-            this->out_n.at(i).handle(),
-            this->swapchainImages.at(imageIdx),
-            this->extent.width, this->extent.height,
-            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
-            false, true);
-
-        pass.postCopyBufs.at(i).end();
-        pass.postCopyBufs.at(i).submit(info.queue.second,
-            { pass.acquireSemaphores.at(i).handle(),
-              pass.renderSemaphores.at(i).handle() },
-            { pass.postCopySemaphores.at(i).handle(),
-              pass.prevPostCopySemaphores.at(i).handle() });
+    const uint64_t start = steadyNow();
+    const VkResult res = this->queueFrame(info, pNext, queue, gameRenderSemaphores, presentIdx);
 
-        // 5. present swapchain image
-        std::vector<VkSemaphore> waitSemaphores{ pass.postCopySemaphores.at(i).handle() };
+    // measure how long the application is held up, which the present thread cuts down
+    this->lastHookTime = steadyNow() - start;
+    this->hookTime = this->hookTime == 0 ? this->lastHookTime
+        : this->hookTime - this->hookTime / smoothing + this->lastHookTime / smoothing;
+    this->maxHookTime = std::max(this->maxHookTime, this->lastHookTime);
+    return res;
+}
+
+VkResult LsContext::queueFrame(const Hooks::DeviceInfo& info, const void* pNext, VkQueue queue,
+        const std::vector<VkSemaphore>& gameRenderSemaphores, uint32_t presentIdx) {
+    auto& pass = this->passInfos.at(this->frameIdx % this->passInfos.size());
+    const Mini::Stats::Counter creations; // objects created by this present only
+
+    // pick the amount of frames to generate from the real frame times and generation cost.
+    // every frame is in flight if the present thread still has this pass, or the gpu does.
+    const bool queued = this->presenter
+        && this->presenter->getOutstanding() == this->presenter->getCapacity();
+    const bool full = queued || (pass.pending && !pass.fence.wait(0));
+    const uint64_t generationTime = AFMF::getGenerationTime(*this->lsfgCtxId);
+    const uint64_t previousCount = this->multiplier.getOutputs();
+    const uint64_t count = this->multiplier.update(steadyNow(),
+        generationTime - this->generationTime, full);
+    this->generationTime = generationTime;
+    if (count != previousCount)
+        Log::debug("Generating {} frames per real frame, real frames take {}us",
+            count, this->multiplier.getFrameTime() / 1000);
+
+    // 0. wait for the previous use of this pass to finish, then recycle it
+    if (full) {
+        this->backpressureCount++;
+        if (info.skipWhenFull) {
+            this->skippedCount++;
+            Log::debug("All {} frames in flight, skipping frame generation ({} skipped so far)",
+                this->passInfos.size(), this->skippedCount);
+
+            // present the frame as-is, behind the frames handed to the present thread.
+            // the frame index isn't advanced, so the next frame pairs up with the last generated one.
+            const VkPresentInfoKHR presentInfo{
+                .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
+                .pNext = pNext,
+                .waitSemaphoreCount = static_cast<uint32_t>(gameRenderSemaphores.size()),
+                .pWaitSemaphores = gameRenderSemaphores.data(),
+                .swapchainCount = 1,
+                .pSwapchains = &this->swapchain,
+                .pImageIndices = &presentIdx,
+            };
+            this->frameCreations = 0;
+            this->frameSubmits = 0;
+            this->waitIdle();
+            const std::lock_guard<std::mutex> lock(this->swapchainMutex);
+            return info.next.queuePresent(queue, &presentInfo);
+        }
+
+        Log::debug("All {} frames in flight, waiting for the oldest one ({} times so far)",
+            this->passInfos.size(), this->backpressureCount);
+    }
+    if (this->presenter)
+        this->presenter->wait(this->passInfos.size() - 1);
+    if (pass.pending) {
+        (void)pass.fence.wait();
+        pass.fence.reset();
+        pass.pending = false;
+    }
+
+    // in timeline mode, frame n uses the values base + 1 (pre-copy done)
+    // and base + 2 + i (output i done) on the sync semaphore
+    const uint64_t timelineBase = this->frameIdx * (info.frameGen + 1);
+
+    // all submissions of a frame are batched. lsfg submits its transfers to the same
+    // queue, so the pre-copy is flushed before rendering and the post-copies after it,
+    // keeping every wait behind its signal in submission order.
+    this->submitBatch.resetSubmitCount();
+
+    // hand the real frame over to the transfer queue if it's owned by the presenting family.
+    // the release is submitted where the application presents, so it follows the frame's rendering.
+    std::vector<VkSemaphore> preWaitSemaphores = gameRenderSemaphores;
+    if (this->imageFamily != VK_QUEUE_FAMILY_IGNORED) {
+        this->submitBatch.add(this->ownershipBufs.at(presentIdx).at(0),
+            gameRenderSemaphores, {}, { pass.releaseSemaphore.handle() });
+        this->submitBatch.flush(queue);
+        preWaitSemaphores = { pass.releaseSemaphore.handle() };
+    }
+
+    // 3. acquire next swapchain images up front if lsfg writes to them. there's no present
+    // thread then, which could hold back the images acquiring waits for.
+    if (this->directOutput) {
+        for (size_t i = 0; i < count; i++) {
+            const VkSemaphore acquireSemaphore = pass.acquireSemaphores.at(i).handle();
+            auto& imageIdx = pass.acquiredImages.at(i);
+            auto res = info.next.acquireNextImage(info.device, this->swapchain, UINT64_MAX,
+                acquireSemaphore, VK_NULL_HANDLE, &imageIdx);
+            if (res != VK_SUCCESS && res != VK_SUBOPTIMAL_KHR)
+                throw AFMF::vulkan_error(res, "Failed to acquire next swapchain image");
+            AFMF::selectOutput(*this->lsfgCtxId, static_cast<uint32_t>(i), imageIdx);
+            preWaitSemaphores.emplace_back(acquireSemaphore);
+        }
+    }
+
+    // lsfg's uploads into out_n must come after the present thread's copies out of them
+    if (this->presenter && !this->directOutput && count > 0) {
+        uint32_t copied = this->postCopies.load(std::memory_order_acquire);
+        while (copied != this->presenter->getPushCount()) {
+            this->postCopies.wait(copied, std::memory_order_acquire);
+            copied = this->postCopies.load(std::memory_order_acquire);
+        }
+    }
+
+    // with binary semaphores, lsfg submits from its worker holding the transfer mutex. it must
+    // be done reading the frame about to be overwritten, presented before the previous one.
+    if (!info.timelineSemaphores)
+        AFMF::flushContext(*this->lsfgCtxId, 1);
+
+    // 1. copy swapchain image to frame_0/frame_1, or let lsfg read it in place.
+    // without generated frames, the actual frame is presented once it's copied or read
+    std::unique_lock<std::mutex> transferLock(*this->transferMutex);
+    if (this->directInput)
+        AFMF::selectInput(*this->lsfgCtxId, presentIdx);
+    if (info.timelineSemaphores) {
+        // waiting for the previous frame's last output also ensures
+        // lsfg is done reading the frame about to be overwritten
+        std::vector<uint64_t> waitValues(preWaitSemaphores.size(), 0);
+        preWaitSemaphores.emplace_back(this->syncSemaphore.handle());
+        waitValues.emplace_back(timelineBase);
+        std::vector<VkSemaphore> signalSemaphores{ this->syncSemaphore.handle() };
+        std::vector<uint64_t> signalValues{ timelineBase + 1 };
+        if (count == 0 && !this->directInput) {
+            signalSemaphores.emplace_back(pass.postCopySemaphores.at(0).handle());
+            signalValues.emplace_back(0);
+        }
+        if (this->directInput)
+            this->submitBatch.addSignal(preWaitSemaphores, waitValues,
+                signalSemaphores, signalValues);
+        else
+            this->submitBatch.add(this->preCopyBufs.at(presentIdx).at(this->frameIdx % 2),
+                preWaitSemaphores, waitValues,
+                signalSemaphores, signalValues);
+        this->submitBatch.flush(info.transferQueue.second);
+
+        // 2. render intermediary frames
+        AFMF::presentContext(*this->lsfgCtxId,
+            timelineBase + 1,
+            timelineBase + 2,
+            count);
+
+        // a frame lsfg reads in place is presented once lsfg signals its last output value,
+        // which it does right after reading the frame if it generates none
+        if (count == 0 && this->directInput) {
+            this->submitBatch.addSignal({ this->syncSemaphore.handle() }, { timelineBase + 1 + info.frameGen },
+                { pass.postCopySemaphores.at(0).handle() }, { 0 });
+            this->submitBatch.flush(info.transferQueue.second);
+        }
+    } else {
+        if (this->frameIdx > this->firstFrameIdx)
+            preWaitSemaphores.emplace_back(this->passInfos.at((this->frameIdx - 1) % this->passInfos.size())
+                .preCopySemaphores.at(1).handle());
+        std::vector<VkSemaphore> preCopySemaphores{
+            pass.preCopySemaphores.at(0).handle(),
+            pass.preCopySemaphores.at(1).handle() };
+        if (count == 0 && !this->directInput)
+            preCopySemaphores.emplace_back(pass.postCopySemaphores.at(0).handle());
+        if (this->directInput)
+            this->submitBatch.addSignal(preWaitSemaphores, {}, preCopySemaphores);
+        else
+            this->submitBatch.add(this->preCopyBufs.at(presentIdx).at(this->frameIdx % 2),
+                preWaitSemaphores, {}, preCopySemaphores);
+        this->submitBatch.flush(info.transferQueue.second);
+        transferLock.unlock(); // afmf submits from its worker
+
+        // 2. render intermediary frames
+        const int preCopySemaphoreFd = pass.preCopySemaphores.at(0).exportFd();
+        std::vector<int> renderSemaphoreFds(count);
+        for (size_t i = 0; i < count; ++i)
+            renderSemaphoreFds.at(i) = pass.renderSemaphores.at(i).exportFd();
+        // a frame lsfg reads in place is presented once lsfg has read it
+        const int readSemaphoreFd = count == 0 && this->directInput
+            ? pass.postCopySemaphores.at(0).exportFd() : -1;
+
+        AFMF::presentContext(*this->lsfgCtxId,
+            preCopySemaphoreFd,
+            renderSemaphoreFds,
+            readSemaphoreFd);
+    }
+    if (transferLock.owns_lock())
+        transferLock.unlock();
+    this->frameSubmits = this->submitBatch.getSubmitCount();
+
+    pass.count = count;
+    pass.presentIdx = presentIdx;
+    pass.frameTime = this->multiplier.getFrameTime();
+    pass.timelineBase = timelineBase;
+
+    // 3.-6. hand the rest to the present thread. the application's pNext chain is only valid
+    // during this call, so it's copied. frames with structures that can't be are presented right away.
+    VkResult res = this->presentResult.exchange(VK_SUCCESS);
+    if (this->presenter && copyPresentChain(pass.chain, pNext)) {
+        this->presenter->push(this->frameIdx % this->passInfos.size());
+    } else {
+        this->waitIdle();
+        this->postCopy(info, pass);
+        this->frameSubmits += this->copyBatch.getSubmitCount();
+        const VkResult presentRes = this->presentFrames(info, queue, pass, pNext);
+        this->frameSubmits += this->ownershipBatch.getSubmitCount();
+        if (res == VK_SUCCESS)
+            res = presentRes;
+    }
+
+    this->frameCreations = creations.getCount();
+    if (this->frameCreations > 0)
+        Log::debug("Created {} Vulkan objects while presenting frame {}",
+            this->frameCreations, this->frameIdx);
+
+    this->frameIdx++;
+    return res;
+}
+
+bool LsContext::copyPresentChain(PresentChain& chain, const void* pNext) {
+    // only the first swapchain of the application's present is presented, so only its entries are copied
+    chain.pNext = nullptr;
+    const void** link = &chain.pNext;
+    for (auto* next = static_cast<const VkBaseInStructure*>(pNext); next; next = next->pNext) {
+        switch (next->sType) {
+        case VK_STRUCTURE_TYPE_PRESENT_ID_KHR: {
+            const auto& info = *reinterpret_cast<const VkPresentIdKHR*>(next);
+            chain.presentId = info.pPresentIds ? info.pPresentIds[0] : 0;
+            chain.presentIdInfo = VkPresentIdKHR{
+                .sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR,
+                .swapchainCount = 1,
+                .pPresentIds = info.pPresentIds ? &chain.presentId : nullptr
+            };
+            *link = &chain.presentIdInfo;
+            link = &chain.presentIdInfo.pNext;
+            break;
+        }
+        case VK_STRUCTURE_TYPE_PRESENT_TIMES_INFO_GOOGLE: {
+            const auto& info = *reinterpret_cast<const VkPresentTimesInfoGOOGLE*>(next);
+            if (info.pTimes)
+                chain.presentTime = info.pTimes[0];
+            chain.presentTimesInfo = VkPresentTimesInfoGOOGLE{
+                .sType = VK_STRUCTURE_TYPE_PRESENT_TIMES_INFO_GOOGLE,
+                .swapchainCount = 1,
+                .pTimes = info.pTimes ? &chain.presentTime : nullptr
+            };
+            *link = &chain.presentTimesInfo;
+            link = &chain.presentTimesInfo.pNext;
+            break;
+        }
+        case VK_STRUCTURE_TYPE_PRESENT_REGIONS_KHR: {
+            const auto& info = *reinterpret_cast<const VkPresentRegionsKHR*>(next);
+            chain.presentRegion = {};
+            chain.rectangles.clear();
+            if (info.pRegions) {
+                chain.presentRegion = info.pRegions[0];
+                if (chain.presentRegion.pRectangles)
+                    chain.rectangles.assign(chain.presentRegion.pRectangles,
+                        std::next(chain.presentRegion.pRectangles, chain.presentRegion.rectangleCount));
+                chain.presentRegion.pRectangles = chain.rectangles.data();
+            }
+            chain.presentRegionsInfo = VkPresentRegionsKHR{
+                .sType = VK_STRUCTURE_TYPE_PRESENT_REGIONS_KHR,
+                .swapchainCount = 1,
+                .pRegions = info.pRegions ? &chain.presentRegion : nullptr
+            };
+            *link = &chain.presentRegionsInfo;
+            link = &chain.presentRegionsInfo.pNext;
+            break;
+        }
+        default:
+            return false;
+        }
+    }
+    return true;
+}
+
+void LsContext::presentPass(const Hooks::DeviceInfo& info, uint64_t passIdx) {
+    auto& pass = this->passInfos.at(passIdx);
+
+    // errors can't be thrown at the application from here, its next present returns them instead
+    const auto report = [this](VkResult error, const char* what) {
+        Log::error("Encountered Vulkan error {:x} on the present thread: {}",
+            static_cast<uint32_t>(error), what);
+        this->presentResult.store(error);
+    };
+
+    bool copied{false};
+    try {
+        this->postCopy(info, pass);
+        copied = true;
+    } catch (const AFMF::vulkan_error& e) {
+        report(e.error(), e.what());
+    } catch (const std::exception& e) {
+        report(VK_ERROR_INITIALIZATION_FAILED, e.what());
+    }
+    this->postCopies.fetch_add(1, std::memory_order_release);
+    this->postCopies.notify_one();
+    if (!copied)
+        return;
+
+    try {
+        const VkResult res = this->presentFrames(info, info.presentQueue.second, pass, pass.chain.pNext);
+        if (res != VK_SUCCESS)
+            this->presentResult.store(res);
+    } catch (const AFMF::vulkan_error& e) {
+        report(e.error(), e.what());
+    } catch (const std::exception& e) {
+        report(VK_ERROR_INITIALIZATION_FAILED, e.what());
+    }
+}
+
+void LsContext::postCopy(const Hooks::DeviceInfo& info, RenderPassInfo& pass) {
+    this->copyBatch.resetSubmitCount();
+    // lsfg signals binary semaphores from its own thread, they can't be waited on before.
+    // that includes the one of a frame read in place without generated frames.
+    if (!info.timelineSemaphores && (pass.count > 0 || this->directInput))
+        AFMF::flushContext(*this->lsfgCtxId);
+    for (size_t i = 0; i < pass.count; i++) {
+        // 3. acquire next swapchain image, unless lsfg wrote to one acquired up front
+        if (!this->directOutput) {
+            const std::lock_guard<std::mutex> lock(this->swapchainMutex);
+            auto res = info.next.acquireNextImage(info.device, this->swapchain, UINT64_MAX,
+                pass.acquireSemaphores.at(i).handle(), VK_NULL_HANDLE, &pass.acquiredImages.at(i));
+            if (res != VK_SUCCESS && res != VK_SUBOPTIMAL_KHR)
+                throw AFMF::vulkan_error(res, "Failed to acquire next swapchain image");
+        }
+
+        // 4. copy output image to swapchain image. outputs written in place only
+        // forward lsfg's semaphore, as presenting can't wait on timeline semaphores.
+        const std::vector<VkSemaphore> postCopySemaphores{
+            pass.postCopySemaphores.at(i).handle(),
+            pass.prevPostCopySemaphores.at(i).handle() };
+        std::vector<VkSemaphore> waitSemaphores;
+        if (!this->directOutput)
+            waitSemaphores.emplace_back(pass.acquireSemaphores.at(i).handle());
+        if (info.timelineSemaphores)
+            waitSemaphores.emplace_back(this->syncSemaphore.handle());
+        else
+            waitSemaphores.emplace_back(pass.renderSemaphores.at(i).handle());
+        std::vector<uint64_t> waitValues;
+        if (info.timelineSemaphores) {
+            waitValues.assign(waitSemaphores.size(), 0);
+            waitValues.back() = pass.timelineBase + 2 + i;
+        }
+        const std::vector<uint64_t> signalValues(info.timelineSemaphores ? 2 : 0, 0);
+
+        if (this->directOutput)
+            this->copyBatch.addSignal(waitSemaphores, waitValues,
+                postCopySemaphores, signalValues);
+        else
+            this->copyBatch.add(this->postCopyBufs.at(i).at(pass.acquiredImages.at(i)),
+                waitSemaphores, waitValues,
+                postCopySemaphores, signalValues);
+    }
+
+    const std::lock_guard<std::mutex> lock(*this->transferMutex);
+    this->copyBatch.flush(info.transferQueue.second, &pass.fence);
+    pass.pending = true;
+}
+
+VkResult LsContext::presentFrames(const Hooks::DeviceInfo& info, VkQueue queue,
+        RenderPassInfo& pass, const void* pNext) {
+    // learn how earlier presents went, then spread the generated
+    // frames and the real one across the real frame time
+    this->measurePresents(info, pass.frameTime);
+    const auto& times = this->pacer.schedule(pass.count, pass.frameTime);
+
+    // presents wait for the copies into (or out of) their image, in order. images owned by
+    // the presenting family are acquired back from the transfer queue first, in one submission.
+    this->ownershipBatch.resetSubmitCount();
+    this->presentWaits.resize(pass.count + 1);
+    for (size_t i = 0; i < pass.count; i++) {
+        auto& waitSemaphores = this->presentWaits.at(i);
+        waitSemaphores.assign({ pass.postCopySemaphores.at(i).handle() });
         if (i != 0) waitSemaphores.emplace_back(pass.prevPostCopySemaphores.at(i - 1).handle());
+    }
+    this->presentWaits.at(pass.count).assign({ pass.count == 0
+        ? pass.postCopySemaphores.at(0).handle()
+        : pass.prevPostCopySemaphores.at(pass.count - 1).handle() });
+    if (this->imageFamily != VK_QUEUE_FAMILY_IGNORED) {
+        for (size_t i = 0; i <= pass.count; i++) {
+            const bool real = i == pass.count;
+            const uint32_t image = real ? pass.presentIdx : pass.acquiredImages.at(i);
+            this->ownershipBatch.add(this->ownershipBufs.at(image).at(real ? 1 : 2),
+                this->presentWaits.at(i), {}, { pass.presentSemaphores.at(i).handle() });
+            this->presentWaits.at(i).assign({ pass.presentSemaphores.at(i).handle() });
+        }
+        this->ownershipBatch.flush(queue);
+    }
 
+    for (size_t i = 0; i < pass.count; i++) {
+        // 5. present swapchain image
+        const auto& waitSemaphores = this->presentWaits.at(i);
         const VkPresentInfoKHR presentInfo{
             .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
-            .pNext = i == 0 ? pNext : nullptr, // only set on first present
+            .pNext = this->pace(i, times.at(i), i == 0 ? pNext : nullptr), // only set on first present
             .waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size()),
             .pWaitSemaphores = waitSemaphores.data(),
             .swapchainCount = 1,
             .pSwapchains = &this->swapchain,
-            .pImageIndices = &imageIdx,
+            .pImageIndices = &pass.acquiredImages.at(i),
         };
-        res = vkQueuePresentKHR(queue, &presentInfo);
+        const std::lock_guard<std::mutex> lock(this->swapchainMutex);
+        auto res = info.next.queuePresent(queue, &presentInfo);
         if (res != VK_SUCCESS && res != VK_SUBOPTIMAL_KHR)
             throw AFMF::vulkan_error(res, "Failed to present swapchain image");
     }
 
     // 6. present actual next frame
-    VkSemaphore lastPrevPostCopySemaphore =
-        pass.prevPostCopySemaphores.at(info.frameGen - 1).handle();
+    const auto& waitSemaphores = this->presentWaits.at(pass.count);
     const VkPresentInfoKHR presentInfo{
         .sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
-        .waitSemaphoreCount = 1,
-        .pWaitSemaphores = &lastPrevPostCopySemaphore,
+        .pNext = this->pace(pass.count, times.at(pass.count), pass.count == 0 ? pNext : nullptr),
+        .waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size()),
+        .pWaitSemaphores = waitSemaphores.data(),
         .swapchainCount = 1,
         .pSwapchains = &this->swapchain,
-        .pImageIndices = &presentIdx,
+        .pImageIndices = &pass.presentIdx,
     };
-    auto res = vkQueuePresentKHR(queue, &presentInfo);
+    const std::lock_guard<std::mutex> lock(this->swapchainMutex);
+    auto res = info.next.queuePresent(queue, &presentInfo);
     if (res != VK_SUCCESS && res != VK_SUBOPTIMAL_KHR)
         throw AFMF::vulkan_error(res, "Failed to present swapchain image");
-
-    this->frameIdx++;
+    this->realPresentId = this->pacing == PacingMethod::PresentWait && !this->applicationIds
+        ? this->presentId : 0;
+    this->realPresentTime = times.at(pass.count);
     return res;
 }
+
+template<typename AcquireFn>
+VkResult LsContext::acquireImage(uint64_t timeout, const AcquireFn& acquire) {
+    if (!this->presenter)
+        return acquire(timeout);
+
+    const uint64_t start = steadyNow();
+    while (true) {
+        const uint64_t elapsed = steadyNow() - start;
+        const uint64_t remaining = timeout == UINT64_MAX ? timeout : timeout - std::min(timeout, elapsed);
+
+        // only the application's presenting thread hands over frames, so an idle present
+        // thread stays idle while the application blocks on an image. acquiring from another
+        // thread may race with a present handing over a frame, which is just waited on next.
+        const size_t outstanding = this->presenter->getOutstanding();
+        if (outstanding == 0) {
+            const std::lock_guard<std::mutex> lock(this->swapchainMutex);
+            return acquire(remaining);
+        }
+
+        // otherwise only take an image that's ready, and wait for a frame to be presented if none is
+        VkResult res{};
+        {
+            const std::lock_guard<std::mutex> lock(this->swapchainMutex);
+            res = acquire(0);
+        }
+        if (res != VK_NOT_READY && res != VK_TIMEOUT)
+            return res;
+        if (remaining == 0)
+            return timeout == 0 ? VK_NOT_READY : VK_TIMEOUT;
+        this->presenter->wait(outstanding - 1);
+    }
+}
+
+VkResult LsContext::acquire(const Hooks::DeviceInfo& info, uint64_t timeout,
+        VkSemaphore semaphore, VkFence fence, uint32_t* pImageIndex) {
+    return this->acquireImage(timeout, [&](uint64_t wait) {
+        return info.next.acquireNextImage(info.device, this->swapchain, wait, semaphore, fence, pImageIndex);
+    });
+}
+
+VkResult LsContext::acquire(const Hooks::DeviceInfo& info, const VkAcquireNextImageInfoKHR& acquireInfo,
+        uint32_t* pImageIndex) {
+    return this->acquireImage(acquireInfo.timeout, [&](uint64_t wait) {
+        VkAcquireNextImageInfoKHR waitInfo = acquireInfo;
+        waitInfo.timeout = wait;
+        return info.next.acquireNextImage2(info.device, &waitInfo, pImageIndex);
+    });
+}
+
+void LsContext::waitIdle() const {
+    if (this->presenter)
+        this->presenter->wait(0);
+}
+
+void LsContext::measurePresents(const Hooks::DeviceInfo& info, uint64_t frameTime) {
+    if (this->pacing == PacingMethod::DisplayTiming) {
+        // drain the timings of every present since the last call, skipping untimed ones
+        VkResult res{VK_INCOMPLETE};
+        while (res == VK_INCOMPLETE) {
+            auto timingCount = static_cast<uint32_t>(this->pastTimings.size());
+            {
+                const std::lock_guard<std::mutex> lock(this->swapchainMutex);
+                res = this->getPastPresentationTiming(info.device, this->swapchain,
+                    &timingCount, this->pastTimings.data());
+            }
+            if (res != VK_SUCCESS && res != VK_INCOMPLETE)
+                return;
+            for (uint32_t i = 0; i < timingCount; i++) {
+                const auto& timing = this->pastTimings.at(i);
+                if (timing.desiredPresentTime != 0)
+                    this->pacer.presented(timing.desiredPresentTime, timing.actualPresentTime);
+            }
+        }
+    } else if (this->pacing == PacingMethod::PresentWait && this->realPresentId != 0) {
+        // let the last real frame reach the display before queueing more frames,
+        // but never wait for longer than a real frame
+        VkResult res{};
+        {
+            const std::lock_guard<std::mutex> lock(this->swapchainMutex);
+            res = this->waitForPresent(info.device, this->swapchain, this->realPresentId, frameTime);
+        }
+        if (res == VK_SUCCESS)
+            this->pacer.presented(this->realPresentTime, this->pacer.now());
+        this->realPresentId = 0;
+    }
+}
+
+const void* LsContext::pace(size_t i, uint64_t time, const void* pNext) {
+    if (this->pacing == PacingMethod::DisplayTiming) {
+        // presents the application times itself are left alone
+        if (Utils::hasStructure(pNext, VK_STRUCTURE_TYPE_PRESENT_TIMES_INFO_GOOGLE))
+            return pNext;
+        this->presentTimes.at(i) = VkPresentTimeGOOGLE{
+            .presentID = static_cast<uint32_t>(++this->presentId),
+            .desiredPresentTime = time
+        };
+        this->presentTimesInfos.at(i) = VkPresentTimesInfoGOOGLE{
+            .sType = VK_STRUCTURE_TYPE_PRESENT_TIMES_INFO_GOOGLE,
+            .pNext = pNext,
+            .swapchainCount = 1,
+            .pTimes = &this->presentTimes.at(i)
+        };
+        return &this->presentTimesInfos.at(i);
+    }
+    if (this->pacing == PacingMethod::PresentWait) {
+        this->pacer.wait(time);
+
+        // present ids must increase, which can't be guaranteed
+        // alongside the application's own. stop adding any then.
+        if (Utils::hasStructure(pNext, VK_STRUCTURE_TYPE_PRESENT_ID_KHR))
+            this->applicationIds = true;
+        if (this->applicationIds)
+            return pNext;
+        this->presentIds.at(i) = ++this->presentId;
+        this->presentIdInfos.at(i) = VkPresentIdKHR{
+            .sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR,
+            .pNext = pNext,
+            .swapchainCount = 1,
+            .pPresentIds = &this->presentIds.at(i)
+        };
+        return &this->presentIdInfos.at(i);
+    }
+    return pNext;
+}
@@ -1,117 +1,478 @@
-#include "loader/dl.hpp"
-#include "loader/vk.hpp"
 #include "context.hpp"
 #include "hooks.hpp"
 #include "log.hpp"
+#include "registry.hpp"
 #include "utils.hpp"
 
 #include <afmf.hpp>
 
 #include <algorithm>
+#include <iterator>
+#include <memory>
+#include <optional>
 #include <string>
-#include <unordered_map>
+#include <string_view>
+#include <utility>
 
 using namespace Hooks;
 
 namespace {
 
-    // instance hooks
+    // instances and devices afmf knows, keyed by their dispatch key. looked up from any
+    // thread, changed by the application's instance, device and swapchain calls.
+    Registry<void*, InstanceInfo> instances;
+    Registry<void*, DeviceInfo> devices;
+
+    // functions of instances and devices created before afmf was loaded, which only happens
+    // when hooking the loader. the layer creates every instance and device itself.
+    const InstanceDispatch noInstanceDispatch{};
+    const DeviceDispatch noDeviceDispatch{};
+    const InstanceDispatch* loaderInstanceDispatch{&noInstanceDispatch};
+    const DeviceDispatch* loaderDeviceDispatch{&noDeviceDispatch};
+
+    // look up the functions afmf calls on an instance
+    InstanceDispatch loadInstanceDispatch(VkInstance instance, PFN_vkGetInstanceProcAddr getInstanceProcAddr) {
+        const auto getFunction = [&]<typename PFN>(PFN& function, const char* name) {
+            function = reinterpret_cast<PFN>(getInstanceProcAddr(instance, name));
+        };
+        InstanceDispatch next{ .getInstanceProcAddr = getInstanceProcAddr };
+        getFunction(next.destroyInstance, "vkDestroyInstance");
+        getFunction(next.enumerateDeviceExtensionProperties, "vkEnumerateDeviceExtensionProperties");
+        getFunction(next.getPhysicalDeviceQueueFamilyProperties, "vkGetPhysicalDeviceQueueFamilyProperties");
+        getFunction(next.getPhysicalDeviceFeatures2, "vkGetPhysicalDeviceFeatures2");
+        if (!next.getPhysicalDeviceFeatures2) // vulkan 1.0 instance
+            getFunction(next.getPhysicalDeviceFeatures2, "vkGetPhysicalDeviceFeatures2KHR");
+        getFunction(next.getPhysicalDeviceMemoryProperties, "vkGetPhysicalDeviceMemoryProperties");
+        getFunction(next.getPhysicalDeviceFormatProperties, "vkGetPhysicalDeviceFormatProperties");
+        getFunction(next.getPhysicalDeviceImageFormatProperties2, "vkGetPhysicalDeviceImageFormatProperties2");
+        if (!next.getPhysicalDeviceImageFormatProperties2) // vulkan 1.0 instance
+            getFunction(next.getPhysicalDeviceImageFormatProperties2, "vkGetPhysicalDeviceImageFormatProperties2KHR");
+        getFunction(next.getPhysicalDeviceSurfaceSupport, "vkGetPhysicalDeviceSurfaceSupportKHR");
+        getFunction(next.getPhysicalDeviceSurfaceCapabilities, "vkGetPhysicalDeviceSurfaceCapabilitiesKHR");
+        getFunction(next.getPhysicalDeviceSurfacePresentModes, "vkGetPhysicalDeviceSurfacePresentModesKHR");
+        return next;
+    }
 
-    VkResult myvkCreateInstance(
-            const VkInstanceCreateInfo* pCreateInfo,
-            const VkAllocationCallbacks* pAllocator,
-            VkInstance* pInstance) {
-        // create afmf
-        Loader::DL::disableHooks();
-        AFMF::initialize();
-        Loader::DL::enableHooks();
-
-        // add extensions
-        auto extensions = Utils::addExtensions(pCreateInfo->ppEnabledExtensionNames,
-            pCreateInfo->enabledExtensionCount, {
-                "VK_KHR_get_physical_device_properties2",
-                "VK_KHR_external_memory_capabilities",
-                "VK_KHR_external_semaphore_capabilities"
-            });
-
-        VkInstanceCreateInfo createInfo = *pCreateInfo;
-        createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
-        createInfo.ppEnabledExtensionNames = extensions.data();
-        return vkCreateInstance(&createInfo, pAllocator, pInstance);
+    // look up the functions calls on a device are passed on to, and afmf calls itself
+    DeviceDispatch loadDeviceDispatch(VkDevice device, PFN_vkGetDeviceProcAddr getDeviceProcAddr,
+            const InstanceDispatch& instance) {
+        const auto getFunction = [&]<typename PFN>(PFN& function, const char* name) {
+            function = reinterpret_cast<PFN>(getDeviceProcAddr(device, name));
+        };
+        DeviceDispatch next{ .instance = &instance, .getDeviceProcAddr = getDeviceProcAddr };
+        getFunction(next.destroyDevice, "vkDestroyDevice");
+        getFunction(next.getDeviceQueue, "vkGetDeviceQueue");
+        getFunction(next.createSwapchain, "vkCreateSwapchainKHR");
+        getFunction(next.destroySwapchain, "vkDestroySwapchainKHR");
+        getFunction(next.getSwapchainImages, "vkGetSwapchainImagesKHR");
+        getFunction(next.acquireNextImage, "vkAcquireNextImageKHR");
+        getFunction(next.acquireNextImage2, "vkAcquireNextImage2KHR");
+        getFunction(next.queuePresent, "vkQueuePresentKHR");
+
+        getFunction(next.queueSubmit, "vkQueueSubmit");
+        getFunction(next.createBuffer, "vkCreateBuffer");
+        getFunction(next.destroyBuffer, "vkDestroyBuffer");
+        getFunction(next.getBufferMemoryRequirements, "vkGetBufferMemoryRequirements");
+        getFunction(next.bindBufferMemory, "vkBindBufferMemory");
+        getFunction(next.createImage, "vkCreateImage");
+        getFunction(next.destroyImage, "vkDestroyImage");
+        getFunction(next.getImageMemoryRequirements, "vkGetImageMemoryRequirements");
+        getFunction(next.getImageMemoryRequirements2, "vkGetImageMemoryRequirements2");
+        if (!next.getImageMemoryRequirements2) // vulkan 1.0 device
+            getFunction(next.getImageMemoryRequirements2, "vkGetImageMemoryRequirements2KHR");
+        getFunction(next.bindImageMemory, "vkBindImageMemory");
+        getFunction(next.allocateMemory, "vkAllocateMemory");
+        getFunction(next.freeMemory, "vkFreeMemory");
+        getFunction(next.mapMemory, "vkMapMemory");
+        getFunction(next.getMemoryFd, "vkGetMemoryFdKHR");
+        getFunction(next.createCommandPool, "vkCreateCommandPool");
+        getFunction(next.destroyCommandPool, "vkDestroyCommandPool");
+        getFunction(next.allocateCommandBuffers, "vkAllocateCommandBuffers");
+        getFunction(next.freeCommandBuffers, "vkFreeCommandBuffers");
+        getFunction(next.beginCommandBuffer, "vkBeginCommandBuffer");
+        getFunction(next.endCommandBuffer, "vkEndCommandBuffer");
+        getFunction(next.createFence, "vkCreateFence");
+        getFunction(next.destroyFence, "vkDestroyFence");
+        getFunction(next.resetFences, "vkResetFences");
+        getFunction(next.waitForFences, "vkWaitForFences");
+        getFunction(next.createSemaphore, "vkCreateSemaphore");
+        getFunction(next.destroySemaphore, "vkDestroySemaphore");
+        getFunction(next.getSemaphoreFd, "vkGetSemaphoreFdKHR");
+        getFunction(next.importSemaphoreFd, "vkImportSemaphoreFdKHR");
+        getFunction(next.waitSemaphores, "vkWaitSemaphoresKHR");
+        getFunction(next.signalSemaphore, "vkSignalSemaphoreKHR");
+
+        getFunction(next.cmdPipelineBarrier, "vkCmdPipelineBarrier");
+        getFunction(next.cmdCopyImage, "vkCmdCopyImage");
+        getFunction(next.cmdCopyImageToBuffer, "vkCmdCopyImageToBuffer");
+        getFunction(next.cmdCopyBufferToImage, "vkCmdCopyBufferToImage");
+        return next;
     }
 
-    void myvkDestroyInstance(
-            VkInstance instance,
-            const VkAllocationCallbacks* pAllocator) {
-        AFMF::finalize(); // destroy afmf
-        vkDestroyInstance(instance, pAllocator);
+}
+
+// instance hooks
+
+VkResult Hooks::createInstance(
+        const VkInstanceCreateInfo* pCreateInfo,
+        const VkAllocationCallbacks* pAllocator,
+        VkInstance* pInstance,
+        PFN_vkCreateInstance createInstance,
+        PFN_vkGetInstanceProcAddr getInstanceProcAddr) {
+    // add extensions
+    auto extensions = Utils::addExtensions(pCreateInfo->ppEnabledExtensionNames,
+        pCreateInfo->enabledExtensionCount, {
+            "VK_KHR_get_physical_device_properties2",
+            "VK_KHR_external_memory_capabilities",
+            "VK_KHR_external_semaphore_capabilities"
+        });
+
+    VkInstanceCreateInfo createInfo = *pCreateInfo;
+    createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+    createInfo.ppEnabledExtensionNames = extensions.data();
+    auto res = createInstance(&createInfo, pAllocator, pInstance);
+    if (res != VK_SUCCESS)
+        return res;
+
+    // store instance info
+    instances.insert(dispatchKey(*pInstance), std::make_unique<InstanceInfo>(InstanceInfo {
+        .instance = *pInstance,
+        .next = loadInstanceDispatch(*pInstance, getInstanceProcAddr)
+    }));
+    return res;
+}
+
+void Hooks::destroyInstance(VkInstance instance, const VkAllocationCallbacks* pAllocator) {
+    if (!instance)
+        return;
+    const auto* info = findInstance(instance);
+    const auto destroy = info ? info->next.destroyInstance : loaderInstanceDispatch->destroyInstance;
+    instances.erase(dispatchKey(instance)); // erase instance info
+    destroy(instance, pAllocator);
+}
+
+const InstanceInfo* Hooks::findInstance(void* handle) {
+    return instances.find(dispatchKey(handle));
+}
+
+// device hooks
+
+VkResult Hooks::createDevice(
+        VkPhysicalDevice physicalDevice,
+        const VkDeviceCreateInfo* pCreateInfo,
+        const VkAllocationCallbacks* pAllocator,
+        VkDevice* pDevice,
+        PFN_vkCreateDevice createDevice,
+        PFN_vkGetDeviceProcAddr getDeviceProcAddr,
+        PFN_vkSetDeviceLoaderData setLoaderData) {
+    // physical devices are queried through the functions of their instance
+    const auto* instanceInfo = findInstance(physicalDevice);
+    const InstanceDispatch& vk = instanceInfo ? instanceInfo->next : *loaderInstanceDispatch;
+
+    // use timeline semaphores unless unsupported or disabled
+    const char* timelineEnv = std::getenv("AFMF_TIMELINE_SEMAPHORES");
+    bool timeline = (!timelineEnv || std::string_view(timelineEnv) != "0")
+        && Utils::supportsTimelineSemaphores(vk, physicalDevice);
+
+    // add extensions
+    std::vector<const char*> requiredExtensions{
+        "VK_KHR_external_memory",
+        "VK_KHR_external_memory_fd",
+        "VK_KHR_external_semaphore",
+        "VK_KHR_external_semaphore_fd",
+        "VK_KHR_get_memory_requirements2",
+        "VK_KHR_dedicated_allocation"
+    };
+    if (timeline)
+        requiredExtensions.emplace_back("VK_KHR_timeline_semaphore");
+
+    // request a queue on a transfer-only family for copies, so they don't queue up behind
+    // the application's rendering. without one, an async compute family can copy as well.
+    VkDeviceCreateInfo createInfo = *pCreateInfo;
+    const char* dedicatedEnv = std::getenv("AFMF_DEDICATED_QUEUES");
+    std::optional<uint32_t> transferFamily;
+    if (!dedicatedEnv || std::string_view(dedicatedEnv) != "0") {
+        transferFamily = Utils::findQueueFamily(vk, physicalDevice, VK_QUEUE_TRANSFER_BIT,
+            VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT);
+        if (!transferFamily.has_value())
+            transferFamily = Utils::findQueueFamily(vk, physicalDevice, VK_QUEUE_COMPUTE_BIT,
+                VK_QUEUE_GRAPHICS_BIT);
     }
+    std::vector<VkDeviceQueueCreateInfo> queueInfos;
+    std::vector<float> transferPriorities;
+    std::optional<uint32_t> transferQueueIdx;
+    if (transferFamily.has_value())
+        transferQueueIdx = Utils::requestQueue(vk, &createInfo, physicalDevice,
+            *transferFamily, queueInfos, transferPriorities);
+
+    // present generated frames from a thread of afmf's own. it submits copies and presents
+    // concurrently with the application, so only on queues the application doesn't use.
+    const char* presentThreadEnv = std::getenv("AFMF_PRESENT_THREAD");
+    const auto presentFamily = Utils::findEnabledQueueFamily(vk, physicalDevice, pCreateInfo,
+        VK_QUEUE_GRAPHICS_BIT);
+    std::vector<float> presentPriorities;
+    std::optional<uint32_t> presentQueueIdx;
+    if ((!presentThreadEnv || std::string_view(presentThreadEnv) != "0")
+            && transferQueueIdx.has_value() && presentFamily.has_value())
+        presentQueueIdx = Utils::requestQueue(vk, &createInfo, physicalDevice,
+            *presentFamily, queueInfos, presentPriorities);
+
+    // pace presents through display timing where supported. waiting for presents
+    // blocks the presenting thread, so it's only picked by itself with a present thread.
+    const char* pacingEnv = std::getenv("AFMF_PACING");
+    const std::string_view pacingName = pacingEnv ? pacingEnv : "auto";
+    PacingMethod pacing = PacingMethod::None;
+    if ((pacingName == "auto" || pacingName == "timing")
+            && Utils::supportsDisplayTiming(vk, physicalDevice)) {
+        pacing = PacingMethod::DisplayTiming;
+        requiredExtensions.emplace_back("VK_GOOGLE_display_timing");
+    } else if ((pacingName == "wait" || (pacingName == "auto" && presentQueueIdx.has_value()))
+            && Utils::supportsPresentWait(vk, physicalDevice)) {
+        pacing = PacingMethod::PresentWait;
+        requiredExtensions.emplace_back("VK_KHR_present_id");
+        requiredExtensions.emplace_back("VK_KHR_present_wait");
+    } else if (pacingName == "timing" || pacingName == "wait") {
+        Log::warn("Frame pacing through {} is not supported, presenting frames back to back",
+            pacingName);
+    }
+    auto extensions = Utils::addExtensions(pCreateInfo->ppEnabledExtensionNames,
+        pCreateInfo->enabledExtensionCount, requiredExtensions);
 
-    // device hooks
+    createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+    createInfo.ppEnabledExtensionNames = extensions.data();
 
-    std::unordered_map<VkDevice, DeviceInfo> devices;
+    // features are enabled in copies of the application's structures, if it requests them itself
+    Utils::StructureStorage structures;
+    if (timeline && !Utils::enableTimelineSemaphores(&createInfo, structures)) {
+        Log::warn("Can't enable timeline semaphores alongside the application's features, using binary semaphores");
+        timeline = false;
+    }
+    if (pacing == PacingMethod::PresentWait && !Utils::enablePresentWait(&createInfo, structures)) {
+        Log::warn("Can't enable present wait alongside the application's features, presenting frames back to back");
+        pacing = PacingMethod::None;
+    }
 
-    VkResult myvkCreateDevice(
-            VkPhysicalDevice physicalDevice,
-            const VkDeviceCreateInfo* pCreateInfo,
-            const VkAllocationCallbacks* pAllocator,
-            VkDevice* pDevice) {
-        // add extensions
-        auto extensions = Utils::addExtensions(pCreateInfo->ppEnabledExtensionNames,
-            pCreateInfo->enabledExtensionCount, {
-                "VK_KHR_external_memory",
-                "VK_KHR_external_memory_fd",
-                "VK_KHR_external_semaphore",
-                "VK_KHR_external_semaphore_fd"
-            });
-
-        VkDeviceCreateInfo createInfo = *pCreateInfo;
-        createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
-        createInfo.ppEnabledExtensionNames = extensions.data();
-        auto res = vkCreateDevice(physicalDevice, &createInfo, pAllocator, pDevice);
-
-        // store device info
-        try {
-            const char* frameGen = std::getenv("AFMF_MULTIPLIER");
-            if (!frameGen) frameGen = "2";
-            devices.emplace(*pDevice, DeviceInfo {
-                .device = *pDevice,
-                .physicalDevice = physicalDevice,
-                .queue = Utils::findQueue(*pDevice, physicalDevice, &createInfo,
-                    VK_QUEUE_GRAPHICS_BIT),
-                .frameGen = std::max<size_t>(1, std::stoul(frameGen) - 1)
-            });
-        } catch (const std::exception& e) {
-            Log::error("Failed to create device info: {}", e.what());
-            return VK_ERROR_INITIALIZATION_FAILED;
-        }
+    auto res = createDevice(physicalDevice, &createInfo, pAllocator, pDevice);
+    if (res != VK_SUCCESS)
         return res;
+
+    // look up the functions calls are passed on to
+    const DeviceDispatch next = loadDeviceDispatch(*pDevice, getDeviceProcAddr, vk);
+
+    // store device info
+    try {
+        // queues retrieved from the next layer are set up for the loader, afmf submits to them
+        const auto getQueue = [&](uint32_t family, uint32_t index) {
+            VkQueue queue{};
+            next.getDeviceQueue(*pDevice, family, index, &queue);
+            if (setLoaderData && setLoaderData(*pDevice, queue) != VK_SUCCESS)
+                throw AFMF::vulkan_error(VK_ERROR_INITIALIZATION_FAILED,
+                    "Failed to set up queue for the loader");
+            return queue;
+        };
+
+        const char* frameGen = std::getenv("AFMF_MULTIPLIER");
+        if (!frameGen) frameGen = "2";
+        const char* refreshRate = std::getenv("AFMF_REFRESH_RATE");
+        if (!refreshRate) refreshRate = "0";
+        const char* presentMode = std::getenv("AFMF_PRESENT_MODE");
+        if (!presentMode) presentMode = "fifo";
+        const char* framesInFlight = std::getenv("AFMF_FRAMES_IN_FLIGHT");
+        if (!framesInFlight) framesInFlight = "2";
+        const char* backpressure = std::getenv("AFMF_BACKPRESSURE");
+        if (!backpressure) backpressure = "wait";
+        const char* zeroCopy = std::getenv("AFMF_ZERO_COPY");
+        if (!zeroCopy) zeroCopy = "1";
+        const char* blockSize = std::getenv("AFMF_BLOCK_SIZE");
+        if (!blockSize) blockSize = "16";
+        const char* searchRange = std::getenv("AFMF_SEARCH_RANGE");
+        if (!searchRange) searchRange = "32";
+        const char* motionScale = std::getenv("AFMF_MOTION_SCALE");
+        if (!motionScale) motionScale = "1";
+        const char* sceneDetection = std::getenv("AFMF_SCENE_DETECTION");
+        if (!sceneDetection) sceneDetection = "1";
+        const char* threads = std::getenv("AFMF_THREADS");
+        if (!threads) threads = "0";
+        const char* tileSize = std::getenv("AFMF_TILE_SIZE");
+        if (!tileSize) tileSize = "128";
+
+        const auto graphicsFamily = Utils::findEnabledQueueFamily(vk, physicalDevice, &createInfo,
+            VK_QUEUE_GRAPHICS_BIT);
+        if (!graphicsFamily.has_value())
+            throw AFMF::vulkan_error(VK_ERROR_INITIALIZATION_FAILED, "No suitable queue found");
+        const std::pair<uint32_t, VkQueue> graphicsQueue{ *graphicsFamily, getQueue(*graphicsFamily, 0) };
+        auto transferQueue = graphicsQueue;
+        if (transferFamily.has_value()) {
+            transferQueue = { *transferFamily, getQueue(*transferFamily, transferQueueIdx.value_or(0)) };
+            Log::info("Using dedicated queue family {} for copies", *transferFamily);
+        }
+        std::pair<uint32_t, VkQueue> presentQueue{};
+        if (presentQueueIdx.has_value()) {
+            presentQueue = { *presentFamily, getQueue(*presentFamily, *presentQueueIdx) };
+            Log::info("Presenting generated frames from a thread on queue family {}",
+                *presentFamily);
+        }
+
+        std::vector<VkDeviceQueueCreateInfo> enabledQueues(createInfo.queueCreateInfoCount);
+        std::copy_n(createInfo.pQueueCreateInfos, enabledQueues.size(), enabledQueues.data());
+        std::vector<uint32_t> queueFamilies;
+        for (const auto& queueInfo : enabledQueues)
+            queueFamilies.push_back(queueInfo.queueFamilyIndex);
+
+        devices.insert(dispatchKey(*pDevice), std::make_unique<DeviceInfo>(DeviceInfo {
+            .device = *pDevice,
+            .physicalDevice = physicalDevice,
+            .next = next,
+            .queue = graphicsQueue,
+            .transferQueue = transferQueue,
+            .transferMutex = std::make_shared<std::mutex>(),
+            .presentQueue = presentQueue,
+            .queueFamilies = queueFamilies,
+            .frameGen = std::max<size_t>(1, std::stoul(frameGen) - 1),
+            .refreshRate = static_cast<uint32_t>(std::stoul(refreshRate)),
+            .pacing = pacing,
+            .presentMode = std::string_view(presentMode) == "mailbox" ? VK_PRESENT_MODE_MAILBOX_KHR
+                : std::string_view(presentMode) == "immediate" ? VK_PRESENT_MODE_IMMEDIATE_KHR
+                : VK_PRESENT_MODE_FIFO_KHR,
+            .framesInFlight = std::max<uint32_t>(1,
+                static_cast<uint32_t>(std::stoul(framesInFlight))),
+            .skipWhenFull = std::string_view(backpressure) == "skip",
+            .timelineSemaphores = timeline,
+            .zeroCopy = std::string_view(zeroCopy) != "0",
+            .blockSize = static_cast<uint32_t>(std::stoul(blockSize)),
+            .searchRange = static_cast<uint32_t>(std::stoul(searchRange)),
+            .motionScale = static_cast<uint32_t>(std::stoul(motionScale)),
+            .sceneDetection = std::string_view(sceneDetection) != "0",
+            .threads = static_cast<uint32_t>(std::stoul(threads)),
+            .tileSize = std::max<uint32_t>(1, static_cast<uint32_t>(std::stoul(tileSize)))
+        }));
+    } catch (const std::exception& e) {
+        // calls on the device couldn't be passed on, so it mustn't outlive this call
+        Log::error("Failed to create device info: {}", e.what());
+        next.destroyDevice(*pDevice, pAllocator);
+        return VK_ERROR_INITIALIZATION_FAILED;
     }
+    return res;
+}
+
+namespace {
 
     void myvkDestroyDevice(VkDevice device, const VkAllocationCallbacks* pAllocator) {
-        devices.erase(device); // erase device info
-        vkDestroyDevice(device, pAllocator);
+        const auto destroyDevice = next(device).destroyDevice;
+        devices.erase(dispatchKey(device)); // erase device info
+        destroyDevice(device, pAllocator);
     }
 
     // swapchain hooks
 
-    std::unordered_map<VkSwapchainKHR, LsContext> swapchains;
-    std::unordered_map<VkSwapchainKHR, VkDevice> swapchainToDeviceTable;
+    /// Swapchain state, found by presenting in a single lookup.
+    struct SwapchainInfo {
+        DeviceInfo& device; // device the swapchain belongs to, outlives it
+        LsContext context;
+
+        template<typename... Args>
+        explicit SwapchainInfo(DeviceInfo& device, Args&&... args)
+            : device(device), context(device, std::forward<Args>(args)...) {}
+    };
+    Registry<VkSwapchainKHR, SwapchainInfo> swapchains;
 
     VkResult myvkCreateSwapchainKHR(
             VkDevice device,
             const VkSwapchainCreateInfoKHR* pCreateInfo,
             const VkAllocationCallbacks* pAllocator,
             VkSwapchainKHR* pSwapchain) {
-        auto& deviceInfo = devices.at(device);
+        auto* info = devices.find(dispatchKey(device));
+        if (!info) // device created before afmf was loaded
+            return next(device).createSwapchain(device, pCreateInfo, pAllocator, pSwapchain);
+        auto& deviceInfo = *info;
+
+        // leave swapchains afmf can't interpolate untouched
+        if (!AFMF::supportsFormat(pCreateInfo->imageFormat)) {
+            Log::warn("Swapchain format {} is not supported, frame generation disabled",
+                static_cast<int>(pCreateInfo->imageFormat));
+            return deviceInfo.next.createSwapchain(device, pCreateInfo, pAllocator, pSwapchain);
+        }
+
+        // present from a thread if the device has a queue for it that reaches the surface
+        bool presentThread = deviceInfo.presentQueue.second != VK_NULL_HANDLE
+            && Utils::supportsPresentQueue(*deviceInfo.next.instance, deviceInfo.physicalDevice,
+                deviceInfo.presentQueue.first, pCreateInfo->surface);
+
+        // the present thread may hold back a real frame per frame in flight, on top of the
+        // generated frames. if the surface can't have that many images, fewer frames are
+        // held back, and with a single one they're presented right away instead.
+        uint32_t framesInFlight = deviceInfo.framesInFlight;
+        const auto frameGen = static_cast<uint32_t>(deviceInfo.frameGen);
+        const uint32_t maxImageCount = Utils::getMaxImageCount(*deviceInfo.next.instance,
+            deviceInfo.physicalDevice, pCreateInfo->surface);
+        if (presentThread && maxImageCount != 0) {
+            const uint32_t spare = maxImageCount - std::min(maxImageCount, pCreateInfo->minImageCount + frameGen);
+            if (spare < 2) {
+                Log::warn("Surface allows at most {} images, presenting without a thread", maxImageCount);
+                presentThread = false;
+            } else if (spare < framesInFlight) {
+                Log::warn("Surface allows at most {} images, keeping {} frames in flight", maxImageCount, spare);
+                framesInFlight = spare;
+            }
+        }
 
         // update swapchain create info
         VkSwapchainCreateInfoKHR createInfo = *pCreateInfo;
-        createInfo.minImageCount += 1 + deviceInfo.frameGen; // 1 deferred + N framegen, FIXME: check hardware max
+        createInfo.minImageCount += (presentThread ? framesInFlight : 1) + frameGen; // deferred + N framegen
+        if (maxImageCount != 0 && createInfo.minImageCount > maxImageCount) {
+            Log::warn("Surface allows at most {} images, generated frames may wait for images", maxImageCount);
+            createInfo.minImageCount = maxImageCount;
+        }
         createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT; // allow copy from/to images
         createInfo.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
-        createInfo.presentMode = VK_PRESENT_MODE_FIFO_KHR; // force vsync
-        auto res = vkCreateSwapchainKHR(device, &createInfo, pAllocator, pSwapchain);
+
+        // generated frames are presented in bursts, so only modes the pacer can
+        // spread them out in are used. fifo is always supported.
+        createInfo.presentMode = deviceInfo.presentMode;
+        if (createInfo.presentMode != VK_PRESENT_MODE_FIFO_KHR
+                && !Utils::supportsPresentMode(*deviceInfo.next.instance, deviceInfo.physicalDevice,
+                    createInfo.surface, createInfo.presentMode)) {
+            Log::warn("Present mode {} is not supported, using vsync",
+                static_cast<int>(createInfo.presentMode));
+            createInfo.presentMode = VK_PRESENT_MODE_FIFO_KHR;
+        }
+
+        // let afmf read the presented images in place instead of copying them. skipping
+        // frames under backpressure would leave afmf reading an image the game may reuse.
+        const bool directInput = deviceInfo.zeroCopy && !deviceInfo.skipWhenFull
+            && Utils::supportsSwapchainUsage(*deviceInfo.next.instance, deviceInfo.physicalDevice,
+                createInfo.surface, createInfo.imageFormat,
+                VK_IMAGE_USAGE_SAMPLED_BIT, VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
+        if (directInput)
+            createInfo.imageUsage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+
+        // let afmf write generated frames straight into the acquired images. they're copied
+        // in with vkCmdCopyBufferToImage, so the transfer usage requested above is enough.
+        // those images are acquired before afmf is handed the frame, which would block the
+        // application on the present thread, so with one they're copied into instead.
+        const bool directOutput = directInput && !presentThread;
+
+        // keep the application's sharing mode, which may let the driver compress the images.
+        // concurrent images are shared with the transfer queue's family too, exclusive ones
+        // are handed over to it and back around every copy, see LsContext.
+        std::vector<uint32_t> sharedFamilies;
+        const bool exclusive = createInfo.imageSharingMode == VK_SHARING_MODE_EXCLUSIVE;
+        if (!exclusive) {
+            sharedFamilies.assign(createInfo.pQueueFamilyIndices,
+                std::next(createInfo.pQueueFamilyIndices, createInfo.queueFamilyIndexCount));
+            for (const auto family : deviceInfo.queueFamilies)
+                if (std::ranges::find(sharedFamilies, family) == sharedFamilies.end())
+                    sharedFamilies.push_back(family);
+
+            createInfo.queueFamilyIndexCount = static_cast<uint32_t>(sharedFamilies.size());
+            createInfo.pQueueFamilyIndices = sharedFamilies.data();
+        }
+        // the retired swapchain is handed to the driver, so its present thread must be done with it
+        const auto* oldSwapchain = swapchains.find(pCreateInfo->oldSwapchain);
+        if (oldSwapchain)
+            oldSwapchain->context.waitIdle();
+
+        auto res = deviceInfo.next.createSwapchain(device, &createInfo, pAllocator, pSwapchain);
         if (res != VK_SUCCESS) {
             Log::error("Failed to create swapchain: {:x}", static_cast<uint32_t>(res));
             return res;
@@ -120,23 +481,28 @@ namespace {
         try {
             // get swapchain images
             uint32_t imageCount{};
-            res = vkGetSwapchainImagesKHR(device, *pSwapchain, &imageCount, nullptr);
+            res = deviceInfo.next.getSwapchainImages(device, *pSwapchain, &imageCount, nullptr);
             if (res != VK_SUCCESS || imageCount == 0)
                 throw AFMF::vulkan_error(res, "Failed to get swapchain images count");
 
             std::vector<VkImage> swapchainImages(imageCount);
-            res = vkGetSwapchainImagesKHR(device, *pSwapchain, &imageCount, swapchainImages.data());
+            res = deviceInfo.next.getSwapchainImages(device, *pSwapchain, &imageCount, swapchainImages.data());
             if (res != VK_SUCCESS)
                 throw AFMF::vulkan_error(res, "Failed to get swapchain images");
 
-            // create swapchain context
-            swapchains.emplace(*pSwapchain, LsContext(
+            // create swapchain context, reusing the retired swapchain's resources if possible.
+            // it's created in place, as its present thread refers to it.
+            swapchains.insert(*pSwapchain, std::make_unique<SwapchainInfo>(
                 deviceInfo, *pSwapchain, pCreateInfo->imageExtent,
-                swapchainImages
+                pCreateInfo->imageFormat, swapchainImages, framesInFlight, directInput, directOutput, presentThread, exclusive,
+                oldSwapchain ? &oldSwapchain->context : nullptr
             ));
 
-            swapchainToDeviceTable.emplace(*pSwapchain, device);
-            Log::debug("Created swapchain with {} images", imageCount);
+            Log::debug("Created swapchain with {} images in present mode {}{}{}{}", imageCount,
+                static_cast<int>(createInfo.presentMode),
+                directInput ? ", read in place" : "",
+                directOutput ? ", written in place" : "",
+                presentThread ? ", presented from a thread" : "");
         } catch (const AFMF::vulkan_error& e) {
             Log::error("Encountered Vulkan error {:x} while creating swapchain: {}",
                 static_cast<uint32_t>(e.error()), e.what());
@@ -152,15 +518,16 @@ namespace {
     VkResult myvkQueuePresentKHR(
             VkQueue queue,
             const VkPresentInfoKHR* pPresentInfo) {
-        auto& deviceInfo = devices.at(swapchainToDeviceTable.at(*pPresentInfo->pSwapchains));
-        auto& swapchain = swapchains.at(*pPresentInfo->pSwapchains);
+        auto* swapchain = swapchains.find(*pPresentInfo->pSwapchains);
+        if (!swapchain) // frame generation disabled
+            return next(queue).queuePresent(queue, pPresentInfo);
 
         try {
             std::vector<VkSemaphore> waitSemaphores(pPresentInfo->waitSemaphoreCount);
             std::copy_n(pPresentInfo->pWaitSemaphores, static_cast<std::ptrdiff_t>(waitSemaphores.size()), waitSemaphores.data());
 
             // present the next frame
-            return swapchain.present(deviceInfo, pPresentInfo->pNext,
+            return swapchain->context.present(swapchain->device, pPresentInfo->pNext,
                 queue, waitSemaphores, *pPresentInfo->pImageIndices);
         } catch (const AFMF::vulkan_error& e) {
             Log::error("Encountered Vulkan error {:x} while presenting: {}",
@@ -172,47 +539,62 @@ namespace {
         }
     }
 
-    void myvkDestroySwapchainKHR(
+    VkResult myvkAcquireNextImageKHR(
             VkDevice device,
             VkSwapchainKHR swapchain,
-            const VkAllocationCallbacks* pAllocator) {
-        swapchains.erase(swapchain); // erase swapchain context
-        swapchainToDeviceTable.erase(swapchain);
-        vkDestroySwapchainKHR(device, swapchain, pAllocator);
+            uint64_t timeout,
+            VkSemaphore semaphore,
+            VkFence fence,
+            uint32_t* pImageIndex) {
+        auto* info = swapchains.find(swapchain);
+        if (!info) // frame generation disabled
+            return next(device).acquireNextImage(device, swapchain, timeout, semaphore, fence, pImageIndex);
+
+        // the present thread may be using the swapchain at the same time
+        return info->context.acquire(info->device, timeout, semaphore, fence, pImageIndex);
     }
 
-    bool initialized{false};
-}
-
-void Hooks::initialize() {
-    if (initialized) {
-        Log::warn("Vulkan hooks already initialized, did you call it twice?");
-        return;
+    VkResult myvkAcquireNextImage2KHR(
+            VkDevice device,
+            const VkAcquireNextImageInfoKHR* pAcquireInfo,
+            uint32_t* pImageIndex) {
+        auto* info = swapchains.find(pAcquireInfo->swapchain);
+        if (!info) // frame generation disabled
+            return next(device).acquireNextImage2(device, pAcquireInfo, pImageIndex);
+
+        // the present thread may be using the swapchain at the same time
+        return info->context.acquire(info->device, *pAcquireInfo, pImageIndex);
     }
 
-    // list of hooks to register
-    const std::vector<std::pair<std::string, void*>> hooks = {
-        { "vkCreateInstance",      reinterpret_cast<void*>(myvkCreateInstance) },
-        { "vkDestroyInstance",     reinterpret_cast<void*>(myvkDestroyInstance) },
-        { "vkCreateDevice",        reinterpret_cast<void*>(myvkCreateDevice) },
-        { "vkDestroyDevice",       reinterpret_cast<void*>(myvkDestroyDevice) },
-        { "vkCreateSwapchainKHR",  reinterpret_cast<void*>(myvkCreateSwapchainKHR) },
-        { "vkQueuePresentKHR",     reinterpret_cast<void*>(myvkQueuePresentKHR) },
-        { "vkDestroySwapchainKHR", reinterpret_cast<void*>(myvkDestroySwapchainKHR) }
-    };
+    void myvkDestroySwapchainKHR(
+            VkDevice device,
+            VkSwapchainKHR swapchain,
+            const VkAllocationCallbacks* pAllocator) {
+        const auto* info = swapchains.find(swapchain);
+        if (info)
+            Log::debug("Spent {}us per frame presenting on the application's thread, {}us at most",
+                info->context.getHookTime() / 1000, info->context.getMaxHookTime() / 1000);
+        swapchains.erase(swapchain); // erase swapchain context, stopping its present thread
+        next(device).destroySwapchain(device, swapchain, pAllocator);
+    }
 
-    // register hooks to Vulkan loader
-    for (const auto& hook : hooks)
-        Loader::VK::registerSymbol(hook.first, hook.second);
+}
 
-    // register hooks to dynamic loader under libvulkan.so.1 and libvulkan.so
-    for (const char* libName : {"libvulkan.so.1", "libvulkan.so"}) {
-        Loader::DL::File vkLib(libName);
-        for (const auto& hook : hooks)
-            vkLib.defineSymbol(hook.first, hook.second);
-        Loader::DL::registerFile(vkLib);
-    }
+const DeviceDispatch& Hooks::next(void* handle) {
+    const auto* info = devices.find(dispatchKey(handle));
+    return info ? info->next : *loaderDeviceDispatch;
+}
 
-    initialized = true;
-    Log::info("Vulkan hooks initialized successfully");
+void Hooks::setLoaderDispatch(const InstanceDispatch& instance, const DeviceDispatch& device) {
+    loaderInstanceDispatch = &instance;
+    loaderDeviceDispatch = &device;
 }
+
+const std::array<Hook, 6> Hooks::deviceHooks{{
+    { "vkDestroyDevice",        reinterpret_cast<PFN_vkVoidFunction>(myvkDestroyDevice) },
+    { "vkCreateSwapchainKHR",   reinterpret_cast<PFN_vkVoidFunction>(myvkCreateSwapchainKHR) },
+    { "vkAcquireNextImageKHR",  reinterpret_cast<PFN_vkVoidFunction>(myvkAcquireNextImageKHR) },
+    { "vkAcquireNextImage2KHR", reinterpret_cast<PFN_vkVoidFunction>(myvkAcquireNextImage2KHR) },
+    { "vkQueuePresentKHR",      reinterpret_cast<PFN_vkVoidFunction>(myvkQueuePresentKHR) },
+    { "vkDestroySwapchainKHR",  reinterpret_cast<PFN_vkVoidFunction>(myvkDestroySwapchainKHR) }
+}};
@@ -0,0 +1,141 @@
+#include "layer.hpp"
+#include "hooks.hpp"
+#include "log.hpp"
+
+#include <afmf.hpp>
+
+#include <algorithm>
+#include <array>
+#include <string_view>
+
+namespace {
+
+    // find a structure the loader chained into a create info for a layer function
+    template<typename LoaderInfo>
+    LoaderInfo* findLoaderInfo(const void* pNext, VkStructureType sType, VkLayerFunction function) {
+        auto* info = static_cast<LoaderInfo*>(const_cast<void*>(pNext));
+        while (info && (info->sType != sType || info->function != function))
+            info = static_cast<LoaderInfo*>(const_cast<void*>(info->pNext));
+        return info;
+    }
+
+    PFN_vkVoidFunction myvkGetInstanceProcAddr(VkInstance instance, const char* pName);
+    PFN_vkVoidFunction myvkGetDeviceProcAddr(VkDevice device, const char* pName);
+
+    // instance hooks
+
+    VkResult myvkCreateInstance(
+            const VkInstanceCreateInfo* pCreateInfo,
+            const VkAllocationCallbacks* pAllocator,
+            VkInstance* pInstance) {
+        auto* layerInfo = findLoaderInfo<VkLayerInstanceCreateInfo>(pCreateInfo->pNext,
+            VK_STRUCTURE_TYPE_LOADER_INSTANCE_CREATE_INFO, VK_LAYER_LINK_INFO);
+        if (!layerInfo || !layerInfo->u.pLayerInfo)
+            return VK_ERROR_INITIALIZATION_FAILED;
+        const auto getInstanceProcAddr = layerInfo->u.pLayerInfo->pfnNextGetInstanceProcAddr;
+        const auto createInstance = reinterpret_cast<PFN_vkCreateInstance>(
+            getInstanceProcAddr(VK_NULL_HANDLE, "vkCreateInstance"));
+        if (!createInstance)
+            return VK_ERROR_INITIALIZATION_FAILED;
+        layerInfo->u.pLayerInfo = layerInfo->u.pLayerInfo->pNext; // hand the chain on to the next layer
+
+        AFMF::initialize(); // create afmf, once per instance
+
+        auto res = Hooks::createInstance(pCreateInfo, pAllocator, pInstance,
+            createInstance, getInstanceProcAddr);
+        if (res != VK_SUCCESS)
+            AFMF::finalize(); // destroyed with the instance otherwise
+        return res;
+    }
+
+    void myvkDestroyInstance(
+            VkInstance instance,
+            const VkAllocationCallbacks* pAllocator) {
+        if (!Hooks::findInstance(instance))
+            return;
+
+        AFMF::finalize(); // destroy afmf
+        Hooks::destroyInstance(instance, pAllocator);
+    }
+
+    VkResult myvkCreateDevice(
+            VkPhysicalDevice physicalDevice,
+            const VkDeviceCreateInfo* pCreateInfo,
+            const VkAllocationCallbacks* pAllocator,
+            VkDevice* pDevice) {
+        auto* layerInfo = findLoaderInfo<VkLayerDeviceCreateInfo>(pCreateInfo->pNext,
+            VK_STRUCTURE_TYPE_LOADER_DEVICE_CREATE_INFO, VK_LAYER_LINK_INFO);
+        const auto* loaderData = findLoaderInfo<VkLayerDeviceCreateInfo>(pCreateInfo->pNext,
+            VK_STRUCTURE_TYPE_LOADER_DEVICE_CREATE_INFO, VK_LOADER_DATA_CALLBACK);
+        const auto* instance = Hooks::findInstance(physicalDevice); // shares the instance's key
+        if (!layerInfo || !layerInfo->u.pLayerInfo || !loaderData || !instance)
+            return VK_ERROR_INITIALIZATION_FAILED;
+        const auto getDeviceProcAddr = layerInfo->u.pLayerInfo->pfnNextGetDeviceProcAddr;
+        const auto createDevice = reinterpret_cast<PFN_vkCreateDevice>(
+            layerInfo->u.pLayerInfo->pfnNextGetInstanceProcAddr(instance->instance, "vkCreateDevice"));
+        if (!createDevice)
+            return VK_ERROR_INITIALIZATION_FAILED;
+        layerInfo->u.pLayerInfo = layerInfo->u.pLayerInfo->pNext; // hand the chain on to the next layer
+
+        return Hooks::createDevice(physicalDevice, pCreateInfo, pAllocator, pDevice,
+            createDevice, getDeviceProcAddr, loaderData->u.pfnSetDeviceLoaderData);
+    }
+
+    // functions the layer looks up itself, device functions are in Hooks::deviceHooks
+    const std::array<Hooks::Hook, 5> instanceHooks{{
+        { "vkGetInstanceProcAddr", reinterpret_cast<PFN_vkVoidFunction>(myvkGetInstanceProcAddr) },
+        { "vkGetDeviceProcAddr",   reinterpret_cast<PFN_vkVoidFunction>(myvkGetDeviceProcAddr) },
+        { "vkCreateInstance",      reinterpret_cast<PFN_vkVoidFunction>(myvkCreateInstance) },
+        { "vkDestroyInstance",     reinterpret_cast<PFN_vkVoidFunction>(myvkDestroyInstance) },
+        { "vkCreateDevice",        reinterpret_cast<PFN_vkVoidFunction>(myvkCreateDevice) }
+    }};
+
+    // find the hook of a function, or nullptr if it isn't hooked
+    template<size_t N>
+    PFN_vkVoidFunction findHook(const std::array<Hooks::Hook, N>& hooks, const char* pName) {
+        const auto it = std::ranges::find(hooks, std::string_view(pName), &Hooks::Hook::name);
+        return it == hooks.end() ? nullptr : it->function;
+    }
+
+    // the loader looks up every function once per instance or device to build its dispatch
+    // tables, so only hooked functions are ever called through the layer.
+
+    PFN_vkVoidFunction myvkGetInstanceProcAddr(VkInstance instance, const char* pName) {
+        if (auto hook = findHook(instanceHooks, pName))
+            return hook;
+        if (auto hook = findHook(Hooks::deviceHooks, pName))
+            return hook;
+        if (!instance)
+            return nullptr;
+
+        const auto* info = Hooks::findInstance(instance);
+        return info ? info->next.getInstanceProcAddr(instance, pName) : nullptr;
+    }
+
+    PFN_vkVoidFunction myvkGetDeviceProcAddr(VkDevice device, const char* pName) {
+        if (std::string_view(pName) == "vkGetDeviceProcAddr")
+            return reinterpret_cast<PFN_vkVoidFunction>(myvkGetDeviceProcAddr);
+
+        // only hook functions the device provides
+        const auto function = Hooks::next(device).getDeviceProcAddr(device, pName);
+        const auto hook = findHook(Hooks::deviceHooks, pName);
+        return function && hook ? hook : function;
+    }
+
+}
+
+VkResult vkNegotiateLoaderLayerInterfaceVersion(VkNegotiateLayerInterface* pVersionStruct) {
+    if (!pVersionStruct || pVersionStruct->sType != LAYER_NEGOTIATE_INTERFACE_STRUCT
+            || pVersionStruct->loaderLayerInterfaceVersion < 2) {
+        Log::error("lsfg-vk(layer): Vulkan loader doesn't support layer interface version 2");
+        return VK_ERROR_INITIALIZATION_FAILED;
+    }
+
+    pVersionStruct->loaderLayerInterfaceVersion = 2;
+    pVersionStruct->pfnGetInstanceProcAddr = myvkGetInstanceProcAddr;
+    pVersionStruct->pfnGetDeviceProcAddr = myvkGetDeviceProcAddr;
+    pVersionStruct->pfnGetPhysicalDeviceProcAddr = nullptr;
+
+    Log::debug("lsfg-vk(layer): Negotiated layer interface version 2 with the Vulkan loader");
+    return VK_SUCCESS;
+}
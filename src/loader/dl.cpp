@@ -1,7 +1,9 @@
 #include "loader/dl.hpp"
 #include "log.hpp"
 
-#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <unordered_set>
 #include <vector>
 
 using namespace Loader;
@@ -19,19 +21,51 @@ namespace {
     dlsym_t   dlsym_ptr;
     dlclose_t dlclose_ptr;
 
-    // map of all registered overrides
+    // vector of all registered overrides, indexed by the index encoded in their fake handle
     auto& overrides() {
         // this has to be a function rather than a static variable
         // because of weird initialization order issues.
-        static std::unordered_map<std::string, DL::File> overrides;
+        static std::vector<DL::File> overrides;
         return overrides;
     }
 
-    // vector of loaded handles
+    // map of filenames to their index in overrides()
+    auto& overrideIndices() {
+        static DL::StringMap<size_t> indices;
+        return indices;
+    }
+
+    // set of loaded handles. libraries are loaded and unloaded from any thread, so it's only
+    // used holding handlesMutex(), as are the handles of overrides(). the overrides themselves
+    // aren't added to once registered.
     auto& handles() {
-        static std::vector<void*> handles;
+        static std::unordered_set<void*> handles;
         return handles;
     }
+    auto& handlesMutex() {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    // fake handles are tagged indices into overrides(). real handles are
+    // pointers to aligned structures, so they never have the tag bit set.
+    constexpr uintptr_t fakeHandleTag = 0x1;
+
+    void* makeFakeHandle(size_t index) {
+        return reinterpret_cast<void*>((index << 1) | fakeHandleTag);
+    }
+
+    // find the override a fake handle was handed out for, or nullptr if it's not fake
+    DL::File* findFakeHandle(void* handle) {
+        const auto value = reinterpret_cast<uintptr_t>(handle);
+        if ((value & fakeHandleTag) == 0)
+            return nullptr;
+        auto& files = overrides();
+        const size_t index = value >> 1;
+        if (index >= files.size() || files.at(index).getHandle() != handle)
+            return nullptr;
+        return &files.at(index);
+    }
 
     bool enable_hooks{true};
 }
@@ -55,16 +89,18 @@ void DL::initialize() {
 
 void DL::registerFile(const File& file) {
     auto& files = overrides();
+    auto& indices = overrideIndices();
 
-    auto it = files.find(file.getFilename());
-    if (it == files.end()) {
+    auto it = indices.find(file.getFilename());
+    if (it == indices.end()) {
         // simply register if the file hasn't been registered yet
-        files.emplace(file.getFilename(), file);
+        indices.emplace(file.getFilename(), files.size());
+        files.push_back(file);
         return;
     }
 
     // merge the new file's symbols into the previously registered one
-    auto& existing_file = it->second;
+    auto& existing_file = files.at(it->second);
     for (const auto& [symbol, func] : file.getSymbols())
         if (existing_file.findSymbol(symbol) == nullptr)
             existing_file.defineSymbol(symbol, func);
@@ -77,58 +113,52 @@ void DL::disableHooks() { enable_hooks = false; }
 void DL::enableHooks()  { enable_hooks = true; }
 
 void* dlopen(const char* filename, int flag) noexcept {
-    auto& files = overrides();
+    const auto& indices = overrideIndices();
     auto& loaded = handles();
 
-    // ALWAYS load the library and ensure it's tracked
+    // ALWAYS load the library and ensure it's tracked. the lock isn't held while loading,
+    // as the library's constructors may load libraries themselves.
     auto* handle = dlopen_ptr(filename, flag);
-    if (handle && std::find(loaded.begin(), loaded.end(), handle) == loaded.end())
-        loaded.push_back(handle);
+    const std::lock_guard<std::mutex> lock(handlesMutex());
+    if (handle)
+        loaded.insert(handle);
 
     // no need to check for overrides if hooks are disabled
     if (!enable_hooks || !filename)
         return handle;
 
     // try to find an override for this filename
-    const std::string filename_str(filename);
-    auto it = files.find(filename_str);
-    if (it == files.end())
+    auto it = indices.find(std::string_view(filename));
+    if (it == indices.end())
         return handle;
 
-    auto& file = it->second;
+    auto& file = overrides().at(it->second);
     file.setOriginalHandle(handle);
-    file.setHandle(reinterpret_cast<void*>(&file));
+    file.setHandle(makeFakeHandle(it->second));
 
     Log::debug("lsfg-vk(dl): Intercepted module load for {}", file.getFilename());
     return file.getHandle();
 }
 
 void* dlsym(void* handle, const char* symbol) noexcept {
-    const auto& files = overrides();
-
     if (!enable_hooks || !handle || !symbol)
         return dlsym_ptr(handle, symbol);
 
     // see if handle is a fake one
-    const auto it = std::find_if(files.begin(), files.end(), [handle](const auto& pair) {
-        return pair.second.getHandle() == handle;
-    });
-    if (it == files.end())
+    const auto* file = findFakeHandle(handle);
+    if (!file)
         return dlsym_ptr(handle, symbol);
-    const auto& file = it->second;
 
     // find a symbol override
-    const std::string symbol_str(symbol);
-    auto* func = file.findSymbol(symbol_str);
+    auto* func = file->findSymbol(symbol);
     if (func == nullptr)
-        return dlsym_ptr(file.getOriginalHandle(), symbol);
+        return dlsym_ptr(file->getOriginalHandle(), symbol);
 
-    Log::debug("lsfg-vk(dl): Intercepted symbol {}::{}", file.getFilename(), symbol_str);
+    Log::debug("lsfg-vk(dl): Intercepted symbol {}::{}", file->getFilename(), symbol);
     return func;
 }
 
 int dlclose(void* handle) noexcept {
-    auto& files = overrides();
     auto& loaded = handles();
 
     // no handle, let the original dlclose handle it
@@ -136,35 +166,32 @@ int dlclose(void* handle) noexcept {
         return dlclose_ptr(handle);
 
     // see if the handle is a fake one
-    auto it = std::find_if(files.begin(), files.end(), [handle](const auto& pair) {
-        return pair.second.getHandle() == handle;
-    });
-    if (it == files.end()) {
+    auto* file = findFakeHandle(handle);
+    if (!file) {
         // if the handle is not fake, check if it's still loaded.
         // this is necessary to avoid double closing when
         // one handle was acquired while hooks were disabled
-        auto l_it = std::find(loaded.begin(), loaded.end(), handle);
-        if (l_it == loaded.end())
+        std::unique_lock<std::mutex> lock(handlesMutex());
+        if (loaded.erase(handle) == 0)
             return 0;
-        loaded.erase(l_it);
+        lock.unlock();
         return dlclose_ptr(handle);
     }
 
-    auto& file = it->second;
-    handle = file.getOriginalHandle();
-    file.setHandle(nullptr);
-    file.setOriginalHandle(nullptr);
+    std::unique_lock<std::mutex> lock(handlesMutex());
+    handle = file->getOriginalHandle();
+    file->setHandle(nullptr);
+    file->setOriginalHandle(nullptr);
 
     // similarly, if it is fake, check if it's still loaded
     // before unloading it again.
-    auto l_it = std::find(loaded.begin(), loaded.end(), handle);
-    if (l_it == loaded.end()) {
-        Log::debug("lsfg-vk(dl): Skipping unload for {} (already unloaded)", file.getFilename());
+    if (loaded.erase(handle) == 0) {
+        Log::debug("lsfg-vk(dl): Skipping unload for {} (already unloaded)", file->getFilename());
         return 0;
     }
-    loaded.erase(l_it);
+    lock.unlock();
 
-    Log::debug("lsfg-vk(dl): Unloaded {}", file.getFilename());
+    Log::debug("lsfg-vk(dl): Unloaded {}", file->getFilename());
     return dlclose_ptr(handle);
 }
 
@@ -0,0 +1,118 @@
+#include "loader/dl.hpp"
+#include "loader/vk.hpp"
+#include "hooks.hpp"
+#include "log.hpp"
+
+#include <afmf.hpp>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+extern "C" void __attribute__((constructor)) init();
+extern "C" [[noreturn]] void __attribute__((destructor)) deinit();
+
+namespace {
+
+    // instance and device hooks, passing calls on to the vulkan loader
+
+    VkResult myvkCreateInstance(
+            const VkInstanceCreateInfo* pCreateInfo,
+            const VkAllocationCallbacks* pAllocator,
+            VkInstance* pInstance) {
+        // create afmf, once per instance
+        Loader::DL::disableHooks();
+        AFMF::initialize();
+        Loader::DL::enableHooks();
+
+        auto res = Hooks::createInstance(pCreateInfo, pAllocator, pInstance,
+            vkCreateInstance, Loader::VK::ovkGetInstanceProcAddr);
+        if (res != VK_SUCCESS)
+            AFMF::finalize(); // destroyed with the instance otherwise
+        return res;
+    }
+
+    void myvkDestroyInstance(
+            VkInstance instance,
+            const VkAllocationCallbacks* pAllocator) {
+        AFMF::finalize(); // destroy afmf
+        Hooks::destroyInstance(instance, pAllocator);
+    }
+
+    VkResult myvkCreateDevice(
+            VkPhysicalDevice physicalDevice,
+            const VkDeviceCreateInfo* pCreateInfo,
+            const VkAllocationCallbacks* pAllocator,
+            VkDevice* pDevice) {
+        return Hooks::createDevice(physicalDevice, pCreateInfo, pAllocator, pDevice,
+            vkCreateDevice, Loader::VK::ovkGetDeviceProcAddr, nullptr);
+    }
+
+    // loader functions for instances and devices created before the library was loaded
+    const Hooks::InstanceDispatch loaderInstanceDispatch{
+        .getInstanceProcAddr = vkGetInstanceProcAddr,
+        .destroyInstance = vkDestroyInstance,
+        .enumerateDeviceExtensionProperties = vkEnumerateDeviceExtensionProperties,
+        .getPhysicalDeviceQueueFamilyProperties = vkGetPhysicalDeviceQueueFamilyProperties,
+        .getPhysicalDeviceFeatures2 = vkGetPhysicalDeviceFeatures2,
+        .getPhysicalDeviceMemoryProperties = vkGetPhysicalDeviceMemoryProperties,
+        .getPhysicalDeviceFormatProperties = vkGetPhysicalDeviceFormatProperties,
+        .getPhysicalDeviceImageFormatProperties2 = vkGetPhysicalDeviceImageFormatProperties2,
+        .getPhysicalDeviceSurfaceSupport = vkGetPhysicalDeviceSurfaceSupportKHR,
+        .getPhysicalDeviceSurfaceCapabilities = vkGetPhysicalDeviceSurfaceCapabilitiesKHR,
+        .getPhysicalDeviceSurfacePresentModes = vkGetPhysicalDeviceSurfacePresentModesKHR
+    };
+    const Hooks::DeviceDispatch loaderDeviceDispatch{
+        .instance = &loaderInstanceDispatch,
+        .getDeviceProcAddr = vkGetDeviceProcAddr,
+        .destroyDevice = vkDestroyDevice,
+        .getDeviceQueue = vkGetDeviceQueue,
+        .createSwapchain = vkCreateSwapchainKHR,
+        .destroySwapchain = vkDestroySwapchainKHR,
+        .getSwapchainImages = vkGetSwapchainImagesKHR,
+        .acquireNextImage = vkAcquireNextImageKHR,
+        .acquireNextImage2 = vkAcquireNextImage2KHR,
+        .queuePresent = vkQueuePresentKHR
+    };
+
+}
+
+void init() {
+    Log::info("lsfg-vk-afmf: init() called");
+
+    // hook loaders
+    Loader::DL::initialize();
+    Loader::VK::initialize();
+    Hooks::setLoaderDispatch(loaderInstanceDispatch, loaderDeviceDispatch);
+
+    // list of hooks to register
+    std::vector<std::pair<std::string, void*>> hooks = {
+        { "vkCreateInstance",  reinterpret_cast<void*>(myvkCreateInstance) },
+        { "vkDestroyInstance", reinterpret_cast<void*>(myvkDestroyInstance) },
+        { "vkCreateDevice",    reinterpret_cast<void*>(myvkCreateDevice) }
+    };
+    for (const auto& hook : Hooks::deviceHooks)
+        hooks.emplace_back(hook.name, reinterpret_cast<void*>(hook.function));
+
+    // register hooks to Vulkan loader
+    for (const auto& hook : hooks)
+        Loader::VK::registerSymbol(hook.first, hook.second);
+
+    // register hooks to dynamic loader under libvulkan.so.1 and libvulkan.so
+    for (const char* libName : {"libvulkan.so.1", "libvulkan.so"}) {
+        Loader::DL::File vkLib(libName);
+        for (const auto& hook : hooks)
+            vkLib.defineSymbol(hook.first, hook.second);
+        Loader::DL::registerFile(vkLib);
+    }
+
+    Log::info("lsfg-vk-afmf: init() completed successfully");
+}
+
+void deinit() {
+    Log::debug("lsfg-vk-afmf: deinit() called, exiting");
+    Log::flush(); // exit() won't wait for the log thread
+    // for some reason some applications unload the library despite it containing
+    // the dl functions. this will lead to a segmentation fault, so we exit early.
+    exit(EXIT_SUCCESS);
+}
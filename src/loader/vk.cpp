@@ -2,6 +2,10 @@
 #include "loader/dl.hpp"
 #include "log.hpp"
 
+#include <array>
+#include <cstring>
+#include <vector>
+
 using namespace Loader;
 
 namespace {
@@ -9,11 +13,32 @@ namespace {
     PFN_vkGetInstanceProcAddr vkGetInstanceProcAddr_ptr{};
     PFN_vkGetDeviceProcAddr   vkGetDeviceProcAddr_ptr{};
 
-    // map of all overridden symbols
+    // longest symbol name that can be overridden
+    constexpr size_t maxSymbolLength = 63;
+
+    struct Symbol {
+        std::string name;
+        void* address;
+    };
+
+    // all overridden symbols, bucketed by name length. applications resolve every
+    // function through these loaders, so a lookup only measures the name and
+    // compares it against the few overrides of the same length, without allocating.
     auto& symbols() {
-        static std::unordered_map<std::string, void*> symbols;
+        static std::array<std::vector<Symbol>, maxSymbolLength + 1> symbols;
         return symbols;
     }
+
+    // find the override of a symbol, or nullptr if it isn't overridden
+    const Symbol* findSymbol(const char* pName) {
+        const size_t length = strnlen(pName, maxSymbolLength + 1);
+        if (length > maxSymbolLength)
+            return nullptr;
+        for (const auto& symbol : symbols().at(length))
+            if (std::memcmp(symbol.name.data(), pName, length) == 0)
+                return &symbol;
+        return nullptr;
+    }
 }
 
 void VK::initialize() {
@@ -56,46 +81,41 @@ void VK::initialize() {
 }
 
 void VK::registerSymbol(const std::string& symbol, void* address) {
-    auto& syms = symbols();
-
-    const auto it = syms.find(symbol);
-    if (it != syms.end()) {
+    if (symbol.size() > maxSymbolLength) {
+        Log::warn("lsfg-vk(vk): Tried registering symbol {}, but its name is too long", symbol);
+        return;
+    }
+    if (findSymbol(symbol.c_str())) {
         Log::warn("lsfg-vk(vk): Tried registering symbol {}, but it is already defined", symbol);
         return;
     }
 
-    syms.emplace(symbol, address);
+    symbols().at(symbol.size()).push_back({ symbol, address });
 }
 
 PFN_vkVoidFunction myvkGetInstanceProcAddr(VkInstance instance, const char* pName) {
-    const auto& syms = symbols();
-
     if (!pName)
         return vkGetInstanceProcAddr_ptr(instance, pName);
 
     // try to find an override
-    const std::string pName_str(pName);
-    const auto it = syms.find(pName_str);
-    if (it == syms.end())
+    const auto* symbol = findSymbol(pName);
+    if (!symbol)
         return vkGetInstanceProcAddr_ptr(instance, pName);
 
-    Log::debug("lsfg-vk(vk): Intercepted Vulkan symbol {}", pName_str);
-    return reinterpret_cast<PFN_vkVoidFunction>(it->second);
+    Log::debug("lsfg-vk(vk): Intercepted Vulkan symbol {}", symbol->name);
+    return reinterpret_cast<PFN_vkVoidFunction>(symbol->address);
 }
 
 PFN_vkVoidFunction myvkGetDeviceProcAddr(VkDevice device, const char* pName) {
-    const auto& syms = symbols();
-
     if (!pName)
         return vkGetDeviceProcAddr_ptr(device, pName);
 
-    const std::string pName_str(pName);
-    auto it = syms.find(pName_str);
-    if (it == syms.end())
+    const auto* symbol = findSymbol(pName);
+    if (!symbol)
         return vkGetDeviceProcAddr_ptr(device, pName);
 
-    Log::debug("lsfg-vk(vk): Intercepted Vulkan symbol {}", pName_str);
-    return reinterpret_cast<PFN_vkVoidFunction>(it->second);
+    Log::debug("lsfg-vk(vk): Intercepted Vulkan symbol {}", symbol->name);
+    return reinterpret_cast<PFN_vkVoidFunction>(symbol->address);
 }
 
 // original function calls
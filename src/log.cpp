@@ -0,0 +1,188 @@
+#include "log.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+
+using namespace Log;
+
+namespace {
+
+    /// Message waiting in the ring.
+    struct Record {
+        std::atomic<size_t> sequence; // slot index while free, one past it once written
+        Level level;
+        bool truncated;
+        size_t length;
+        std::array<char, maxMessageLength> message;
+    };
+
+    constexpr size_t ringSize = 1024; // power of two
+
+    ///
+    /// Bounded queue of records, after Dmitry Vyukov's MPMC queue: producers claim a slot
+    /// with a single compare-and-swap on the write position, and hand it to the consumer
+    /// by advancing the slot's sequence. Drained by one thread at a time.
+    ///
+    /// Producers count every record they hand over and notify the count, which the
+    /// background thread waits on, so it only wakes up when there is something to write.
+    ///
+    class Ring {
+    public:
+        Ring() {
+            for (size_t i = 0; i < ringSize; i++)
+                this->records.at(i).sequence.store(i, std::memory_order_relaxed);
+        }
+
+        // claim a slot and copy the message into it, or count it as dropped if full
+        void push(Level level, std::string_view message, bool truncated) {
+            size_t position = this->writePosition.load(std::memory_order_relaxed);
+            Record* record{};
+            while (true) {
+                record = &this->records.at(position % ringSize);
+                const size_t sequence = record->sequence.load(std::memory_order_acquire);
+                if (sequence == position) {
+                    if (this->writePosition.compare_exchange_weak(position, position + 1,
+                            std::memory_order_relaxed))
+                        break;
+                } else if (sequence < position) {
+                    this->dropped.fetch_add(1, std::memory_order_relaxed);
+                    return;
+                } else {
+                    position = this->writePosition.load(std::memory_order_relaxed);
+                }
+            }
+
+            record->level = level;
+            record->truncated = truncated;
+            record->length = std::min(message.size(), maxMessageLength);
+            std::memcpy(record->message.data(), message.data(), record->length);
+            record->sequence.store(position + 1, std::memory_order_release);
+            this->published.fetch_add(1, std::memory_order_release);
+            this->published.notify_one();
+        }
+
+        // get the amount of records handed over so far
+        [[nodiscard]] uint64_t getPublished() const {
+            return this->published.load(std::memory_order_acquire);
+        }
+
+        // block until more than the given amount of records were handed over
+        void waitPublished(uint64_t seen) const {
+            this->published.wait(seen, std::memory_order_acquire);
+        }
+
+        // write every record written so far to stderr at once
+        void drain() {
+            const std::lock_guard<std::mutex> lock(this->mutex);
+            this->buffer.clear();
+            while (true) {
+                Record& record = this->records.at(this->readPosition % ringSize);
+                if (record.sequence.load(std::memory_order_acquire) != this->readPosition + 1)
+                    break;
+
+                this->append(record.level, std::string_view(record.message.data(), record.length),
+                    record.truncated);
+                record.sequence.store(this->readPosition + ringSize, std::memory_order_release);
+                this->readPosition++;
+            }
+
+            const uint64_t total = this->dropped.load(std::memory_order_relaxed);
+            if (total != this->reportedDrops) {
+                this->append(Level::Warn, "lsfg-vk-afmf: Dropped " + std::to_string(total - this->reportedDrops)
+                    + " log messages, logging faster than stderr is written", false);
+                this->reportedDrops = total;
+            }
+
+            if (!this->buffer.empty())
+                std::cerr.write(this->buffer.data(), static_cast<std::streamsize>(this->buffer.size())).flush();
+        }
+
+        [[nodiscard]] uint64_t getDroppedCount() const {
+            return this->dropped.load(std::memory_order_relaxed);
+        }
+    private:
+        void append(Level level, std::string_view message, bool truncated) {
+            switch (level) {
+                case Level::Debug: this->buffer += GRAY; break;
+                case Level::Info: this->buffer += WHITE; break;
+                case Level::Warn: this->buffer += YELLOW; break;
+                default: this->buffer += RED; break;
+            }
+            this->buffer += message;
+            if (truncated)
+                this->buffer += "...";
+            this->buffer += RESET;
+            this->buffer += '\n';
+        }
+
+        std::array<Record, ringSize> records;
+        alignas(64) std::atomic<size_t> writePosition{0};
+        alignas(64) std::atomic<uint64_t> dropped{0};
+        alignas(64) std::atomic<uint64_t> published{0}; // records handed over, waited on by the background thread
+
+        std::mutex mutex; // held while draining
+        size_t readPosition{0};
+        uint64_t reportedDrops{0};
+        std::string buffer; // text written by one drain
+    };
+
+    // the ring and its thread are created on first use and never destroyed, so messages
+    // can be logged from library constructors and destructors in any order.
+    Ring& ring() {
+        static Ring* ring = [] {
+            auto* created = new Ring();
+            std::thread([created] {
+                while (true) {
+                    const uint64_t seen = created->getPublished();
+                    created->drain();
+                    created->waitPublished(seen);
+                }
+            }).detach();
+            std::atexit(Log::flush);
+            return created;
+        }();
+        return *ring;
+    }
+
+    Level readLevel() {
+        const char* levelEnv = std::getenv("AFMF_LOG_LEVEL");
+        if (!levelEnv)
+            return Level::Info;
+
+        const std::string_view level(levelEnv);
+        if (level == "debug")
+            return Level::Debug;
+        if (level == "info")
+            return Level::Info;
+        if (level == "warn")
+            return Level::Warn;
+        if (level == "error")
+            return Level::Error;
+        if (level == "none")
+            return Level::None;
+        return Level::Info;
+    }
+
+}
+
+Level Log::getLevel() {
+    static const Level level = readLevel();
+    return level;
+}
+
+void Log::push(Level level, std::string_view message, bool truncated) {
+    ring().push(level, message, truncated);
+}
+
+void Log::flush() {
+    ring().drain();
+}
+
+uint64_t Log::getDroppedCount() {
+    return ring().getDroppedCount();
+}
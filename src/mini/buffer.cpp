@@ -0,0 +1,81 @@
+#include "mini/buffer.hpp"
+#include "mini/stats.hpp"
+
+#include <afmf.hpp>
+
+#include <optional>
+
+using namespace Mini;
+
+Buffer::Buffer(const Hooks::DeviceDispatch& vk, VkDevice device, VkPhysicalDevice physicalDevice,
+        uint64_t size, VkBufferUsageFlags usage) : size(size) {
+    // create buffer
+    const VkBufferCreateInfo desc{
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = size,
+        .usage = usage,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE
+    };
+    VkBuffer bufferHandle{};
+    auto res = vk.createBuffer(device, &desc, nullptr, &bufferHandle);
+    if (res != VK_SUCCESS || bufferHandle == VK_NULL_HANDLE)
+        throw AFMF::vulkan_error(res, "Failed to create Vulkan buffer");
+    Stats::recordCreation();
+
+    // find memory type, preferring cached memory for fast host reads
+    VkPhysicalDeviceMemoryProperties memProps;
+    vk.instance->getPhysicalDeviceMemoryProperties(physicalDevice, &memProps);
+
+    VkMemoryRequirements memReqs;
+    vk.getBufferMemoryRequirements(device, bufferHandle, &memReqs);
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunsafe-buffer-usage"
+    const VkMemoryPropertyFlags required =
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    std::optional<uint32_t> memType{};
+    for (const VkMemoryPropertyFlags flags : { required | VK_MEMORY_PROPERTY_HOST_CACHED_BIT, required }) {
+        for (uint32_t i = 0; i < memProps.memoryTypeCount && !memType.has_value(); ++i) {
+            if ((memReqs.memoryTypeBits & (1 << i)) && // NOLINTBEGIN
+                (memProps.memoryTypes[i].propertyFlags & flags) == flags)
+                memType.emplace(i); // NOLINTEND
+        }
+    }
+    if (!memType.has_value())
+        throw AFMF::vulkan_error(VK_ERROR_UNKNOWN, "Unable to find memory type for buffer");
+#pragma clang diagnostic pop
+
+    // allocate, bind and map memory
+    const VkMemoryAllocateInfo allocInfo{
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize = memReqs.size,
+        .memoryTypeIndex = memType.value()
+    };
+    VkDeviceMemory memoryHandle{};
+    res = vk.allocateMemory(device, &allocInfo, nullptr, &memoryHandle);
+    if (res != VK_SUCCESS || memoryHandle == VK_NULL_HANDLE)
+        throw AFMF::vulkan_error(res, "Failed to allocate memory for Vulkan buffer");
+    Stats::recordCreation();
+
+    res = vk.bindBufferMemory(device, bufferHandle, memoryHandle, 0);
+    if (res != VK_SUCCESS)
+        throw AFMF::vulkan_error(res, "Failed to bind memory to Vulkan buffer");
+
+    res = vk.mapMemory(device, memoryHandle, 0, VK_WHOLE_SIZE, 0, &this->data);
+    if (res != VK_SUCCESS || this->data == nullptr)
+        throw AFMF::vulkan_error(res, "Failed to map memory of Vulkan buffer");
+
+    // store objects in shared ptr
+    this->buffer = std::shared_ptr<VkBuffer>(
+        new VkBuffer(bufferHandle),
+        [vk = &vk, dev = device](VkBuffer* buf) {
+            vk->destroyBuffer(dev, *buf, nullptr);
+        }
+    );
+    this->memory = std::shared_ptr<VkDeviceMemory>(
+        new VkDeviceMemory(memoryHandle),
+        [vk = &vk, dev = device](VkDeviceMemory* mem) {
+            vk->freeMemory(dev, *mem, nullptr); // implicitly unmaps
+        }
+    );
+}
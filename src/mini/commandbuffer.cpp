@@ -1,10 +1,12 @@
 #include "mini/commandbuffer.hpp"
+#include "mini/stats.hpp"
 
 #include <afmf.hpp>
 
 using namespace Mini;
 
-CommandBuffer::CommandBuffer(VkDevice device, const CommandPool& pool) {
+CommandBuffer::CommandBuffer(const Hooks::DeviceDispatch& vk, VkDevice device,
+        const CommandPool& pool) : vk(&vk) {
     // create command buffer
     const VkCommandBufferAllocateInfo desc{
         .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
@@ -13,40 +15,43 @@ CommandBuffer::CommandBuffer(VkDevice device, const CommandPool& pool) {
         .commandBufferCount = 1
     };
     VkCommandBuffer commandBufferHandle{};
-    auto res = vkAllocateCommandBuffers(device, &desc, &commandBufferHandle);
+    auto res = vk.allocateCommandBuffers(device, &desc, &commandBufferHandle);
     if (res != VK_SUCCESS || commandBufferHandle == VK_NULL_HANDLE)
         throw AFMF::vulkan_error(res, "Unable to allocate command buffer");
+    Stats::recordCreation();
 
     // store command buffer in shared ptr
     this->state = std::make_shared<CommandBufferState>(CommandBufferState::Empty);
+    this->usage = std::make_shared<VkCommandBufferUsageFlags>(0);
     this->commandBuffer = std::shared_ptr<VkCommandBuffer>(
         new VkCommandBuffer(commandBufferHandle),
-        [dev = device, pool = pool.handle()](VkCommandBuffer* cmdBuffer) {
-            vkFreeCommandBuffers(dev, pool, 1, cmdBuffer);
+        [vk = &vk, dev = device, pool = pool.handle()](VkCommandBuffer* cmdBuffer) {
+            vk->freeCommandBuffers(dev, pool, 1, cmdBuffer);
         }
     );
 }
 
-void CommandBuffer::begin() {
+void CommandBuffer::begin(VkCommandBufferUsageFlags flags) {
     if (*this->state != CommandBufferState::Empty)
         throw std::logic_error("Command buffer is not in Empty state");
 
     const VkCommandBufferBeginInfo beginInfo = {
         .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+        .flags = flags
     };
-    auto res = vkBeginCommandBuffer(*this->commandBuffer, &beginInfo);
+    auto res = this->vk->beginCommandBuffer(*this->commandBuffer, &beginInfo);
     if (res != VK_SUCCESS)
         throw AFMF::vulkan_error(res, "Unable to begin command buffer");
 
     *this->state = CommandBufferState::Recording;
+    *this->usage = flags;
 }
 
 void CommandBuffer::end() {
     if (*this->state != CommandBufferState::Recording)
         throw std::logic_error("Command buffer is not in Recording state");
 
-    auto res = vkEndCommandBuffer(*this->commandBuffer);
+    auto res = this->vk->endCommandBuffer(*this->commandBuffer);
     if (res != VK_SUCCESS)
         throw AFMF::vulkan_error(res, "Unable to end command buffer");
 
@@ -55,15 +60,34 @@ void CommandBuffer::end() {
 
 void CommandBuffer::submit(VkQueue queue,
         const std::vector<VkSemaphore>& waitSemaphores,
-        const std::vector<VkSemaphore>& signalSemaphores) {
+        const std::vector<VkSemaphore>& signalSemaphores,
+        const Fence* fence) {
+    this->submit(queue, waitSemaphores, {}, signalSemaphores, {}, fence);
+}
+
+void CommandBuffer::submit(VkQueue queue,
+        const std::vector<VkSemaphore>& waitSemaphores,
+        const std::vector<uint64_t>& waitValues,
+        const std::vector<VkSemaphore>& signalSemaphores,
+        const std::vector<uint64_t>& signalValues,
+        const Fence* fence) {
     if (*this->state != CommandBufferState::Full)
         throw std::logic_error("Command buffer is not in Full state");
 
     const std::vector<VkPipelineStageFlags> waitStages(waitSemaphores.size(),
         VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
 
+    // only chain timeline values if any were given
+    const VkTimelineSemaphoreSubmitInfo timelineInfo{
+        .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+        .waitSemaphoreValueCount = static_cast<uint32_t>(waitValues.size()),
+        .pWaitSemaphoreValues = waitValues.data(),
+        .signalSemaphoreValueCount = static_cast<uint32_t>(signalValues.size()),
+        .pSignalSemaphoreValues = signalValues.data()
+    };
     const VkSubmitInfo submitInfo{
         .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext = (waitValues.empty() && signalValues.empty()) ? nullptr : &timelineInfo,
         .waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size()),
         .pWaitSemaphores = waitSemaphores.data(),
         .pWaitDstStageMask = waitStages.data(),
@@ -72,9 +96,11 @@ void CommandBuffer::submit(VkQueue queue,
         .signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size()),
         .pSignalSemaphores = signalSemaphores.data()
     };
-    auto res = vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
+    auto res = this->vk->queueSubmit(queue, 1, &submitInfo,
+        fence ? fence->handle() : VK_NULL_HANDLE);
     if (res != VK_SUCCESS)
         throw AFMF::vulkan_error(res, "Unable to submit command buffer");
 
-    *this->state = CommandBufferState::Submitted;
+    if (*this->usage & VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT)
+        *this->state = CommandBufferState::Submitted;
 }
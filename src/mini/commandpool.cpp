@@ -1,25 +1,27 @@
 #include "mini/commandpool.hpp"
+#include "mini/stats.hpp"
 
 #include <afmf.hpp>
 
 using namespace Mini;
 
-CommandPool::CommandPool(VkDevice device, uint32_t graphicsFamilyIdx) {
+CommandPool::CommandPool(const Hooks::DeviceDispatch& vk, VkDevice device, uint32_t graphicsFamilyIdx) {
     // create command pool
     const VkCommandPoolCreateInfo desc{
         .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
         .queueFamilyIndex = graphicsFamilyIdx
     };
     VkCommandPool commandPoolHandle{};
-    auto res = vkCreateCommandPool(device, &desc, nullptr, &commandPoolHandle);
+    auto res = vk.createCommandPool(device, &desc, nullptr, &commandPoolHandle);
     if (res != VK_SUCCESS || commandPoolHandle == VK_NULL_HANDLE)
         throw AFMF::vulkan_error(res, "Unable to create command pool");
+    Stats::recordCreation();
 
     // store command pool in shared ptr
     this->commandPool = std::shared_ptr<VkCommandPool>(
         new VkCommandPool(commandPoolHandle),
-        [dev = device](VkCommandPool* commandPoolHandle) {
-            vkDestroyCommandPool(dev, *commandPoolHandle, nullptr);
+        [vk = &vk, dev = device](VkCommandPool* commandPoolHandle) {
+            vk->destroyCommandPool(dev, *commandPoolHandle, nullptr);
         }
     );
 }
@@ -0,0 +1,41 @@
+#include "mini/fence.hpp"
+#include "mini/stats.hpp"
+
+#include <afmf.hpp>
+
+using namespace Mini;
+
+Fence::Fence(const Hooks::DeviceDispatch& vk, VkDevice device, bool signaled)
+        : vk(&vk), device(device) {
+    // create fence
+    const VkFenceCreateInfo desc{
+        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+        .flags = signaled ? VkFenceCreateFlags{VK_FENCE_CREATE_SIGNALED_BIT} : VkFenceCreateFlags{0}
+    };
+    VkFence fenceHandle{};
+    auto res = vk.createFence(device, &desc, nullptr, &fenceHandle);
+    if (res != VK_SUCCESS || fenceHandle == VK_NULL_HANDLE)
+        throw AFMF::vulkan_error(res, "Unable to create fence");
+    Stats::recordCreation();
+
+    // store fence in shared ptr
+    this->fence = std::shared_ptr<VkFence>(
+        new VkFence(fenceHandle),
+        [vk = &vk, dev = device](VkFence* fenceHandle) {
+            vk->destroyFence(dev, *fenceHandle, nullptr);
+        }
+    );
+}
+
+void Fence::reset() const {
+    auto res = this->vk->resetFences(this->device, 1, &(*this->fence));
+    if (res != VK_SUCCESS)
+        throw AFMF::vulkan_error(res, "Unable to reset fence");
+}
+
+bool Fence::wait(uint64_t timeout) const {
+    auto res = this->vk->waitForFences(this->device, 1, &(*this->fence), VK_TRUE, timeout);
+    if (res != VK_SUCCESS && res != VK_TIMEOUT)
+        throw AFMF::vulkan_error(res, "Unable to wait for fence");
+    return res == VK_SUCCESS;
+}
@@ -1,4 +1,5 @@
 #include "mini/image.hpp"
+#include "mini/stats.hpp"
 
 #include <afmf.hpp>
 
@@ -6,42 +7,63 @@
 
 using namespace Mini;
 
-Image::Image(VkDevice device, VkPhysicalDevice physicalDevice,
+namespace {
+    VkImage createExportableImage(const Hooks::DeviceDispatch& vk, VkDevice device, VkExtent2D extent, VkFormat format,
+            VkImageUsageFlags usage) {
+        const VkExternalMemoryImageCreateInfo externalInfo{
+            .sType = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_IMAGE_CREATE_INFO,
+            .handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT_KHR
+        };
+        const VkImageCreateInfo desc{
+            .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+            .pNext = &externalInfo,
+            .imageType = VK_IMAGE_TYPE_2D,
+            .format = format,
+            .extent = {
+                .width = extent.width,
+                .height = extent.height,
+                .depth = 1
+            },
+            .mipLevels = 1,
+            .arrayLayers = 1,
+            .samples = VK_SAMPLE_COUNT_1_BIT,
+            .usage = usage,
+            .sharingMode = VK_SHARING_MODE_EXCLUSIVE
+        };
+        VkImage imageHandle{};
+        auto res = vk.createImage(device, &desc, nullptr, &imageHandle);
+        if (res != VK_SUCCESS || imageHandle == VK_NULL_HANDLE)
+            throw AFMF::vulkan_error(res, "Failed to create Vulkan image");
+        Stats::recordCreation();
+        return imageHandle;
+    }
+}
+
+Image::Image(const Hooks::DeviceDispatch& vk, VkDevice device, VkExtent2D extent, VkFormat format,
+        VkImageUsageFlags usage, VkImageAspectFlags aspectFlags)
+        : extent(extent), format(format), aspectFlags(aspectFlags) {
+    VkImage imageHandle = createExportableImage(vk, device, extent, format, usage);
+    this->image = std::shared_ptr<VkImage>(
+        new VkImage(imageHandle),
+        [vk = &vk, dev = device](VkImage* img) {
+            vk->destroyImage(dev, *img, nullptr);
+        }
+    );
+}
+
+Image::Image(const Hooks::DeviceDispatch& vk, VkDevice device, VkPhysicalDevice physicalDevice,
         VkExtent2D extent, VkFormat format,
         VkImageUsageFlags usage, VkImageAspectFlags aspectFlags, int* fd)
         : extent(extent), format(format), aspectFlags(aspectFlags) {
     // create image
-    const VkExternalMemoryImageCreateInfo externalInfo{
-        .sType = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_IMAGE_CREATE_INFO,
-        .handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT_KHR
-    };
-    const VkImageCreateInfo desc{
-        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
-        .pNext = &externalInfo,
-        .imageType = VK_IMAGE_TYPE_2D,
-        .format = format,
-        .extent = {
-            .width = extent.width,
-            .height = extent.height,
-            .depth = 1
-        },
-        .mipLevels = 1,
-        .arrayLayers = 1,
-        .samples = VK_SAMPLE_COUNT_1_BIT,
-        .usage = usage,
-        .sharingMode = VK_SHARING_MODE_EXCLUSIVE
-    };
-    VkImage imageHandle{};
-    auto res = vkCreateImage(device, &desc, nullptr, &imageHandle);
-    if (res != VK_SUCCESS || imageHandle == VK_NULL_HANDLE)
-        throw AFMF::vulkan_error(res, "Failed to create Vulkan image");
+    VkImage imageHandle = createExportableImage(vk, device, extent, format, usage);
 
     // find memory type
     VkPhysicalDeviceMemoryProperties memProps;
-    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProps);
+    vk.instance->getPhysicalDeviceMemoryProperties(physicalDevice, &memProps);
 
     VkMemoryRequirements memReqs;
-    vkGetImageMemoryRequirements(device, imageHandle, &memReqs);
+    vk.getImageMemoryRequirements(device, imageHandle, &memReqs);
 
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wunsafe-buffer-usage"
@@ -74,38 +96,36 @@ Image::Image(VkDevice device, VkPhysicalDevice physicalDevice,
         .memoryTypeIndex = memType.value()
     };
     VkDeviceMemory memoryHandle{};
-    res = vkAllocateMemory(device, &allocInfo, nullptr, &memoryHandle);
+    auto res = vk.allocateMemory(device, &allocInfo, nullptr, &memoryHandle);
     if (res != VK_SUCCESS || memoryHandle == VK_NULL_HANDLE)
         throw AFMF::vulkan_error(res, "Failed to allocate memory for Vulkan image");
+    Stats::recordCreation();
 
-    res = vkBindImageMemory(device, imageHandle, memoryHandle, 0);
+    res = vk.bindImageMemory(device, imageHandle, memoryHandle, 0);
     if (res != VK_SUCCESS)
         throw AFMF::vulkan_error(res, "Failed to bind memory to Vulkan image");
 
     // obtain the sharing fd
-    auto vkGetMemoryFdKHR =
-        reinterpret_cast<PFN_vkGetMemoryFdKHR>(vkGetDeviceProcAddr(device, "vkGetMemoryFdKHR"));
-
     const VkMemoryGetFdInfoKHR fdInfo{
         .sType = VK_STRUCTURE_TYPE_MEMORY_GET_FD_INFO_KHR,
         .memory = memoryHandle,
         .handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT_KHR,
     };
-    res = vkGetMemoryFdKHR(device, &fdInfo, fd);
+    res = vk.getMemoryFd(device, &fdInfo, fd);
     if (res != VK_SUCCESS || *fd < 0)
         throw AFMF::vulkan_error(res, "Failed to obtain sharing fd for Vulkan image");
 
     // store objects in shared ptr
     this->image = std::shared_ptr<VkImage>(
         new VkImage(imageHandle),
-        [dev = device](VkImage* img) {
-            vkDestroyImage(dev, *img, nullptr);
+        [vk = &vk, dev = device](VkImage* img) {
+            vk->destroyImage(dev, *img, nullptr);
         }
     );
     this->memory = std::shared_ptr<VkDeviceMemory>(
         new VkDeviceMemory(memoryHandle),
-        [dev = device](VkDeviceMemory* mem) {
-            vkFreeMemory(dev, *mem, nullptr);
+        [vk = &vk, dev = device](VkDeviceMemory* mem) {
+            vk->freeMemory(dev, *mem, nullptr);
         }
     );
 }
@@ -0,0 +1,254 @@
+#include "mini/imagearena.hpp"
+#include "mini/stats.hpp"
+
+#include <afmf.hpp>
+
+#include <stdexcept>
+
+using namespace Mini;
+
+ImageArena::ImageArena(const Hooks::DeviceDispatch& vk, VkDevice device, VkPhysicalDevice physicalDevice)
+        : vk(&vk), device(device), physicalDevice(physicalDevice) {
+    this->memory = std::shared_ptr<VkDeviceMemory>(
+        new VkDeviceMemory(VK_NULL_HANDLE),
+        [vk = &vk, dev = device](VkDeviceMemory* mem) {
+            if (*mem != VK_NULL_HANDLE)
+                vk->freeMemory(dev, *mem, nullptr);
+        }
+    );
+}
+
+Image ImageArena::createImage(VkExtent2D extent, VkFormat format,
+        VkImageUsageFlags usage, VkImageAspectFlags aspectFlags, uint64_t* offset) {
+    if (this->allocated)
+        throw std::logic_error("Image arena has already been allocated");
+
+    Image image(*this->vk, this->device, extent, format, usage, aspectFlags);
+
+    // give the image a block of its own if it can't share one
+    VkMemoryRequirements memReqs;
+    if (this->requiresDedicated(image.handle(), format, usage, &memReqs)) {
+        image.memory = std::shared_ptr<VkDeviceMemory>(
+            new VkDeviceMemory(VK_NULL_HANDLE),
+            [vk = this->vk, dev = this->device](VkDeviceMemory* mem) {
+                if (*mem != VK_NULL_HANDLE)
+                    vk->freeMemory(dev, *mem, nullptr);
+            }
+        );
+        this->dedicated.push_back({
+            .image = image.handle(),
+            .size = memReqs.size,
+            .memoryTypeBits = memReqs.memoryTypeBits,
+            .memory = image.memory
+        });
+        *offset = 0;
+        return image;
+    }
+
+    // place the image after the previous one
+    image.memory = this->memory;
+    *offset = (this->size + memReqs.alignment - 1) / memReqs.alignment * memReqs.alignment;
+    this->size = *offset + memReqs.size;
+    this->memoryTypeBits &= memReqs.memoryTypeBits;
+    this->bindings.emplace_back(image.handle(), *offset);
+    return image;
+}
+
+void ImageArena::allocate(int* fd, std::vector<int>* dedicatedFds) {
+    if (this->allocated)
+        throw std::logic_error("Image arena has already been allocated");
+    this->allocated = true;
+
+    *fd = -1;
+    if (!this->bindings.empty()) {
+        // allocate and bind memory
+        const VkExportMemoryAllocateInfo exportInfo{
+            .sType = VK_STRUCTURE_TYPE_EXPORT_MEMORY_ALLOCATE_INFO,
+            .handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT_KHR
+        };
+        const VkMemoryAllocateInfo allocInfo{
+            .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+            .pNext = &exportInfo,
+            .allocationSize = this->size,
+            .memoryTypeIndex = this->findMemoryType(this->memoryTypeBits)
+        };
+        VkDeviceMemory memoryHandle{};
+        auto res = this->vk->allocateMemory(this->device, &allocInfo, nullptr, &memoryHandle);
+        if (res != VK_SUCCESS || memoryHandle == VK_NULL_HANDLE)
+            throw AFMF::vulkan_error(res, "Failed to allocate memory for image arena");
+        Stats::recordCreation();
+        *this->memory = memoryHandle;
+
+        this->bindImages();
+        *fd = this->exportMemory(memoryHandle);
+    }
+
+    for (auto& dedicated : this->dedicated) {
+        this->allocateDedicated(dedicated, -1);
+        dedicatedFds->push_back(this->exportMemory(*dedicated.memory));
+    }
+}
+
+void ImageArena::import(int fd, uint64_t size, const std::vector<int>& dedicatedFds) {
+    if (this->allocated)
+        throw std::logic_error("Image arena has already been allocated");
+    if (dedicatedFds.size() != this->dedicated.size())
+        throw AFMF::vulkan_error(VK_ERROR_INVALID_EXTERNAL_HANDLE,
+            "Imported dedicated memory doesn't match the image arena");
+    this->allocated = true;
+
+    if (!this->bindings.empty()) {
+        if (size < this->size)
+            throw AFMF::vulkan_error(VK_ERROR_INVALID_EXTERNAL_HANDLE,
+                "Imported memory is too small for the image arena");
+
+        // import and bind memory
+        const VkImportMemoryFdInfoKHR importInfo{
+            .sType = VK_STRUCTURE_TYPE_IMPORT_MEMORY_FD_INFO_KHR,
+            .handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT_KHR,
+            .fd = fd // closes the fd
+        };
+        const VkMemoryAllocateInfo allocInfo{
+            .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+            .pNext = &importInfo,
+            .allocationSize = size,
+            .memoryTypeIndex = this->findMemoryType(this->memoryTypeBits)
+        };
+        VkDeviceMemory memoryHandle{};
+        auto res = this->vk->allocateMemory(this->device, &allocInfo, nullptr, &memoryHandle);
+        if (res != VK_SUCCESS || memoryHandle == VK_NULL_HANDLE)
+            throw AFMF::vulkan_error(res, "Failed to import memory for image arena");
+        Stats::recordCreation();
+        *this->memory = memoryHandle;
+        this->size = size;
+
+        this->bindImages();
+    }
+
+    for (size_t i = 0; i < this->dedicated.size(); i++)
+        this->allocateDedicated(this->dedicated.at(i), dedicatedFds.at(i));
+}
+
+bool ImageArena::requiresDedicated(VkImage image, VkFormat format, VkImageUsageFlags usage,
+        VkMemoryRequirements* memReqs) const {
+    VkMemoryDedicatedRequirements dedicatedReqs{
+        .sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS
+    };
+    VkMemoryRequirements2 memReqs2{
+        .sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2,
+        .pNext = &dedicatedReqs
+    };
+    const VkImageMemoryRequirementsInfo2 reqsInfo{
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2,
+        .image = image
+    };
+    this->vk->getImageMemoryRequirements2(this->device, &reqsInfo, &memReqs2);
+    *memReqs = memReqs2.memoryRequirements;
+
+    // the memory of the image must be exportable and importable as an opaque fd
+    const VkPhysicalDeviceExternalImageFormatInfo externalInfo{
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_IMAGE_FORMAT_INFO,
+        .handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT
+    };
+    const VkPhysicalDeviceImageFormatInfo2 formatInfo{
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_IMAGE_FORMAT_INFO_2,
+        .pNext = &externalInfo,
+        .format = format,
+        .type = VK_IMAGE_TYPE_2D,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = usage
+    };
+    VkExternalImageFormatProperties externalProps{
+        .sType = VK_STRUCTURE_TYPE_EXTERNAL_IMAGE_FORMAT_PROPERTIES
+    };
+    VkImageFormatProperties2 formatProps{
+        .sType = VK_STRUCTURE_TYPE_IMAGE_FORMAT_PROPERTIES_2,
+        .pNext = &externalProps
+    };
+    auto res = this->vk->instance->getPhysicalDeviceImageFormatProperties2(this->physicalDevice,
+        &formatInfo, &formatProps);
+    const auto features = externalProps.externalMemoryProperties.externalMemoryFeatures;
+    constexpr VkExternalMemoryFeatureFlags sharable =
+        VK_EXTERNAL_MEMORY_FEATURE_EXPORTABLE_BIT | VK_EXTERNAL_MEMORY_FEATURE_IMPORTABLE_BIT;
+    if (res != VK_SUCCESS || (features & sharable) != sharable)
+        throw AFMF::vulkan_error(res != VK_SUCCESS ? res : VK_ERROR_FORMAT_NOT_SUPPORTED,
+            "Vulkan image memory can't be shared");
+
+    return dedicatedReqs.requiresDedicatedAllocation
+        || (features & VK_EXTERNAL_MEMORY_FEATURE_DEDICATED_ONLY_BIT);
+}
+
+uint32_t ImageArena::findMemoryType(uint32_t memoryTypeBits) const {
+    // images are created for export, so their memory types are those opaque fds can be
+    // exported from. whether the image itself can be shared is checked on creation.
+    VkPhysicalDeviceMemoryProperties memProps;
+    this->vk->instance->getPhysicalDeviceMemoryProperties(this->physicalDevice, &memProps);
+
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunsafe-buffer-usage"
+    for (uint32_t i = 0; i < memProps.memoryTypeCount; ++i) {
+        if ((memoryTypeBits & (1 << i)) && // NOLINTBEGIN
+            (memProps.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT))
+            return i; // NOLINTEND
+    }
+#pragma clang diagnostic pop
+
+    throw AFMF::vulkan_error(VK_ERROR_UNKNOWN, "Unable to find memory type for image arena");
+}
+
+void ImageArena::bindImages() {
+    for (const auto& [image, offset] : this->bindings) {
+        auto res = this->vk->bindImageMemory(this->device, image, *this->memory, offset);
+        if (res != VK_SUCCESS)
+            throw AFMF::vulkan_error(res, "Failed to bind image arena memory to Vulkan image");
+    }
+    this->bindings.clear();
+}
+
+void ImageArena::allocateDedicated(Dedicated& dedicated, int fd) {
+    // import the block if given, allocate a new one for export otherwise
+    const VkMemoryDedicatedAllocateInfo dedicatedInfo{
+        .sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO,
+        .image = dedicated.image
+    };
+    const VkImportMemoryFdInfoKHR importInfo{
+        .sType = VK_STRUCTURE_TYPE_IMPORT_MEMORY_FD_INFO_KHR,
+        .pNext = &dedicatedInfo,
+        .handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT_KHR,
+        .fd = fd // closes the fd
+    };
+    const VkExportMemoryAllocateInfo exportInfo{
+        .sType = VK_STRUCTURE_TYPE_EXPORT_MEMORY_ALLOCATE_INFO,
+        .pNext = &dedicatedInfo,
+        .handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT_KHR
+    };
+    const VkMemoryAllocateInfo allocInfo{
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .pNext = fd >= 0 ? static_cast<const void*>(&importInfo) : &exportInfo,
+        .allocationSize = dedicated.size,
+        .memoryTypeIndex = this->findMemoryType(dedicated.memoryTypeBits)
+    };
+    VkDeviceMemory memoryHandle{};
+    auto res = this->vk->allocateMemory(this->device, &allocInfo, nullptr, &memoryHandle);
+    if (res != VK_SUCCESS || memoryHandle == VK_NULL_HANDLE)
+        throw AFMF::vulkan_error(res, "Failed to allocate dedicated memory for image arena");
+    Stats::recordCreation();
+    *dedicated.memory = memoryHandle;
+
+    res = this->vk->bindImageMemory(this->device, dedicated.image, memoryHandle, 0);
+    if (res != VK_SUCCESS)
+        throw AFMF::vulkan_error(res, "Failed to bind dedicated memory to Vulkan image");
+}
+
+int ImageArena::exportMemory(VkDeviceMemory memory) const {
+    const VkMemoryGetFdInfoKHR fdInfo{
+        .sType = VK_STRUCTURE_TYPE_MEMORY_GET_FD_INFO_KHR,
+        .memory = memory,
+        .handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_OPAQUE_FD_BIT_KHR,
+    };
+    int fd{-1};
+    auto res = this->vk->getMemoryFd(this->device, &fdInfo, &fd);
+    if (res != VK_SUCCESS || fd < 0)
+        throw AFMF::vulkan_error(res, "Failed to obtain sharing fd for image arena");
+    return fd;
+}
@@ -1,29 +1,32 @@
 #include "mini/semaphore.hpp"
+#include "mini/stats.hpp"
 
 #include <afmf.hpp>
 
 using namespace Mini;
 
-Semaphore::Semaphore(VkDevice device) {
+Semaphore::Semaphore(const Hooks::DeviceDispatch& vk, VkDevice device) : vk(&vk), device(device) {
     // create semaphore
     const VkSemaphoreCreateInfo desc{
         .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO
     };
     VkSemaphore semaphoreHandle{};
-    auto res = vkCreateSemaphore(device, &desc, nullptr, &semaphoreHandle);
+    auto res = vk.createSemaphore(device, &desc, nullptr, &semaphoreHandle);
     if (res != VK_SUCCESS || semaphoreHandle == VK_NULL_HANDLE)
         throw AFMF::vulkan_error(res, "Unable to create semaphore");
+    Stats::recordCreation();
 
     // store semaphore in shared ptr
     this->semaphore = std::shared_ptr<VkSemaphore>(
         new VkSemaphore(semaphoreHandle),
-        [dev = device](VkSemaphore* semaphoreHandle) {
-            vkDestroySemaphore(dev, *semaphoreHandle, nullptr);
+        [vk = &vk, dev = device](VkSemaphore* semaphoreHandle) {
+            vk->destroySemaphore(dev, *semaphoreHandle, nullptr);
         }
     );
 }
 
-Semaphore::Semaphore(VkDevice device, int* fd) {
+Semaphore::Semaphore(const Hooks::DeviceDispatch& vk, VkDevice device, int* fd)
+        : vk(&vk), device(device) {
     // create semaphore
     const VkExportSemaphoreCreateInfo exportInfo{
         .sType = VK_STRUCTURE_TYPE_EXPORT_SEMAPHORE_CREATE_INFO,
@@ -34,28 +37,106 @@ Semaphore::Semaphore(VkDevice device, int* fd) {
         .pNext = &exportInfo
     };
     VkSemaphore semaphoreHandle{};
-    auto res = vkCreateSemaphore(device, &desc, nullptr, &semaphoreHandle);
+    auto res = vk.createSemaphore(device, &desc, nullptr, &semaphoreHandle);
     if (res != VK_SUCCESS || semaphoreHandle == VK_NULL_HANDLE)
         throw AFMF::vulkan_error(res, "Unable to create semaphore");
+    Stats::recordCreation();
+
+    // store semaphore in shared ptr
+    this->semaphore = std::shared_ptr<VkSemaphore>(
+        new VkSemaphore(semaphoreHandle),
+        [vk = &vk, dev = device](VkSemaphore* semaphoreHandle) {
+            vk->destroySemaphore(dev, *semaphoreHandle, nullptr);
+        }
+    );
 
     // export semaphore to fd
-    auto vkGetSemaphoreFdKHR = reinterpret_cast<PFN_vkGetSemaphoreFdKHR>(
-        vkGetDeviceProcAddr(device, "vkGetSemaphoreFdKHR"));
+    if (fd)
+        *fd = this->exportFd();
+}
 
-    const VkSemaphoreGetFdInfoKHR fdInfo{
-        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_GET_FD_INFO_KHR,
-        .semaphore = semaphoreHandle,
-        .handleType = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_OPAQUE_FD_BIT
+Semaphore::Semaphore(const Hooks::DeviceDispatch& vk, VkDevice device, uint64_t initialValue, int* fd)
+        : vk(&vk), device(device) {
+    // create semaphore
+    const VkSemaphoreTypeCreateInfo typeInfo{
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+        .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+        .initialValue = initialValue
     };
-    res = vkGetSemaphoreFdKHR(device, &fdInfo, fd);
-    if (res != VK_SUCCESS || *fd < 0)
-        throw AFMF::vulkan_error(res, "Unable to export semaphore to fd");
+    const VkExportSemaphoreCreateInfo exportInfo{
+        .sType = VK_STRUCTURE_TYPE_EXPORT_SEMAPHORE_CREATE_INFO,
+        .pNext = &typeInfo,
+        .handleTypes = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_OPAQUE_FD_BIT
+    };
+    const VkSemaphoreCreateInfo desc{
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        .pNext = &exportInfo
+    };
+    VkSemaphore semaphoreHandle{};
+    auto res = vk.createSemaphore(device, &desc, nullptr, &semaphoreHandle);
+    if (res != VK_SUCCESS || semaphoreHandle == VK_NULL_HANDLE)
+        throw AFMF::vulkan_error(res, "Unable to create timeline semaphore");
+    Stats::recordCreation();
 
     // store semaphore in shared ptr
     this->semaphore = std::shared_ptr<VkSemaphore>(
         new VkSemaphore(semaphoreHandle),
-        [dev = device](VkSemaphore* semaphoreHandle) {
-            vkDestroySemaphore(dev, *semaphoreHandle, nullptr);
+        [vk = &vk, dev = device](VkSemaphore* semaphoreHandle) {
+            vk->destroySemaphore(dev, *semaphoreHandle, nullptr);
         }
     );
+
+    // export semaphore to fd
+    if (fd)
+        *fd = this->exportFd();
+}
+
+int Semaphore::exportFd() const {
+    const VkSemaphoreGetFdInfoKHR fdInfo{
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_GET_FD_INFO_KHR,
+        .semaphore = *this->semaphore,
+        .handleType = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_OPAQUE_FD_BIT
+    };
+    int fd{-1};
+    auto res = this->vk->getSemaphoreFd(this->device, &fdInfo, &fd);
+    if (res != VK_SUCCESS || fd < 0)
+        throw AFMF::vulkan_error(res, "Unable to export semaphore to fd");
+    return fd;
+}
+
+void Semaphore::importFd(int fd, bool temporary) const {
+    const VkImportSemaphoreFdInfoKHR importInfo{
+        .sType = VK_STRUCTURE_TYPE_IMPORT_SEMAPHORE_FD_INFO_KHR,
+        .semaphore = *this->semaphore,
+        .flags = temporary ? static_cast<VkSemaphoreImportFlags>(VK_SEMAPHORE_IMPORT_TEMPORARY_BIT) : 0U,
+        .handleType = VK_EXTERNAL_SEMAPHORE_HANDLE_TYPE_OPAQUE_FD_BIT,
+        .fd = fd // closes the fd
+    };
+    auto res = this->vk->importSemaphoreFd(this->device, &importInfo);
+    if (res != VK_SUCCESS)
+        throw AFMF::vulkan_error(res, "Unable to import semaphore from fd");
+}
+
+bool Semaphore::wait(uint64_t value, uint64_t timeout) const {
+    const VkSemaphoreWaitInfo waitInfo{
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+        .semaphoreCount = 1,
+        .pSemaphores = &(*this->semaphore),
+        .pValues = &value
+    };
+    auto res = this->vk->waitSemaphores(this->device, &waitInfo, timeout);
+    if (res != VK_SUCCESS && res != VK_TIMEOUT)
+        throw AFMF::vulkan_error(res, "Unable to wait for timeline semaphore");
+    return res == VK_SUCCESS;
+}
+
+void Semaphore::signal(uint64_t value) const {
+    const VkSemaphoreSignalInfo signalInfo{
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SIGNAL_INFO,
+        .semaphore = *this->semaphore,
+        .value = value
+    };
+    auto res = this->vk->signalSemaphore(this->device, &signalInfo);
+    if (res != VK_SUCCESS)
+        throw AFMF::vulkan_error(res, "Unable to signal timeline semaphore");
 }
@@ -0,0 +1,22 @@
+#include "mini/stats.hpp"
+
+using namespace Mini;
+
+namespace {
+    thread_local Stats::Counter* current{nullptr}; // innermost counter of the thread
+}
+
+void Stats::recordCreation() {
+    if (current)
+        current->count++;
+}
+
+Stats::Counter::Counter() noexcept : outer(current) {
+    current = this;
+}
+
+Stats::Counter::~Counter() {
+    current = this->outer;
+    if (this->outer)
+        this->outer->count += this->count;
+}
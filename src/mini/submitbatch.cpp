@@ -0,0 +1,91 @@
+#include "mini/submitbatch.hpp"
+
+#include <afmf.hpp>
+
+using namespace Mini;
+
+void SubmitBatch::add(const CommandBuffer& buf,
+        const std::vector<VkSemaphore>& waitSemaphores,
+        const std::vector<uint64_t>& waitValues,
+        const std::vector<VkSemaphore>& signalSemaphores,
+        const std::vector<uint64_t>& signalValues) {
+    if (buf.getState() != CommandBufferState::Full)
+        throw std::logic_error("Command buffer is not in Full state");
+
+    if (this->entryCount == this->entries.size())
+        this->entries.emplace_back();
+    auto& entry = this->entries.at(this->entryCount++);
+
+    // assign rather than copy construct to keep the capacity of previous frames
+    entry.buf = buf;
+    entry.waitSemaphores.assign(waitSemaphores.begin(), waitSemaphores.end());
+    entry.waitValues.assign(waitValues.begin(), waitValues.end());
+    entry.waitStages.assign(waitSemaphores.size(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+    entry.signalSemaphores.assign(signalSemaphores.begin(), signalSemaphores.end());
+    entry.signalValues.assign(signalValues.begin(), signalValues.end());
+}
+
+void SubmitBatch::addSignal(const std::vector<VkSemaphore>& waitSemaphores,
+        const std::vector<uint64_t>& waitValues,
+        const std::vector<VkSemaphore>& signalSemaphores,
+        const std::vector<uint64_t>& signalValues) {
+    if (this->entryCount == this->entries.size())
+        this->entries.emplace_back();
+    auto& entry = this->entries.at(this->entryCount++);
+
+    entry.buf = CommandBuffer();
+    entry.waitSemaphores.assign(waitSemaphores.begin(), waitSemaphores.end());
+    entry.waitValues.assign(waitValues.begin(), waitValues.end());
+    entry.waitStages.assign(waitSemaphores.size(), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT);
+    entry.signalSemaphores.assign(signalSemaphores.begin(), signalSemaphores.end());
+    entry.signalValues.assign(signalValues.begin(), signalValues.end());
+}
+
+void SubmitBatch::flush(VkQueue queue, const Fence* fence) {
+    if (this->entryCount == 0 && !fence)
+        return;
+
+    this->timelineInfos.resize(this->entryCount);
+    this->submitInfos.resize(this->entryCount);
+    for (size_t i = 0; i < this->entryCount; i++) {
+        const auto& entry = this->entries.at(i);
+
+        // only chain timeline values if any were given
+        auto& timelineInfo = this->timelineInfos.at(i);
+        timelineInfo = VkTimelineSemaphoreSubmitInfo{
+            .sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+            .waitSemaphoreValueCount = static_cast<uint32_t>(entry.waitValues.size()),
+            .pWaitSemaphoreValues = entry.waitValues.data(),
+            .signalSemaphoreValueCount = static_cast<uint32_t>(entry.signalValues.size()),
+            .pSignalSemaphoreValues = entry.signalValues.data()
+        };
+        const bool timeline = !entry.waitValues.empty() || !entry.signalValues.empty();
+
+        this->submitInfos.at(i) = VkSubmitInfo{
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .pNext = timeline ? &timelineInfo : nullptr,
+            .waitSemaphoreCount = static_cast<uint32_t>(entry.waitSemaphores.size()),
+            .pWaitSemaphores = entry.waitSemaphores.data(),
+            .pWaitDstStageMask = entry.waitStages.data(),
+            .commandBufferCount = entry.buf.commandBuffer ? 1U : 0U,
+            .pCommandBuffers = entry.buf.commandBuffer ? &(*entry.buf.commandBuffer) : nullptr,
+            .signalSemaphoreCount = static_cast<uint32_t>(entry.signalSemaphores.size()),
+            .pSignalSemaphores = entry.signalSemaphores.data()
+        };
+    }
+
+    auto res = this->vk->queueSubmit(queue,
+        static_cast<uint32_t>(this->submitInfos.size()), this->submitInfos.data(),
+        fence ? fence->handle() : VK_NULL_HANDLE);
+    if (res != VK_SUCCESS)
+        throw AFMF::vulkan_error(res, "Unable to submit command buffer batch");
+    this->submitCount++;
+
+    for (size_t i = 0; i < this->entryCount; i++) {
+        auto& buf = this->entries.at(i).buf;
+        if (buf.usage && (*buf.usage & VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT))
+            *buf.state = CommandBufferState::Submitted;
+        buf = CommandBuffer(); // don't keep the command buffer alive
+    }
+    this->entryCount = 0;
+}
@@ -0,0 +1,86 @@
+#include "multiplier.hpp"
+
+#include <algorithm>
+
+namespace {
+
+    // weight of the newest sample in the averages, as a fraction 1/smoothing
+    constexpr uint64_t smoothing = 8;
+    // longer gaps between presents, like loading screens, aren't averaged
+    constexpr uint64_t idleInterval = 1000ULL * 1000 * 1000; // 1s, in ns
+    // presents a new amount of frames must be picked in a row before it applies
+    constexpr uint64_t settleFrames = 8;
+    // a real frame fits a refresh even if it's this much shorter, so jitter doesn't rule it out
+    constexpr uint64_t tolerancePercent = 10;
+    // share of a real frame afmf may spend generating
+    constexpr uint64_t budgetPercent = 80;
+    // presents generation pauses for when over budget, doubling up to the maximum
+    constexpr uint64_t minBackoff = 60;
+    constexpr uint64_t maxBackoff = 960;
+
+    uint64_t average(uint64_t average, uint64_t sample) {
+        return average - average / smoothing + sample / smoothing;
+    }
+
+}
+
+MultiplierController::MultiplierController(uint64_t maxOutputs, uint64_t refreshPeriod)
+        : maxOutputs(maxOutputs),
+          refreshPeriod(refreshPeriod),
+          outputs(maxOutputs),
+          candidate(maxOutputs),
+          backoffLength(minBackoff) {
+}
+
+uint64_t MultiplierController::update(uint64_t now, uint64_t generationTime, bool backpressure) {
+    if (this->lastPresent != 0 && now > this->lastPresent && now - this->lastPresent < idleInterval) {
+        const uint64_t interval = now - this->lastPresent;
+        this->frameTime = this->frameTime == 0 ? interval : average(this->frameTime, interval);
+        this->generationTime = average(this->generationTime, generationTime);
+    }
+    this->lastPresent = now;
+    if (this->frameTime == 0)
+        return this->outputs;
+
+    // pause generating while over budget. nothing is generated during the pause,
+    // so the averaged generation time has decayed by the time it's retried
+    const bool overBudget = backpressure
+        || this->generationTime * 100 > this->frameTime * budgetPercent;
+    if (this->outputs > 0 && overBudget) {
+        this->backoff = this->backoffLength;
+        this->backoffLength = std::min(this->backoffLength * 2, maxBackoff);
+        this->backoffCount++;
+        this->stableFrames = 0;
+        this->outputs = 0;
+        this->candidate = 0;
+        this->candidateFrames = 0;
+        return this->outputs;
+    }
+    if (this->backoff > 0) {
+        this->backoff--;
+        return this->outputs;
+    }
+    if (this->outputs > 0 && ++this->stableFrames >= maxBackoff)
+        this->backoffLength = minBackoff;
+
+    // frames fitting into a real frame at the refresh rate, one of them being the real one.
+    // without a known refresh rate, as many as possible
+    uint64_t target = this->maxOutputs;
+    if (this->refreshPeriod != 0) {
+        const uint64_t fitting = this->frameTime * (100 + tolerancePercent) / 100 / this->refreshPeriod;
+        target = std::clamp<uint64_t>(fitting, 1, this->maxOutputs + 1) - 1;
+    }
+
+    // generating more frames takes proportionally longer, and must still fit the budget
+    if (this->outputs > 0 && this->generationTime > 0)
+        target = std::min(target,
+            this->outputs * this->frameTime * budgetPercent / (this->generationTime * 100));
+
+    if (target != this->candidate) {
+        this->candidate = target;
+        this->candidateFrames = 0;
+    }
+    if (target != this->outputs && ++this->candidateFrames >= settleFrames)
+        this->outputs = target;
+    return this->outputs;
+}
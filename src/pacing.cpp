@@ -0,0 +1,74 @@
+#include "pacing.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <ctime>
+#include <utility>
+
+namespace {
+
+    // weight of the newest sample in the error average, as a fraction 1/smoothing
+    constexpr uint64_t smoothing = 8;
+    // frames count as late this long after their time, if the refresh period is unknown
+    constexpr uint64_t lateThreshold = 1000ULL * 1000; // 1ms, in ns
+
+    uint64_t monotonicNow() {
+        timespec time{};
+        clock_gettime(CLOCK_MONOTONIC, &time);
+        return static_cast<uint64_t>(time.tv_sec) * 1000 * 1000 * 1000
+            + static_cast<uint64_t>(time.tv_nsec);
+    }
+
+    void monotonicSleep(uint64_t until) {
+        const timespec time{
+            .tv_sec = static_cast<time_t>(until / (1000ULL * 1000 * 1000)),
+            .tv_nsec = static_cast<long>(until % (1000ULL * 1000 * 1000))
+        };
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &time, nullptr) == EINTR) {}
+    }
+
+}
+
+FramePacer::FramePacer(uint64_t refreshPeriod)
+        : FramePacer(refreshPeriod, monotonicNow, monotonicSleep) {
+}
+
+FramePacer::FramePacer(uint64_t refreshPeriod, ClockFn clock, SleepFn sleep)
+        : refreshPeriod(refreshPeriod),
+          clock(std::move(clock)),
+          sleep(std::move(sleep)) {
+}
+
+const std::vector<uint64_t>& FramePacer::schedule(uint64_t count, uint64_t frameTime) {
+    const uint64_t now = this->clock();
+
+    // spread the frames evenly, on whole refreshes if they're known
+    uint64_t spacing = frameTime / (count + 1);
+    if (this->refreshPeriod != 0 && spacing >= this->refreshPeriod / 2)
+        spacing = (spacing + this->refreshPeriod / 2) / this->refreshPeriod * this->refreshPeriod;
+
+    // continue the previous present's cadence, unless it fell behind or ran ahead
+    const uint64_t start = this->last == 0 ? now
+        : std::clamp(this->last + spacing, now, now + spacing);
+    this->times.resize(count + 1);
+    for (uint64_t i = 0; i <= count; i++)
+        this->times.at(i) = start + i * spacing;
+    this->last = this->times.back();
+    return this->times;
+}
+
+void FramePacer::wait(uint64_t time) const {
+    if (time > this->clock())
+        this->sleep(time);
+}
+
+void FramePacer::presented(uint64_t target, uint64_t actual) {
+    const uint64_t distance = actual > target ? actual - target : target - actual;
+    this->error = this->presentCount == 0 ? distance
+        : this->error - this->error / smoothing + distance / smoothing;
+    this->presentCount++;
+
+    const uint64_t threshold = this->refreshPeriod == 0 ? lateThreshold : this->refreshPeriod / 2;
+    if (actual > target + threshold)
+        this->lateCount++;
+}
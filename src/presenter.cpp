@@ -0,0 +1,59 @@
+#include "presenter.hpp"
+
+#include <utility>
+
+Presenter::Presenter(size_t capacity, PresentFn present)
+        : jobs(capacity),
+          present(std::move(present)) {
+    this->thread = std::thread(&Presenter::work, this);
+}
+
+void Presenter::push(uint64_t job) {
+    this->wait(this->jobs.size() - 1);
+
+    const uint32_t pushed = this->head.load(std::memory_order_relaxed);
+    this->jobs.at(pushed % this->jobs.size()) = job;
+    this->head.store(pushed + 1, std::memory_order_release);
+    this->head.notify_one();
+}
+
+void Presenter::wait(size_t outstanding) const {
+    // the tail never passes the head, so the head read after it is at least as far
+    uint32_t done = this->tail.load(std::memory_order_acquire);
+    const uint32_t pushed = this->head.load(std::memory_order_acquire);
+    if (pushed - done <= outstanding)
+        return;
+
+    // jobs pushed by the producer meanwhile may finish too, so the tail can pass the target
+    const uint32_t target = pushed - static_cast<uint32_t>(outstanding);
+    while (static_cast<int32_t>(target - done) > 0) {
+        this->tail.wait(done, std::memory_order_acquire);
+        done = this->tail.load(std::memory_order_acquire);
+    }
+}
+
+void Presenter::work() {
+    while (true) {
+        const uint32_t done = this->tail.load(std::memory_order_relaxed);
+        const uint32_t pushed = this->head.load(std::memory_order_acquire);
+        if (pushed == done) {
+            this->head.wait(pushed, std::memory_order_acquire);
+            continue;
+        }
+        if (this->stopping.load())
+            return;
+
+        this->present(this->jobs.at(done % this->jobs.size()));
+        this->tail.store(done + 1, std::memory_order_release);
+        this->tail.notify_all();
+    }
+}
+
+Presenter::~Presenter() {
+    // finish every queued job, then wake the thread with an empty one to stop it
+    this->wait(0);
+    this->stopping.store(true);
+    this->head.fetch_add(1, std::memory_order_release);
+    this->head.notify_one();
+    this->thread.join();
+}
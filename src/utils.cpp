@@ -3,35 +3,169 @@
 #include <afmf.hpp>
 
 #include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <new>
 #include <optional>
+#include <string_view>
 
 using namespace Utils;
 
-std::pair<uint32_t, VkQueue> Utils::findQueue(VkDevice device, VkPhysicalDevice physicalDevice,
-        VkDeviceCreateInfo* desc, VkQueueFlags flags) {
+namespace {
+
+    // size of the structures features are enabled through. other structures aren't
+    // known well enough to be copied.
+    size_t structureSize(VkStructureType type) {
+        switch (type) {
+        case VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2:
+            return sizeof(VkPhysicalDeviceFeatures2);
+        case VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_FEATURES:
+            return sizeof(VkPhysicalDeviceVulkan11Features);
+        case VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES:
+            return sizeof(VkPhysicalDeviceVulkan12Features);
+        case VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES:
+            return sizeof(VkPhysicalDeviceVulkan13Features);
+        case VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES:
+            return sizeof(VkPhysicalDeviceTimelineSemaphoreFeatures);
+        case VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR:
+            return sizeof(VkPhysicalDevicePresentIdFeaturesKHR);
+        case VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR:
+            return sizeof(VkPhysicalDevicePresentWaitFeaturesKHR);
+        default:
+            return 0;
+        }
+    }
+
+    // copy the first structure of a type in a creation info's chain, and every one in front
+    // of it, so it can be modified without touching the application's structures.
+    // returns nullptr if a structure in front of it can't be copied.
+    template<typename T>
+    T* copyStructure(VkDeviceCreateInfo* desc, VkStructureType type, StructureStorage& storage) {
+        VkBaseOutStructure* previous{nullptr};
+        for (auto* next = static_cast<const VkBaseInStructure*>(desc->pNext); next; ) {
+            const size_t size = structureSize(next->sType);
+            if (size == 0)
+                return nullptr;
+
+            auto& copy = storage.emplace_back(std::make_unique<std::byte[]>(size));
+            std::memcpy(copy.get(), next, size);
+            auto* structure = reinterpret_cast<VkBaseOutStructure*>(copy.get());
+            if (previous)
+                previous->pNext = structure;
+            else
+                desc->pNext = structure;
+
+            if (structure->sType == type)
+                return reinterpret_cast<T*>(structure);
+            previous = structure;
+            next = reinterpret_cast<const VkBaseInStructure*>(structure->pNext);
+        }
+        return nullptr;
+    }
+
+    // prepend a structure to a creation info's chain
+    template<typename T>
+    void prependStructure(VkDeviceCreateInfo* desc, const T& structure, StructureStorage& storage) {
+        auto& copy = storage.emplace_back(std::make_unique<std::byte[]>(sizeof(T)));
+        auto* prepended = new (copy.get()) T(structure);
+        prepended->pNext = const_cast<void*>(desc->pNext);
+        desc->pNext = prepended;
+    }
+
+    // check if a physical device supports every one of a list of extensions
+    bool supportsExtensions(const Hooks::InstanceDispatch& vk, VkPhysicalDevice physicalDevice,
+            const std::vector<std::string_view>& required) {
+        uint32_t extensionCount{};
+        auto res = vk.enumerateDeviceExtensionProperties(physicalDevice, nullptr,
+            &extensionCount, nullptr);
+        if (res != VK_SUCCESS)
+            return false;
+        std::vector<VkExtensionProperties> extensions(extensionCount);
+        res = vk.enumerateDeviceExtensionProperties(physicalDevice, nullptr,
+            &extensionCount, extensions.data());
+        if (res != VK_SUCCESS)
+            return false;
+
+        return std::ranges::all_of(required, [&extensions](const auto& name) {
+            return std::ranges::any_of(extensions, [&name](const auto& extension) {
+                return std::string_view(extension.extensionName) == name;
+            });
+        });
+    }
+
+}
+
+std::optional<uint32_t> Utils::findEnabledQueueFamily(const Hooks::InstanceDispatch& vk,
+        VkPhysicalDevice physicalDevice, const VkDeviceCreateInfo* desc, VkQueueFlags flags) {
     std::vector<VkDeviceQueueCreateInfo> enabledQueues(desc->queueCreateInfoCount);
     std::copy_n(desc->pQueueCreateInfos, enabledQueues.size(), enabledQueues.data());
 
     uint32_t familyCount{};
-    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+    vk.getPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
     std::vector<VkQueueFamilyProperties> families(familyCount);
-    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+    vk.getPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
 
-    std::optional<uint32_t> idx;
-    for (const auto& queueInfo : enabledQueues) {
+    for (const auto& queueInfo : enabledQueues)
         if ((queueInfo.queueFamilyIndex < families.size()) &&
-            (families[queueInfo.queueFamilyIndex].queueFlags & flags)) {
-            idx = queueInfo.queueFamilyIndex;
-            break;
-        }
+            (families[queueInfo.queueFamilyIndex].queueFlags & flags))
+            return queueInfo.queueFamilyIndex;
+    return std::nullopt;
+}
+
+std::optional<uint32_t> Utils::findQueueFamily(const Hooks::InstanceDispatch& vk,
+        VkPhysicalDevice physicalDevice, VkQueueFlags flags, VkQueueFlags excludedFlags) {
+    uint32_t familyCount{};
+    vk.getPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> families(familyCount);
+    vk.getPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+
+    for (uint32_t i = 0; i < familyCount; i++) {
+        const auto queueFlags = families.at(i).queueFlags;
+        if ((queueFlags & flags) == flags && !(queueFlags & excludedFlags))
+            return i;
     }
-    if (!idx.has_value())
-        throw AFMF::vulkan_error(VK_ERROR_INITIALIZATION_FAILED, "No suitable queue found");
+    return std::nullopt;
+}
+
+std::optional<uint32_t> Utils::requestQueue(const Hooks::InstanceDispatch& vk,
+        VkDeviceCreateInfo* desc, VkPhysicalDevice physicalDevice, uint32_t family,
+        std::vector<VkDeviceQueueCreateInfo>& queueInfos, std::vector<float>& priorities) {
+    if (queueInfos.data() != desc->pQueueCreateInfos)
+        queueInfos.assign(desc->pQueueCreateInfos,
+            std::next(desc->pQueueCreateInfos, desc->queueCreateInfoCount));
+
+    uint32_t familyCount{};
+    vk.getPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+    std::vector<VkQueueFamilyProperties> families(familyCount);
+    vk.getPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
 
-    VkQueue queue{};
-    vkGetDeviceQueue(device, *idx, 0, &queue);
+    std::optional<uint32_t> queueIdx;
+    auto it = std::ranges::find_if(queueInfos, [family](const auto& info) {
+        return info.queueFamilyIndex == family;
+    });
+    if (it == queueInfos.end()) {
+        // the application doesn't use the family, add it
+        priorities.assign(1, 1.0F);
+        queueInfos.push_back({
+            .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+            .queueFamilyIndex = family,
+            .queueCount = 1,
+            .pQueuePriorities = priorities.data()
+        });
+        queueIdx = 0;
+    } else if (it->queueCount < families.at(family).queueCount) {
+        // the application uses the family, append a queue
+        priorities.assign(it->pQueuePriorities,
+            std::next(it->pQueuePriorities, it->queueCount));
+        priorities.push_back(1.0F);
+        queueIdx = it->queueCount;
+        it->queueCount++;
+        it->pQueuePriorities = priorities.data();
+    } // otherwise all queues are in use by the application
 
-    return { *idx, queue };
+    desc->queueCreateInfoCount = static_cast<uint32_t>(queueInfos.size());
+    desc->pQueueCreateInfos = queueInfos.data();
+    return queueIdx;
 }
 
 std::vector<const char*> Utils::addExtensions(const char* const* extensions, size_t count,
@@ -48,16 +182,173 @@ std::vector<const char*> Utils::addExtensions(const char* const* extensions, siz
     return ext;
 }
 
-void Utils::copyImage(VkCommandBuffer buf,
+bool Utils::supportsTimelineSemaphores(const Hooks::InstanceDispatch& vk, VkPhysicalDevice physicalDevice) {
+    if (!supportsExtensions(vk, physicalDevice, { "VK_KHR_timeline_semaphore" }))
+        return false;
+
+    VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures{
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES
+    };
+    VkPhysicalDeviceFeatures2 features{
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext = &timelineFeatures
+    };
+    vk.getPhysicalDeviceFeatures2(physicalDevice, &features);
+    return timelineFeatures.timelineSemaphore == VK_TRUE;
+}
+
+bool Utils::enableTimelineSemaphores(VkDeviceCreateInfo* desc, StructureStorage& storage) {
+    // the application may already request the feature through either structure,
+    // and chaining a second structure of the same kind would be invalid.
+    if (hasStructure(desc->pNext, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES)) {
+        auto* vk12 = copyStructure<VkPhysicalDeviceVulkan12Features>(desc,
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES, storage);
+        if (!vk12)
+            return false;
+        vk12->timelineSemaphore = VK_TRUE;
+        return true;
+    }
+    if (hasStructure(desc->pNext, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES)) {
+        auto* timeline = copyStructure<VkPhysicalDeviceTimelineSemaphoreFeatures>(desc,
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES, storage);
+        if (!timeline)
+            return false;
+        timeline->timelineSemaphore = VK_TRUE;
+        return true;
+    }
+
+    prependStructure(desc, VkPhysicalDeviceTimelineSemaphoreFeatures{
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES,
+        .timelineSemaphore = VK_TRUE
+    }, storage);
+    return true;
+}
+
+bool Utils::supportsPresentWait(const Hooks::InstanceDispatch& vk, VkPhysicalDevice physicalDevice) {
+    if (!supportsExtensions(vk, physicalDevice, { "VK_KHR_present_id", "VK_KHR_present_wait" }))
+        return false;
+
+    VkPhysicalDevicePresentWaitFeaturesKHR waitFeatures{
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR
+    };
+    VkPhysicalDevicePresentIdFeaturesKHR idFeatures{
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR,
+        .pNext = &waitFeatures
+    };
+    VkPhysicalDeviceFeatures2 features{
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext = &idFeatures
+    };
+    vk.getPhysicalDeviceFeatures2(physicalDevice, &features);
+    return idFeatures.presentId == VK_TRUE && waitFeatures.presentWait == VK_TRUE;
+}
+
+bool Utils::enablePresentWait(VkDeviceCreateInfo* desc, StructureStorage& storage) {
+    // like timeline semaphores, enable features the application already chained in copies
+    if (hasStructure(desc->pNext, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR)) {
+        auto* id = copyStructure<VkPhysicalDevicePresentIdFeaturesKHR>(desc,
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR, storage);
+        if (!id)
+            return false;
+        id->presentId = VK_TRUE;
+    } else {
+        prependStructure(desc, VkPhysicalDevicePresentIdFeaturesKHR{
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR,
+            .presentId = VK_TRUE
+        }, storage);
+    }
+
+    if (hasStructure(desc->pNext, VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR)) {
+        auto* wait = copyStructure<VkPhysicalDevicePresentWaitFeaturesKHR>(desc,
+            VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR, storage);
+        if (!wait)
+            return false;
+        wait->presentWait = VK_TRUE;
+    } else {
+        prependStructure(desc, VkPhysicalDevicePresentWaitFeaturesKHR{
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR,
+            .presentWait = VK_TRUE
+        }, storage);
+    }
+    return true;
+}
+
+bool Utils::supportsDisplayTiming(const Hooks::InstanceDispatch& vk, VkPhysicalDevice physicalDevice) {
+    return supportsExtensions(vk, physicalDevice, { "VK_GOOGLE_display_timing" });
+}
+
+bool Utils::supportsPresentMode(const Hooks::InstanceDispatch& vk, VkPhysicalDevice physicalDevice,
+        VkSurfaceKHR surface, VkPresentModeKHR mode) {
+    uint32_t modeCount{};
+    auto res = vk.getPhysicalDeviceSurfacePresentModes(physicalDevice, surface,
+        &modeCount, nullptr);
+    if (res != VK_SUCCESS)
+        return false;
+    std::vector<VkPresentModeKHR> modes(modeCount);
+    res = vk.getPhysicalDeviceSurfacePresentModes(physicalDevice, surface,
+        &modeCount, modes.data());
+    if (res != VK_SUCCESS && res != VK_INCOMPLETE)
+        return false;
+    return std::ranges::find(modes, mode) != modes.end();
+}
+
+uint32_t Utils::getMaxImageCount(const Hooks::InstanceDispatch& vk, VkPhysicalDevice physicalDevice,
+        VkSurfaceKHR surface) {
+    VkSurfaceCapabilitiesKHR caps{};
+    const auto res = vk.getPhysicalDeviceSurfaceCapabilities(physicalDevice, surface, &caps);
+    return res == VK_SUCCESS ? caps.maxImageCount : 0;
+}
+
+bool Utils::supportsPresentQueue(const Hooks::InstanceDispatch& vk, VkPhysicalDevice physicalDevice,
+        uint32_t family, VkSurfaceKHR surface) {
+    VkBool32 supported{VK_FALSE};
+    const auto res = vk.getPhysicalDeviceSurfaceSupport(physicalDevice, family, surface, &supported);
+    return res == VK_SUCCESS && supported == VK_TRUE;
+}
+
+bool Utils::hasStructure(const void* chain, VkStructureType type) {
+    for (auto* next = static_cast<const VkBaseInStructure*>(chain); next; next = next->pNext)
+        if (next->sType == type)
+            return true;
+    return false;
+}
+
+bool Utils::supportsSwapchainUsage(const Hooks::InstanceDispatch& vk, VkPhysicalDevice physicalDevice,
+        VkSurfaceKHR surface, VkFormat format,
+        VkImageUsageFlags usage, VkFormatFeatureFlags features) {
+    VkSurfaceCapabilitiesKHR caps{};
+    auto res = vk.getPhysicalDeviceSurfaceCapabilities(physicalDevice, surface, &caps);
+    if (res != VK_SUCCESS || (caps.supportedUsageFlags & usage) != usage)
+        return false;
+
+    VkFormatProperties props{};
+    vk.getPhysicalDeviceFormatProperties(physicalDevice, format, &props);
+    return (props.optimalTilingFeatures & features) == features;
+}
+
+void Utils::copyImage(const Hooks::DeviceDispatch& vk, VkCommandBuffer buf,
         VkImage src, VkImage dst,
         uint32_t width, uint32_t height,
         VkPipelineStageFlags pre, VkPipelineStageFlags post,
-        bool makeSrcPresentable, bool makeDstPresentable) {
+        bool makeSrcPresentable, bool makeDstPresentable,
+        uint32_t queueFamily, uint32_t ownerFamily) {
+    // presentable images owned by another family are handed back to it after the copy
+    const bool owned = ownerFamily != VK_QUEUE_FAMILY_IGNORED;
+    const uint32_t releaseSrc = owned ? queueFamily : VK_QUEUE_FAMILY_IGNORED;
+    const uint32_t releaseDst = owned ? ownerFamily : VK_QUEUE_FAMILY_IGNORED;
+
+    // acquire shared source images from afmf, and presentable ones from their owner.
+    // destination images are overwritten entirely and thus don't need an ownership transfer
     const VkImageMemoryBarrier srcBarrier{
         .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
         .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
-        .oldLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+        .oldLayout = makeSrcPresentable
+            ? VK_IMAGE_LAYOUT_PRESENT_SRC_KHR : VK_IMAGE_LAYOUT_GENERAL,
         .newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        .srcQueueFamilyIndex = makeSrcPresentable
+            ? releaseDst : VK_QUEUE_FAMILY_EXTERNAL,
+        .dstQueueFamilyIndex = makeSrcPresentable
+            ? releaseSrc : queueFamily,
         .image = src,
         .subresourceRange = {
             .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
@@ -69,6 +360,8 @@ void Utils::copyImage(VkCommandBuffer buf,
         .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
         .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
         .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
         .image = dst,
         .subresourceRange = {
             .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
@@ -77,7 +370,7 @@ void Utils::copyImage(VkCommandBuffer buf,
         }
     };
     const std::vector<VkImageMemoryBarrier> barriers = { srcBarrier, dstBarrier };
-    vkCmdPipelineBarrier(buf,
+    vk.cmdPipelineBarrier(buf,
         pre, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
         0, nullptr, 0, nullptr,
         static_cast<uint32_t>(barriers.size()), barriers.data());
@@ -97,7 +390,7 @@ void Utils::copyImage(VkCommandBuffer buf,
             .depth = 1
         }
     };
-    vkCmdCopyImage(buf,
+    vk.cmdCopyImage(buf,
         src, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
         dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
         1, &imageCopy);
@@ -107,6 +400,8 @@ void Utils::copyImage(VkCommandBuffer buf,
             .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
             .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
             .newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+            .srcQueueFamilyIndex = releaseSrc,
+            .dstQueueFamilyIndex = releaseDst,
             .image = src,
             .subresourceRange = {
                 .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
@@ -114,7 +409,7 @@ void Utils::copyImage(VkCommandBuffer buf,
                 .layerCount = 1
             }
         };
-        vkCmdPipelineBarrier(buf,
+        vk.cmdPipelineBarrier(buf,
             VK_PIPELINE_STAGE_TRANSFER_BIT, post, 0,
             0, nullptr, 0, nullptr,
             1, &presentBarrier);
@@ -127,6 +422,8 @@ void Utils::copyImage(VkCommandBuffer buf,
             .dstAccessMask = VK_ACCESS_MEMORY_READ_BIT,
             .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
             .newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+            .srcQueueFamilyIndex = releaseSrc,
+            .dstQueueFamilyIndex = releaseDst,
             .image = dst,
             .subresourceRange = {
                 .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
@@ -134,10 +431,54 @@ void Utils::copyImage(VkCommandBuffer buf,
                 .layerCount = 1
             }
         };
-        vkCmdPipelineBarrier(buf,
+        vk.cmdPipelineBarrier(buf,
             VK_PIPELINE_STAGE_TRANSFER_BIT, post, 0,
             0, nullptr, 0, nullptr,
             1, &presentBarrier);
+    } else {
+        // release the shared destination image to afmf
+        const VkImageMemoryBarrier releaseBarrier{
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            .newLayout = VK_IMAGE_LAYOUT_GENERAL,
+            .srcQueueFamilyIndex = queueFamily,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_EXTERNAL,
+            .image = dst,
+            .subresourceRange = {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .levelCount = 1,
+                .layerCount = 1
+            }
+        };
+        vk.cmdPipelineBarrier(buf,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, post, 0,
+            0, nullptr, 0, nullptr,
+            1, &releaseBarrier);
     }
 
 }
+
+void Utils::transferOwnership(const Hooks::DeviceDispatch& vk, VkCommandBuffer buf,
+        VkImage image, VkImageLayout layout,
+        uint32_t ownerFamily, uint32_t queueFamily, bool release) {
+    // both halves describe the same layout transition, the copy's acquire or release
+    const VkImageMemoryBarrier barrier{
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .oldLayout = release ? VK_IMAGE_LAYOUT_PRESENT_SRC_KHR : layout,
+        .newLayout = release ? layout : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+        .srcQueueFamilyIndex = release ? ownerFamily : queueFamily,
+        .dstQueueFamilyIndex = release ? queueFamily : ownerFamily,
+        .image = image,
+        .subresourceRange = {
+            .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+            .levelCount = 1,
+            .layerCount = 1
+        }
+    };
+    vk.cmdPipelineBarrier(buf,
+        release ? VK_PIPELINE_STAGE_ALL_COMMANDS_BIT : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+        release ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+        0, nullptr, 0, nullptr,
+        1, &barrier);
+}